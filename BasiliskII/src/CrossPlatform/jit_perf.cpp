@@ -0,0 +1,385 @@
+/*
+ *  jit_perf.cpp - Tell Linux perf about translated code
+ *
+ *  Basilisk II (C) 1997-2008 Christian Bauer
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "sysdeps.h"
+#include "jit_perf.h"
+
+#if ENABLE_JIT_PERF
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define DEBUG 0
+#include "debug.h"
+
+
+// Output format
+enum {
+	PERF_MAP,		// /tmp/perf-<pid>.map
+	PERF_JITDUMP	// jit-<pid>.dump
+};
+
+bool jit_perf_enabled = false;
+static int perf_format;
+static FILE *perf_file = NULL;
+static char perf_path[64];
+
+// jitdump format, see tools/perf/Documentation/jitdump-specification.txt
+// in the Linux sources
+const uint32 JITDUMP_MAGIC = 0x4A695444;	// 'JiTD'
+const uint32 JITDUMP_VERSION = 1;
+
+enum {
+	JIT_CODE_LOAD = 0,
+	JIT_CODE_CLOSE = 3
+};
+
+struct jitdump_header {
+	uint32 magic;
+	uint32 version;
+	uint32 total_size;
+	uint32 elf_mach;
+	uint32 pad1;
+	uint32 pid;
+	uint64 timestamp;
+	uint64 flags;
+};
+
+struct jitdump_record {
+	uint32 id;
+	uint32 total_size;
+	uint64 timestamp;
+};
+
+struct jitdump_code_load {
+	jitdump_record rec;
+	uint32 pid;
+	uint32 tid;
+	uint64 vma;
+	uint64 code_addr;
+	uint64 code_size;
+	uint64 code_index;
+	// Followed by the zero-terminated name and the code bytes
+};
+
+static void *jitdump_marker = NULL;	// Mapping of the dump file, for perf record
+static size_t jitdump_marker_size = 0;
+static uint64 jitdump_code_index = 0;
+
+#if defined(__x86_64__)
+const uint32 JITDUMP_ELF_MACH = EM_X86_64;
+#elif defined(__i386__)
+const uint32 JITDUMP_ELF_MACH = EM_386;
+#elif defined(__aarch64__)
+const uint32 JITDUMP_ELF_MACH = EM_AARCH64;
+#elif defined(__arm__)
+const uint32 JITDUMP_ELF_MACH = EM_ARM;
+#elif defined(__powerpc64__)
+const uint32 JITDUMP_ELF_MACH = EM_PPC64;
+#elif defined(__powerpc__)
+const uint32 JITDUMP_ELF_MACH = EM_PPC;
+#elif defined(__mips__)
+const uint32 JITDUMP_ELF_MACH = EM_MIPS;
+#else
+const uint32 JITDUMP_ELF_MACH = EM_NONE;
+#endif
+
+// perf record -k 1 time-stamps samples with CLOCK_MONOTONIC
+static uint64 jitdump_timestamp(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool jitdump_open(void)
+{
+	snprintf(perf_path, sizeof(perf_path), "jit-%d.dump", (int)getpid());
+	int fd = open(perf_path, O_CREAT | O_TRUNC | O_RDWR, 0666);
+	if (fd < 0)
+		return false;
+
+	jitdump_header header;
+	memset(&header, 0, sizeof(header));
+	header.magic = JITDUMP_MAGIC;
+	header.version = JITDUMP_VERSION;
+	header.total_size = sizeof(header);
+	header.elf_mach = JITDUMP_ELF_MACH;
+	header.pid = getpid();
+	header.timestamp = jitdump_timestamp();
+	if (write(fd, &header, sizeof(header)) != sizeof(header)) {
+		close(fd);
+		return false;
+	}
+
+	// perf record finds the dump file through an executable mapping of it
+	jitdump_marker_size = sysconf(_SC_PAGESIZE);
+	jitdump_marker = mmap(NULL, jitdump_marker_size, PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+	if (jitdump_marker == MAP_FAILED) {
+		jitdump_marker = NULL;
+		close(fd);
+		return false;
+	}
+
+	perf_file = fdopen(fd, "wb");
+	if (perf_file == NULL) {
+		munmap(jitdump_marker, jitdump_marker_size);
+		jitdump_marker = NULL;
+		close(fd);
+		return false;
+	}
+	return true;
+}
+
+static void jitdump_close(void)
+{
+	jitdump_record rec;
+	rec.id = JIT_CODE_CLOSE;
+	rec.total_size = sizeof(rec);
+	rec.timestamp = jitdump_timestamp();
+	fwrite(&rec, sizeof(rec), 1, perf_file);
+
+	if (jitdump_marker) {
+		munmap(jitdump_marker, jitdump_marker_size);
+		jitdump_marker = NULL;
+	}
+}
+
+/*
+ *  Initialization / finalization
+ */
+
+bool jit_perf_init(const char *mode)
+{
+	if (mode == NULL || mode[0] == '\0')
+		return false;
+
+	bool ok;
+	if (strcmp(mode, "perfmap") == 0) {
+		perf_format = PERF_MAP;
+		snprintf(perf_path, sizeof(perf_path), "/tmp/perf-%d.map", (int)getpid());
+		perf_file = fopen(perf_path, "w");
+		ok = perf_file != NULL;
+	}
+	else if (strcmp(mode, "jitdump") == 0) {
+		perf_format = PERF_JITDUMP;
+		ok = jitdump_open();
+	}
+	else {
+		fprintf(stderr, "WARNING: Unknown jitperf mode '%s'\n", mode);
+		return false;
+	}
+
+	if (!ok) {
+		fprintf(stderr, "WARNING: Could not create %s (%s)\n", perf_path, strerror(errno));
+		return false;
+	}
+	D(bug("jit_perf: writing translated code info to %s\n", perf_path));
+	jit_perf_enabled = true;
+	return true;
+}
+
+void jit_perf_exit(void)
+{
+	if (!jit_perf_enabled)
+		return;
+
+	if (perf_format == PERF_JITDUMP)
+		jitdump_close();
+	fclose(perf_file);
+	perf_file = NULL;
+	jit_perf_enabled = false;
+}
+
+
+/*
+ *  Translated code bookkeeping
+ */
+
+void jit_perf_add_code(const void *code, uint32 size, const char *name)
+{
+	if (!jit_perf_enabled || size == 0)
+		return;
+
+	if (perf_format == PERF_MAP)
+		fprintf(perf_file, "%lx %x %s\n", (unsigned long)(uintptr)code, size, name);
+	else {
+		const uint32 name_size = strlen(name) + 1;
+		jitdump_code_load load;
+		load.rec.id = JIT_CODE_LOAD;
+		load.rec.total_size = sizeof(load) + name_size + size;
+		load.rec.timestamp = jitdump_timestamp();
+		load.pid = getpid();
+		load.tid = syscall(SYS_gettid);
+		load.vma = (uintptr)code;
+		load.code_addr = (uintptr)code;
+		load.code_size = size;
+		load.code_index = jitdump_code_index++;
+		fwrite(&load, sizeof(load), 1, perf_file);
+		fwrite(name, name_size, 1, perf_file);
+		fwrite(code, size, 1, perf_file);
+	}
+}
+
+/*
+ *  Mac OS symbols
+ */
+
+// Characters MacsBug accepts in symbol names
+static inline bool is_macsbug_char(uint8 c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+		c == '_' || c == '%' || c == '.';
+}
+
+static bool copy_macsbug_name(const uint8 *p, int n, char *name, int len)
+{
+	if (n < 2)
+		return false;
+	for (int i = 0; i < n; i++) {
+		// Fixed-length names are padded with spaces
+		if (p[i] == ' ' && i > 0) {
+			n = i;
+			break;
+		}
+		if (!is_macsbug_char(p[i]))
+			return false;
+	}
+	if (n >= len)
+		n = len - 1;
+	memcpy(name, p, n);
+	name[n] = '\0';
+	return true;
+}
+
+const int MACSBUG_SCAN_LIMIT = 4096;	// Source bytes searched for the routine end
+
+bool jit_perf_macsbug_name(const uint8 *p, const uint8 *end, char *name, int len)
+{
+	if (end - p > MACSBUG_SCAN_LIMIT)
+		end = p + MACSBUG_SCAN_LIMIT;
+
+	for (const uint8 *q = p; q + 4 <= end; q += 2) {
+		const uint16 opcode = (q[0] << 8) | q[1];
+		const uint8 *s;
+		if (opcode == 0x4e75 || opcode == 0x4ed0)		// RTS, JMP (A0)
+			s = q + 2;
+		else if (opcode == 0x4e74)						// RTD #imm
+			s = q + 4;
+		else
+			continue;
+		if (s + 2 > end)
+			break;
+
+		if (s[0] == 0x80) {
+			// Variable length, given by the next byte
+			if (s + 2 + s[1] <= end && copy_macsbug_name(s + 2, s[1], name, len))
+				return true;
+		}
+		else if (s[0] > 0x80 && s[0] < 0xa0) {
+			// Variable length, 1 to 31 characters
+			const int n = s[0] & 0x1f;
+			if (s + 1 + n <= end && copy_macsbug_name(s + 1, n, name, len))
+				return true;
+		}
+		else if (s[0] >= 0xa0 && s + 8 <= end) {
+			// Fixed length, 8 characters with bit 7 set in the first one
+			uint8 fixed[8];
+			memcpy(fixed, s, 8);
+			fixed[0] &= 0x7f;
+			if (copy_macsbug_name(fixed, 8, name, len))
+				return true;
+		}
+	}
+	return false;
+}
+
+const int TRACEBACK_SCAN_LIMIT = 16384;	// Source bytes searched for the routine end
+
+static inline uint32 get_be32(const uint8 *p)
+{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+bool jit_perf_traceback_name(const uint8 *p, const uint8 *end, char *name, int len, uint32 *offset)
+{
+	if (end - p > TRACEBACK_SCAN_LIMIT)
+		end = p + TRACEBACK_SCAN_LIMIT;
+
+	// A traceback table starts with a zero word, then flags
+	for (const uint8 *q = p; q + 12 <= end; q += 4) {
+		if (get_be32(q) != 0)
+			continue;
+		const uint8 *tb = q + 4;
+		const bool has_tboff	= (tb[2] & 0x20) != 0;
+		const bool int_hndl		= (tb[3] & 0x80) != 0;
+		const bool name_present	= (tb[3] & 0x40) != 0;
+		const bool has_ctl		= (tb[2] & 0x08) != 0;
+		const int fixedparms	= tb[6];
+		const int floatparms	= tb[7] >> 1;
+		if (tb[0] != 0 || !has_tboff || !name_present)
+			continue;
+
+		// Skip optional fields up to the name
+		const uint8 *f = tb + 8;
+		if (fixedparms || floatparms)
+			f += 4;									// parminfo
+		if (f + 4 > end)
+			break;
+		const uint32 tb_offset = get_be32(f);
+		f += 4;
+		if (int_hndl)
+			f += 4;									// hand_mask
+		if (has_ctl) {
+			if (f + 4 > end)
+				break;
+			f += 4 + 4 * get_be32(f);				// ctl_info, ctl_info_disp[]
+		}
+		if (f + 2 > end || f < tb)
+			break;
+		const int n = (f[0] << 8) | f[1];
+		f += 2;
+
+		// tb_offset is counted from the routine start to the zero word
+		if (tb_offset < (uint32)(q - p))
+			continue;
+		if (n == 0 || n >= 256 || f + n > end)
+			continue;
+		bool printable = true;
+		for (int i = 0; i < n && printable; i++)
+			printable = f[i] > 0x20 && f[i] < 0x7f;
+		if (!printable)
+			continue;
+
+		const int m = n < len ? n : len - 1;
+		memcpy(name, f, m);
+		name[m] = '\0';
+		*offset = tb_offset - (q - p);
+		return true;
+	}
+	return false;
+}
+
+#endif /* ENABLE_JIT_PERF */
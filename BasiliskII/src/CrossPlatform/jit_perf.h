@@ -0,0 +1,73 @@
+/*
+ *  jit_perf.h - Tell Linux perf about translated code
+ *
+ *  Basilisk II (C) 1997-2008 Christian Bauer
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef JIT_PERF_H
+#define JIT_PERF_H
+
+/*
+ *  Two formats are supported, selected by the "jitperf" prefs item:
+ *
+ *  "perfmap"  writes /tmp/perf-<pid>.map, which "perf report" reads as is.
+ *             Lines are only appended, as other JITs do: when flushed code
+ *             is reused, the older lines for its addresses stay, so that
+ *             samples taken before the flush can still be attributed.
+ *
+ *  "jitdump"  writes jit-<pid>.dump into the current directory. Records
+ *             are time-stamped, so that samples are attributed to the code
+ *             that was live when they were taken. Record with
+ *             "perf record -k 1", then run "perf inject --jit".
+ */
+
+#ifdef __linux__
+#define ENABLE_JIT_PERF 1
+#endif
+
+#if ENABLE_JIT_PERF
+// Start writing translated code info, MODE is "perfmap" or "jitdump"
+extern bool jit_perf_init(const char *mode);
+extern void jit_perf_exit(void);
+
+// Flag: is translated code info written?
+extern bool jit_perf_enabled;
+
+// Record a new translated block
+extern void jit_perf_add_code(const void *code, uint32 size, const char *name);
+
+/*
+ *  Mac OS symbols, looked up in the guest code [P, END[ following a
+ *  block start. NAME receives at most LEN - 1 characters.
+ */
+
+// MacsBug symbol after the RTS, JMP (A0) or RTD ending a 68k routine
+extern bool jit_perf_macsbug_name(const uint8 *p, const uint8 *end, char *name, int len);
+
+// Traceback table name ending a PowerPC routine, *OFFSET receives the
+// offset of P from the routine start
+extern bool jit_perf_traceback_name(const uint8 *p, const uint8 *end, char *name, int len, uint32 *offset);
+#else
+const bool jit_perf_enabled = false;
+static inline bool jit_perf_init(const char *mode) { return false; }
+static inline void jit_perf_exit(void) { }
+static inline void jit_perf_add_code(const void *code, uint32 size, const char *name) { }
+static inline bool jit_perf_macsbug_name(const uint8 *p, const uint8 *end, char *name, int len) { return false; }
+static inline bool jit_perf_traceback_name(const uint8 *p, const uint8 *end, char *name, int len, uint32 *offset) { return false; }
+#endif
+
+#endif /* JIT_PERF_H */
@@ -0,0 +1,149 @@
+/*
+ * test_blit.cpp - Frame buffer blitters benchmark
+ *
+ * Basilisk II (C) 1997-2008 Christian Bauer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Checks that each vectorized blitter the CPU supports writes the same
+ * pixels as the generic one, then times both on a line of N bytes of
+ * Mac frame buffer. Usage:
+ *
+ *   test-blit [N_BYTES [N_ROUNDS]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sysdeps.h"
+
+// The blitters are private to video_blit.cpp, build them without SDL
+#undef USE_SDL_VIDEO
+#include "video_blit.cpp"
+
+const int GUARD = 64;		// Bytes checked for overruns past the line
+
+// Generic blitters, with the number of destination bytes per source byte
+static const struct {
+	Screen_blit_func func;
+	const char *name;
+	int ratio;
+} blitters[] = {
+	{ Blit_RGB555_NBO		, "RGB555_NBO"		,  1 },
+	{ Blit_RGB565_NBO		, "RGB565_NBO"		,  1 },
+	{ Blit_RGB888_NBO		, "RGB888_NBO"		,  1 },
+	{ Blit_BGR888_NBO		, "BGR888_NBO"		,  1 },
+	{ Blit_Expand_1_To_8	, "Expand_1_To_8"	,  8 },
+	{ Blit_Expand_2_To_8	, "Expand_2_To_8"	,  4 },
+	{ Blit_Expand_4_To_8	, "Expand_4_To_8"	,  2 },
+	{ Blit_Expand_1_To_16	, "Expand_1_To_16"	, 16 },
+	{ Blit_Expand_2_To_16	, "Expand_2_To_16"	,  8 },
+	{ Blit_Expand_4_To_16	, "Expand_4_To_16"	,  4 },
+	{ Blit_Expand_8_To_16	, "Expand_8_To_16"	,  2 },
+	{ Blit_Expand_1_To_32	, "Expand_1_To_32"	, 32 },
+	{ Blit_Expand_2_To_32	, "Expand_2_To_32"	, 16 },
+	{ Blit_Expand_4_To_32	, "Expand_4_To_32"	,  8 },
+	{ Blit_Expand_8_To_32	, "Expand_8_To_32"	,  4 },
+	{ NULL, NULL, 0 }
+};
+
+static int blit_index(Screen_blit_func func)
+{
+	int i = 0;
+	while (blitters[i].func && blitters[i].func != func)
+		i++;
+	return i;
+}
+
+// Compare both blitters on all line lengths up to N_BYTES and a few misalignments
+static bool check(const Screen_blit_simd_info *b, const uint8 *source, int n_bytes)
+{
+	const int ratio = blitters[blit_index(b->handler)].ratio;
+	const int dest_size = (n_bytes + 16) * ratio + GUARD;
+	uint8 *ref = new uint8[dest_size];
+	uint8 *out = new uint8[dest_size];
+
+	// Lines of 16-bit pixels are never shorter than a pixel, nor misaligned
+	const int step = ratio == 1 ? 2 : 1;
+	bool ok = true;
+	for (int offset = 0; ok && offset < 4; offset += step) {
+		for (int length = step; ok && length <= n_bytes; length += step) {
+			memset(ref, 0xa5, dest_size);
+			memset(out, 0xa5, dest_size);
+			b->handler(ref + offset, source + offset, length);
+			b->handler_simd(out + offset, source + offset, length);
+			if (memcmp(ref, out, dest_size) != 0) {
+				printf("  %-16s %-6s MISMATCH at length %d, offset %d\n",
+					   blitters[blit_index(b->handler)].name, b->name, length, offset);
+				ok = false;
+			}
+		}
+	}
+	delete[] out;
+	delete[] ref;
+	return ok;
+}
+
+// Return the destination bandwidth in GB/s
+static double bench(Screen_blit_func func, int ratio, uint8 *dest, const uint8 *source, int n_bytes, int n_rounds)
+{
+	clock_t start = clock();
+	for (int r = 0; r < n_rounds; r++)
+		func(dest, source, n_bytes);
+	double elapsed = double(clock() - start) / double(CLOCKS_PER_SEC);
+	if (elapsed <= 0)
+		return 0;
+	return double(n_bytes) * ratio * n_rounds / elapsed / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+	const int n_bytes = argc > 1 ? atoi(argv[1]) : 640 * 480;
+	const int n_rounds = argc > 2 ? atoi(argv[2]) : 200;
+	const int n_check = 256;
+
+	srand(1);
+	uint8 *source = new uint8[n_bytes + n_check + 16];
+	for (int i = 0; i < n_bytes + n_check + 16; i++)
+		source[i] = rand();
+	for (int i = 0; i < 256; i++)
+		ExpandMap[i] = (uint32(rand()) << 16) ^ uint32(rand());
+	uint8 *dest = new uint8[n_bytes * 32 + GUARD];
+
+	const int cpu_features = blit_cpu_features();
+	printf("%d source bytes, %d rounds\n", n_bytes, n_rounds);
+	printf("  %-16s %-6s %8s %8s\n", "", "", "generic", "vector");
+	bool ok = true;
+	for (const Screen_blit_simd_info *b = Screen_blitters_simd; b->handler; b++) {
+		if ((b->cpu_features & ~cpu_features) != 0)
+			continue;
+		if (!check(b, source, n_check)) {
+			ok = false;
+			continue;
+		}
+		const int i = blit_index(b->handler);
+		double generic = bench(b->handler, blitters[i].ratio, dest, source, n_bytes, n_rounds);
+		double vector = bench(b->handler_simd, blitters[i].ratio, dest, source, n_bytes, n_rounds);
+		printf("  %-16s %-6s %8.2f %8.2f GB/s\n", blitters[i].name, b->name, generic, vector);
+	}
+
+	delete[] dest;
+	delete[] source;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+/*
+ * test_tiles.cpp - Refreshed modes change detection benchmark
+ *
+ * Basilisk II (C) 1997-2008 Christian Bauer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Times how the non-VOSF refresh finds what changed in the frame buffer:
+ * by comparing 64x64 boxes with a copy of the frame buffer, as the drivers
+ * used to do, or by tile fingerprints. Both have to report the same
+ * areas. Usage:
+ *
+ *   test-tiles [WIDTH [HEIGHT [DEPTH [N_FRAMES]]]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sysdeps.h"
+#include "video_tiles.h"
+
+const uint32 BOX_PIXELS = 64;		// Box size of the copy based scan
+
+struct frame_buffer {
+	uint32 width, height;			// In pixels
+	uint32 bytes_per_pixel;
+	uint32 row_bytes;
+	uint8 *buffer;
+	uint8 *copy;
+};
+
+// Copy based scan, return the number of changed boxes
+static uint32 scan_copy(frame_buffer *fb)
+{
+	const uint32 xs_max = BOX_PIXELS * fb->bytes_per_pixel;
+	uint32 n_boxes = 0;
+	for (uint32 y = 0; y < fb->height; y += BOX_PIXELS) {
+		uint32 h = BOX_PIXELS;
+		if (h > fb->height - y)
+			h = fb->height - y;
+		for (uint32 x = 0; x < fb->width; x += BOX_PIXELS) {
+			const uint32 xb = x * fb->bytes_per_pixel;
+			const uint32 xs = (fb->width - x < BOX_PIXELS) ? (fb->width - x) * fb->bytes_per_pixel : xs_max;
+			bool dirty = false;
+			for (uint32 j = y; j < y + h; j++) {
+				const uint32 yb = j * fb->row_bytes;
+				if (memcmp(&fb->buffer[yb + xb], &fb->copy[yb + xb], xs) != 0) {
+					memcpy(&fb->copy[yb + xb], &fb->buffer[yb + xb], xs);
+					dirty = true;
+				}
+			}
+			if (dirty)
+				n_boxes++;
+		}
+	}
+	return n_boxes;
+}
+
+// Changes made to the frame buffer between two refreshes
+enum {
+	CHANGE_NONE,					// Idle desktop
+	CHANGE_CURSOR,					// Blinking text cursor and a clock
+	CHANGE_WINDOW,					// A 640x480 window redraws
+	CHANGE_ALL						// Scrolling full screen
+};
+
+static const char *change_names[] = { "idle", "cursor+clock", "640x480 window", "full screen" };
+
+static void change(frame_buffer *fb, int kind, int frame)
+{
+	uint8 v = frame * 37 + 1;
+	switch (kind) {
+	case CHANGE_CURSOR:
+		for (uint32 j = 100; j < 116; j++)
+			memset(fb->buffer + j * fb->row_bytes + 200 * fb->bytes_per_pixel, v, 2 * fb->bytes_per_pixel);
+		for (uint32 j = 2; j < 14; j++)
+			memset(fb->buffer + j * fb->row_bytes + (fb->width - 60) * fb->bytes_per_pixel, v, 40 * fb->bytes_per_pixel);
+		break;
+	case CHANGE_WINDOW:
+		for (uint32 j = 300; j < 780 && j < fb->height; j++)
+			memset(fb->buffer + j * fb->row_bytes + 400 * fb->bytes_per_pixel, v + j, 640 * fb->bytes_per_pixel);
+		break;
+	case CHANGE_ALL:
+		for (uint32 j = 0; j < fb->height; j++)
+			memset(fb->buffer + j * fb->row_bytes, v + j, fb->row_bytes);
+		break;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	frame_buffer fb;
+	fb.width = argc > 1 ? atoi(argv[1]) : 1920;
+	fb.height = argc > 2 ? atoi(argv[2]) : 1080;
+	const int depth = argc > 3 ? atoi(argv[3]) : 32;
+	const int n_frames = argc > 4 ? atoi(argv[4]) : 200;
+	if (depth != 8 && depth != 16 && depth != 32) {
+		fprintf(stderr, "Depth must be 8, 16 or 32\n");
+		return 1;
+	}
+	fb.bytes_per_pixel = depth / 8;
+	fb.row_bytes = fb.width * fb.bytes_per_pixel;
+	fb.buffer = new uint8[fb.row_bytes * fb.height];
+	fb.copy = new uint8[fb.row_bytes * fb.height];
+	srand(1);
+	for (uint32 i = 0; i < fb.row_bytes * fb.height; i++)
+		fb.buffer[i] = rand();
+
+	video_tiles tiles;
+	video_tiles_init(&tiles, fb.row_bytes, fb.height, fb.row_bytes, 64 * fb.bytes_per_pixel);
+
+	printf("%ux%ux%d, %d frames\n", fb.width, fb.height, depth, n_frames);
+	printf("  %-16s %12s %12s %10s %10s\n", "", "copy", "tiles", "boxes", "tiles");
+	bool ok = true;
+	for (int kind = CHANGE_NONE; kind <= CHANGE_ALL; kind++) {
+		memcpy(fb.copy, fb.buffer, fb.row_bytes * fb.height);
+		video_tiles_invalidate(&tiles);
+		video_tiles_scan(&tiles, fb.buffer);
+
+		// Same changes for both scans, made outside of the timed part
+		double copy_time = 0, tiles_time = 0;
+		uint32 n_boxes = 0, n_tiles = 0;
+		for (int f = 0; f < n_frames; f++) {
+			change(&fb, kind, f);
+			clock_t start = clock();
+			n_boxes = scan_copy(&fb);
+			clock_t middle = clock();
+			n_tiles = video_tiles_scan(&tiles, fb.buffer);
+			clock_t end = clock();
+			copy_time += double(middle - start);
+			tiles_time += double(end - middle);
+
+			// Tiles must cover exactly the boxes that changed
+			bool dirty[(4096 / 16) * (4096 / 64)];
+			memset(dirty, 0, sizeof(dirty));
+			const uint32 n_x_boxes = (fb.width + BOX_PIXELS - 1) / BOX_PIXELS;
+			for (uint32 i = 0; i < n_tiles; i++) {
+				const uint32 tx = tiles.dirty[i] % tiles.n_x, ty = tiles.dirty[i] / tiles.n_x;
+				dirty[(ty * VIDEO_TILE_ROWS / BOX_PIXELS) * n_x_boxes + tx] = true;
+			}
+			uint32 n_dirty = 0;
+			for (uint32 i = 0; i < sizeof(dirty); i++)
+				n_dirty += dirty[i];
+			if (n_dirty != n_boxes) {
+				printf("  %-16s MISMATCH at frame %d: %u boxes, %u from tiles\n", change_names[kind], f, n_boxes, n_dirty);
+				ok = false;
+				break;
+			}
+		}
+		const double ms = 1000.0 / CLOCKS_PER_SEC / n_frames;
+		printf("  %-16s %9.3f ms %9.3f ms %10u %10u\n", change_names[kind], copy_time * ms, tiles_time * ms, n_boxes, n_tiles);
+	}
+
+	video_tiles_exit(&tiles);
+	delete[] fb.copy;
+	delete[] fb.buffer;
+	return ok ? 0 : 1;
+}
@@ -29,6 +29,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+// Vectorized blitters, selected at run-time on x86
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define USE_BLIT_X86_SIMD 1
+#define BLIT_TARGET(ISA) __attribute__((target(ISA)))
+#include <immintrin.h>
+#endif
+// NEON variants have not been validated on ARM hardware yet, build them
+// with -DENABLE_BLIT_NEON and check them with test-blit first
+#if defined(ENABLE_BLIT_NEON) && (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(WORDS_BIGENDIAN)
+#define USE_BLIT_NEON 1
+#include <arm_neon.h>
+#endif
+
 // Format of the target visual
 static VisualFormat visualFormat;
 
@@ -468,6 +481,484 @@ static void Blit_Expand_8_To_32(uint8 * dest, const uint8 * p, uint32 length)
 		*q++ = ExpandMap[*p++];
 }
 
+/* -------------------------------------------------------------------------- */
+/* --- Vectorized blitters                                                --- */
+/* -------------------------------------------------------------------------- */
+
+/*
+ *  The following variants produce the very same pixels as the generic
+ *  blitters above, which they call for the bytes left at the end of the
+ *  line (never with an empty line, that would misalign the 16-bit ones).
+ *  Screen_blitter_init() picks the fastest one the CPU supports.
+ */
+
+// CPU features required by a vectorized blitter
+enum {
+	BLIT_SSE2	= 1 << 0,
+	BLIT_SSSE3	= 1 << 1,
+	BLIT_AVX2	= 1 << 2,
+	BLIT_NEON	= 1 << 3
+};
+
+static int blit_cpu_features(void)
+{
+	int features = 0;
+#if USE_BLIT_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		features |= BLIT_SSE2;
+	if (__builtin_cpu_supports("ssse3"))
+		features |= BLIT_SSSE3;
+	if (__builtin_cpu_supports("avx2"))
+		features |= BLIT_AVX2;
+#endif
+#if USE_BLIT_NEON
+	features |= BLIT_NEON;
+#endif
+	return features;
+}
+
+#if USE_BLIT_X86_SIMD
+
+// Load 4 bytes without alignment constraints
+static inline BLIT_TARGET("sse2") __m128i blit_load_32(const uint8 * p)
+{
+	uint32 v;
+	memcpy(&v, p, sizeof(v));
+	return _mm_cvtsi32_si128(v);
+}
+
+// RGB 555: swap bytes of 16-bit pixels
+
+static BLIT_TARGET("sse2") void Blit_RGB555_NBO_SSE2(uint8 * dest, const uint8 * source, uint32 length)
+{
+	uint32 i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const __m128i s = _mm_loadu_si128((const __m128i *)(source + i));
+		_mm_storeu_si128((__m128i *)(dest + i), _mm_or_si128(_mm_slli_epi16(s, 8), _mm_srli_epi16(s, 8)));
+	}
+	if (i < length)
+		Blit_RGB555_NBO(dest + i, source + i, length - i);
+}
+
+static BLIT_TARGET("avx2") void Blit_RGB555_NBO_AVX2(uint8 * dest, const uint8 * source, uint32 length)
+{
+	uint32 i = 0;
+	for (; i + 32 <= length; i += 32) {
+		const __m256i s = _mm256_loadu_si256((const __m256i *)(source + i));
+		_mm256_storeu_si256((__m256i *)(dest + i), _mm256_or_si256(_mm256_slli_epi16(s, 8), _mm256_srli_epi16(s, 8)));
+	}
+	if (i < length)
+		Blit_RGB555_NBO(dest + i, source + i, length - i);
+}
+
+// RGB 565: same bit shuffling as FB_BLIT_1, 8 pixels at a time
+
+static BLIT_TARGET("sse2") void Blit_RGB565_NBO_SSE2(uint8 * dest, const uint8 * source, uint32 length)
+{
+	const __m128i b_mask = _mm_set1_epi16(0x001f);
+	const __m128i g_mask = _mm_set1_epi16(0x01c0);
+	const __m128i r_mask = _mm_set1_epi16((int16)0xfe00);
+	uint32 i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const __m128i s = _mm_loadu_si128((const __m128i *)(source + i));
+		__m128i d = _mm_and_si128(_mm_srli_epi16(s, 8), b_mask);
+		d = _mm_or_si128(d, _mm_and_si128(_mm_slli_epi16(s, 9), r_mask));
+		d = _mm_or_si128(d, _mm_and_si128(_mm_srli_epi16(s, 7), g_mask));
+		_mm_storeu_si128((__m128i *)(dest + i), d);
+	}
+	if (i < length)
+		Blit_RGB565_NBO(dest + i, source + i, length - i);
+}
+
+static BLIT_TARGET("avx2") void Blit_RGB565_NBO_AVX2(uint8 * dest, const uint8 * source, uint32 length)
+{
+	const __m256i b_mask = _mm256_set1_epi16(0x001f);
+	const __m256i g_mask = _mm256_set1_epi16(0x01c0);
+	const __m256i r_mask = _mm256_set1_epi16((int16)0xfe00);
+	uint32 i = 0;
+	for (; i + 32 <= length; i += 32) {
+		const __m256i s = _mm256_loadu_si256((const __m256i *)(source + i));
+		__m256i d = _mm256_and_si256(_mm256_srli_epi16(s, 8), b_mask);
+		d = _mm256_or_si256(d, _mm256_and_si256(_mm256_slli_epi16(s, 9), r_mask));
+		d = _mm256_or_si256(d, _mm256_and_si256(_mm256_srli_epi16(s, 7), g_mask));
+		_mm256_storeu_si256((__m256i *)(dest + i), d);
+	}
+	if (i < length)
+		Blit_RGB565_NBO(dest + i, source + i, length - i);
+}
+
+// RGB 888: swap bytes of 32-bit pixels
+
+static BLIT_TARGET("sse2") void Blit_RGB888_NBO_SSE2(uint8 * dest, const uint8 * source, uint32 length)
+{
+	uint32 i = 0;
+	for (; i + 16 <= length; i += 16) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(source + i));
+		s = _mm_or_si128(_mm_slli_epi16(s, 8), _mm_srli_epi16(s, 8));
+		s = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xb1), 0xb1);
+		_mm_storeu_si128((__m128i *)(dest + i), s);
+	}
+	if (i < length)
+		Blit_RGB888_NBO(dest + i, source + i, length - i);
+}
+
+static BLIT_TARGET("ssse3") void Blit_RGB888_NBO_SSSE3(uint8 * dest, const uint8 * source, uint32 length)
+{
+	const __m128i swap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	uint32 i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const __m128i s = _mm_loadu_si128((const __m128i *)(source + i));
+		_mm_storeu_si128((__m128i *)(dest + i), _mm_shuffle_epi8(s, swap));
+	}
+	if (i < length)
+		Blit_RGB888_NBO(dest + i, source + i, length - i);
+}
+
+static BLIT_TARGET("avx2") void Blit_RGB888_NBO_AVX2(uint8 * dest, const uint8 * source, uint32 length)
+{
+	const __m256i swap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+										  3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	uint32 i = 0;
+	for (; i + 32 <= length; i += 32) {
+		const __m256i s = _mm256_loadu_si256((const __m256i *)(source + i));
+		_mm256_storeu_si256((__m256i *)(dest + i), _mm256_shuffle_epi8(s, swap));
+	}
+	if (i < length)
+		Blit_RGB888_NBO(dest + i, source + i, length - i);
+}
+
+// BGR 888: move the low byte of 32-bit pixels to the third one
+
+static BLIT_TARGET("sse2") void Blit_BGR888_NBO_SSE2(uint8 * dest, const uint8 * source, uint32 length)
+{
+	const __m128i rb_mask = _mm_set1_epi32(0x00ff00ff);
+	const __m128i g_mask = _mm_set1_epi32(0x0000ff00);
+	uint32 i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const __m128i s = _mm_loadu_si128((const __m128i *)(source + i));
+		const __m128i d = _mm_or_si128(_mm_and_si128(s, rb_mask), _mm_slli_epi32(_mm_and_si128(s, g_mask), 16));
+		_mm_storeu_si128((__m128i *)(dest + i), d);
+	}
+	if (i < length)
+		Blit_BGR888_NBO(dest + i, source + i, length - i);
+}
+
+static BLIT_TARGET("avx2") void Blit_BGR888_NBO_AVX2(uint8 * dest, const uint8 * source, uint32 length)
+{
+	const __m256i rb_mask = _mm256_set1_epi32(0x00ff00ff);
+	const __m256i g_mask = _mm256_set1_epi32(0x0000ff00);
+	uint32 i = 0;
+	for (; i + 32 <= length; i += 32) {
+		const __m256i s = _mm256_loadu_si256((const __m256i *)(source + i));
+		const __m256i d = _mm256_or_si256(_mm256_and_si256(s, rb_mask), _mm256_slli_epi32(_mm256_and_si256(s, g_mask), 16));
+		_mm256_storeu_si256((__m256i *)(dest + i), d);
+	}
+	if (i < length)
+		Blit_BGR888_NBO(dest + i, source + i, length - i);
+}
+
+// 1/2/4-bit to 8-bit: split bytes into bit fields and interleave them
+
+static BLIT_TARGET("sse2") void Blit_Expand_1_To_8_SSE2(uint8 * dest, const uint8 * p, uint32 length)
+{
+	const __m128i bits = _mm_setr_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+	const __m128i one = _mm_set1_epi8(1);
+	uint32 i = 0;
+	for (; i + 2 <= length; i += 2) {
+		// Replicate each source byte 8 times
+		__m128i c = _mm_cvtsi32_si128(p[i] | (p[i + 1] << 8));
+		c = _mm_unpacklo_epi8(c, c);
+		c = _mm_unpacklo_epi16(c, c);
+		c = _mm_unpacklo_epi32(c, c);
+		const __m128i d = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(c, bits), bits), one);
+		_mm_storeu_si128((__m128i *)(dest + i * 8), d);
+	}
+	if (i < length)
+		Blit_Expand_1_To_8(dest + i * 8, p + i, length - i);
+}
+
+static BLIT_TARGET("sse2") void Blit_Expand_2_To_8_SSE2(uint8 * dest, const uint8 * p, uint32 length)
+{
+	const __m128i mask = _mm_set1_epi8(3);
+	uint32 i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const __m128i c = _mm_loadu_si128((const __m128i *)(p + i));
+		const __m128i f0 = _mm_and_si128(_mm_srli_epi16(c, 6), mask);
+		const __m128i f1 = _mm_and_si128(_mm_srli_epi16(c, 4), mask);
+		const __m128i f2 = _mm_and_si128(_mm_srli_epi16(c, 2), mask);
+		const __m128i f3 = _mm_and_si128(c, mask);
+		const __m128i f01_lo = _mm_unpacklo_epi8(f0, f1), f23_lo = _mm_unpacklo_epi8(f2, f3);
+		const __m128i f01_hi = _mm_unpackhi_epi8(f0, f1), f23_hi = _mm_unpackhi_epi8(f2, f3);
+		__m128i *q = (__m128i *)(dest + i * 4);
+		_mm_storeu_si128(q + 0, _mm_unpacklo_epi16(f01_lo, f23_lo));
+		_mm_storeu_si128(q + 1, _mm_unpackhi_epi16(f01_lo, f23_lo));
+		_mm_storeu_si128(q + 2, _mm_unpacklo_epi16(f01_hi, f23_hi));
+		_mm_storeu_si128(q + 3, _mm_unpackhi_epi16(f01_hi, f23_hi));
+	}
+	if (i < length)
+		Blit_Expand_2_To_8(dest + i * 4, p + i, length - i);
+}
+
+static BLIT_TARGET("sse2") void Blit_Expand_4_To_8_SSE2(uint8 * dest, const uint8 * p, uint32 length)
+{
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	uint32 i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const __m128i c = _mm_loadu_si128((const __m128i *)(p + i));
+		const __m128i hi = _mm_and_si128(_mm_srli_epi16(c, 4), mask);
+		const __m128i lo = _mm_and_si128(c, mask);
+		__m128i *q = (__m128i *)(dest + i * 2);
+		_mm_storeu_si128(q + 0, _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128(q + 1, _mm_unpackhi_epi8(hi, lo));
+	}
+	if (i < length)
+		Blit_Expand_4_To_8(dest + i * 2, p + i, length - i);
+}
+
+// 1-bit to 16/32-bit: all bits set for black pixels
+
+static BLIT_TARGET("sse2") void Blit_Expand_1_To_16_SSE2(uint8 * dest, const uint8 * p, uint32 length)
+{
+	const __m128i bits = _mm_setr_epi16(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+	for (uint32 i = 0; i < length; i++) {
+		const __m128i c = _mm_set1_epi16(p[i]);
+		_mm_storeu_si128((__m128i *)(dest + i * 16), _mm_cmpeq_epi16(_mm_and_si128(c, bits), bits));
+	}
+}
+
+static BLIT_TARGET("sse2") void Blit_Expand_1_To_32_SSE2(uint8 * dest, const uint8 * p, uint32 length)
+{
+	const __m128i bits_hi = _mm_setr_epi32(0x80, 0x40, 0x20, 0x10);
+	const __m128i bits_lo = _mm_setr_epi32(0x08, 0x04, 0x02, 0x01);
+	for (uint32 i = 0; i < length; i++) {
+		const __m128i c = _mm_set1_epi32(p[i]);
+		__m128i *q = (__m128i *)(dest + i * 32);
+		_mm_storeu_si128(q + 0, _mm_cmpeq_epi32(_mm_and_si128(c, bits_hi), bits_hi));
+		_mm_storeu_si128(q + 1, _mm_cmpeq_epi32(_mm_and_si128(c, bits_lo), bits_lo));
+	}
+}
+
+// 2/4/8-bit to 16/32-bit: gather ExpandMap[] entries, with the same
+// indices as the generic blitters
+
+static BLIT_TARGET("avx2") inline __m256i blit_expand_gather(__m256i index)
+{
+	return _mm256_i32gather_epi32((const int *)ExpandMap, index, 4);
+}
+
+// Truncate 2 x 8 32-bit pixels to 16 16-bit pixels
+static BLIT_TARGET("avx2") inline __m256i blit_pack_16(__m256i lo, __m256i hi)
+{
+	const __m256i mask = _mm256_set1_epi32(0xffff);
+	const __m256i packed = _mm256_packus_epi32(_mm256_and_si256(lo, mask), _mm256_and_si256(hi, mask));
+	return _mm256_permute4x64_epi64(packed, 0xd8);
+}
+
+static BLIT_TARGET("avx2") void Blit_Expand_2_To_16_AVX2(uint8 * dest, const uint8 * p, uint32 length)
+{
+	const __m256i shifts = _mm256_setr_epi32(6, 4, 2, 0, 6, 4, 2, 0);
+	uint32 i = 0;
+	for (; i + 4 <= length; i += 4) {
+		__m128i c = blit_load_32(p + i);
+		c = _mm_unpacklo_epi8(c, c);
+		c = _mm_unpacklo_epi16(c, c);
+		const __m256i lo = blit_expand_gather(_mm256_srlv_epi32(_mm256_cvtepu8_epi32(c), shifts));
+		const __m256i hi = blit_expand_gather(_mm256_srlv_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(c, 8)), shifts));
+		_mm256_storeu_si256((__m256i *)(dest + i * 8), blit_pack_16(lo, hi));
+	}
+	if (i < length)
+		Blit_Expand_2_To_16(dest + i * 8, p + i, length - i);
+}
+
+static BLIT_TARGET("avx2") void Blit_Expand_4_To_16_AVX2(uint8 * dest, const uint8 * p, uint32 length)
+{
+	const __m256i shifts = _mm256_setr_epi32(4, 0, 4, 0, 4, 0, 4, 0);
+	uint32 i = 0;
+	for (; i + 8 <= length; i += 8) {
+		__m128i c = _mm_loadl_epi64((const __m128i *)(p + i));
+		c = _mm_unpacklo_epi8(c, c);
+		const __m256i lo = blit_expand_gather(_mm256_srlv_epi32(_mm256_cvtepu8_epi32(c), shifts));
+		const __m256i hi = blit_expand_gather(_mm256_srlv_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(c, 8)), shifts));
+		_mm256_storeu_si256((__m256i *)(dest + i * 4), blit_pack_16(lo, hi));
+	}
+	if (i < length)
+		Blit_Expand_4_To_16(dest + i * 4, p + i, length - i);
+}
+
+static BLIT_TARGET("avx2") void Blit_Expand_8_To_16_AVX2(uint8 * dest, const uint8 * p, uint32 length)
+{
+	uint32 i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const __m128i c = _mm_loadu_si128((const __m128i *)(p + i));
+		const __m256i lo = blit_expand_gather(_mm256_cvtepu8_epi32(c));
+		const __m256i hi = blit_expand_gather(_mm256_cvtepu8_epi32(_mm_srli_si128(c, 8)));
+		_mm256_storeu_si256((__m256i *)(dest + i * 2), blit_pack_16(lo, hi));
+	}
+	if (i < length)
+		Blit_Expand_8_To_16(dest + i * 2, p + i, length - i);
+}
+
+static BLIT_TARGET("avx2") void Blit_Expand_2_To_32_AVX2(uint8 * dest, const uint8 * p, uint32 length)
+{
+	const __m256i shifts = _mm256_setr_epi32(6, 4, 2, 0, 6, 4, 2, 0);
+	uint32 i = 0;
+	for (; i + 4 <= length; i += 4) {
+		__m128i c = blit_load_32(p + i);
+		c = _mm_unpacklo_epi8(c, c);
+		c = _mm_unpacklo_epi16(c, c);
+		__m256i *q = (__m256i *)(dest + i * 16);
+		_mm256_storeu_si256(q + 0, blit_expand_gather(_mm256_srlv_epi32(_mm256_cvtepu8_epi32(c), shifts)));
+		_mm256_storeu_si256(q + 1, blit_expand_gather(_mm256_srlv_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(c, 8)), shifts)));
+	}
+	if (i < length)
+		Blit_Expand_2_To_32(dest + i * 16, p + i, length - i);
+}
+
+static BLIT_TARGET("avx2") void Blit_Expand_4_To_32_AVX2(uint8 * dest, const uint8 * p, uint32 length)
+{
+	const __m256i shifts = _mm256_setr_epi32(4, 0, 4, 0, 4, 0, 4, 0);
+	uint32 i = 0;
+	for (; i + 8 <= length; i += 8) {
+		__m128i c = _mm_loadl_epi64((const __m128i *)(p + i));
+		c = _mm_unpacklo_epi8(c, c);
+		__m256i *q = (__m256i *)(dest + i * 8);
+		_mm256_storeu_si256(q + 0, blit_expand_gather(_mm256_srlv_epi32(_mm256_cvtepu8_epi32(c), shifts)));
+		_mm256_storeu_si256(q + 1, blit_expand_gather(_mm256_srlv_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(c, 8)), shifts)));
+	}
+	if (i < length)
+		Blit_Expand_4_To_32(dest + i * 8, p + i, length - i);
+}
+
+static BLIT_TARGET("avx2") void Blit_Expand_8_To_32_AVX2(uint8 * dest, const uint8 * p, uint32 length)
+{
+	uint32 i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const __m128i c = _mm_loadu_si128((const __m128i *)(p + i));
+		__m256i *q = (__m256i *)(dest + i * 4);
+		_mm256_storeu_si256(q + 0, blit_expand_gather(_mm256_cvtepu8_epi32(c)));
+		_mm256_storeu_si256(q + 1, blit_expand_gather(_mm256_cvtepu8_epi32(_mm_srli_si128(c, 8))));
+	}
+	if (i < length)
+		Blit_Expand_8_To_32(dest + i * 4, p + i, length - i);
+}
+
+#endif
+
+#if USE_BLIT_NEON
+
+static void Blit_RGB555_NBO_NEON(uint8 * dest, const uint8 * source, uint32 length)
+{
+	uint32 i = 0;
+	for (; i + 16 <= length; i += 16)
+		vst1q_u8(dest + i, vrev16q_u8(vld1q_u8(source + i)));
+	if (i < length)
+		Blit_RGB555_NBO(dest + i, source + i, length - i);
+}
+
+static void Blit_RGB565_NBO_NEON(uint8 * dest, const uint8 * source, uint32 length)
+{
+	const uint16x8_t b_mask = vdupq_n_u16(0x001f);
+	const uint16x8_t g_mask = vdupq_n_u16(0x01c0);
+	const uint16x8_t r_mask = vdupq_n_u16(0xfe00);
+	uint32 i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const uint16x8_t s = vreinterpretq_u16_u8(vld1q_u8(source + i));
+		uint16x8_t d = vandq_u16(vshrq_n_u16(s, 8), b_mask);
+		d = vorrq_u16(d, vandq_u16(vshlq_n_u16(s, 9), r_mask));
+		d = vorrq_u16(d, vandq_u16(vshrq_n_u16(s, 7), g_mask));
+		vst1q_u8(dest + i, vreinterpretq_u8_u16(d));
+	}
+	if (i < length)
+		Blit_RGB565_NBO(dest + i, source + i, length - i);
+}
+
+static void Blit_RGB888_NBO_NEON(uint8 * dest, const uint8 * source, uint32 length)
+{
+	uint32 i = 0;
+	for (; i + 16 <= length; i += 16)
+		vst1q_u8(dest + i, vrev32q_u8(vld1q_u8(source + i)));
+	if (i < length)
+		Blit_RGB888_NBO(dest + i, source + i, length - i);
+}
+
+static void Blit_BGR888_NBO_NEON(uint8 * dest, const uint8 * source, uint32 length)
+{
+	const uint32x4_t rb_mask = vdupq_n_u32(0x00ff00ff);
+	const uint32x4_t g_mask = vdupq_n_u32(0x0000ff00);
+	uint32 i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const uint32x4_t s = vreinterpretq_u32_u8(vld1q_u8(source + i));
+		const uint32x4_t d = vorrq_u32(vandq_u32(s, rb_mask), vshlq_n_u32(vandq_u32(s, g_mask), 16));
+		vst1q_u8(dest + i, vreinterpretq_u8_u32(d));
+	}
+	if (i < length)
+		Blit_BGR888_NBO(dest + i, source + i, length - i);
+}
+
+static void Blit_Expand_1_To_8_NEON(uint8 * dest, const uint8 * p, uint32 length)
+{
+	static const uint8 bit_values[8] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+	const uint8x8_t bits = vld1_u8(bit_values);
+	const uint8x8_t one = vdup_n_u8(1);
+	for (uint32 i = 0; i < length; i++)
+		vst1_u8(dest + i * 8, vand_u8(vtst_u8(vdup_n_u8(p[i]), bits), one));
+}
+
+static void Blit_Expand_2_To_8_NEON(uint8 * dest, const uint8 * p, uint32 length)
+{
+	const uint8x16_t mask = vdupq_n_u8(3);
+	uint32 i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const uint8x16_t c = vld1q_u8(p + i);
+		uint8x16x4_t f;
+		f.val[0] = vshrq_n_u8(c, 6);
+		f.val[1] = vandq_u8(vshrq_n_u8(c, 4), mask);
+		f.val[2] = vandq_u8(vshrq_n_u8(c, 2), mask);
+		f.val[3] = vandq_u8(c, mask);
+		vst4q_u8(dest + i * 4, f);
+	}
+	if (i < length)
+		Blit_Expand_2_To_8(dest + i * 4, p + i, length - i);
+}
+
+static void Blit_Expand_4_To_8_NEON(uint8 * dest, const uint8 * p, uint32 length)
+{
+	uint32 i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const uint8x16_t c = vld1q_u8(p + i);
+		uint8x16x2_t f;
+		f.val[0] = vshrq_n_u8(c, 4);
+		f.val[1] = vandq_u8(c, vdupq_n_u8(0x0f));
+		vst2q_u8(dest + i * 2, f);
+	}
+	if (i < length)
+		Blit_Expand_4_To_8(dest + i * 2, p + i, length - i);
+}
+
+static void Blit_Expand_1_To_16_NEON(uint8 * dest, const uint8 * p, uint32 length)
+{
+	static const uint16 bit_values[8] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+	const uint16x8_t bits = vld1q_u16(bit_values);
+	for (uint32 i = 0; i < length; i++)
+		vst1q_u16((uint16 *)(dest + i * 16), vtstq_u16(vdupq_n_u16(p[i]), bits));
+}
+
+static void Blit_Expand_1_To_32_NEON(uint8 * dest, const uint8 * p, uint32 length)
+{
+	static const uint32 bit_values[8] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+	const uint32x4_t bits_hi = vld1q_u32(bit_values);
+	const uint32x4_t bits_lo = vld1q_u32(bit_values + 4);
+	for (uint32 i = 0; i < length; i++) {
+		const uint32x4_t c = vdupq_n_u32(p[i]);
+		uint32 *q = (uint32 *)(dest + i * 32);
+		vst1q_u32(q + 0, vtstq_u32(c, bits_hi));
+		vst1q_u32(q + 4, vtstq_u32(c, bits_lo));
+	}
+}
+
+#endif
+
 /* -------------------------------------------------------------------------- */
 /* --- Blitters to the host frame buffer, or XImage buffer                --- */
 /* -------------------------------------------------------------------------- */
@@ -519,6 +1010,65 @@ static Screen_blit_func_info Screen_blitters[] = {
 	{ 32, 0xff00, 0xff0000, 0xff000000, Blit_Copy_Raw   , Blit_Copy_Raw     }   // OK
 };
 
+// Vectorized variants of the blitters, fastest first
+struct Screen_blit_simd_info {
+	Screen_blit_func	handler;		// Generic update function
+	Screen_blit_func	handler_simd;	// Vectorized update function
+	int					cpu_features;	// Required CPU features (BLIT_*)
+	const char *		name;			// Instruction set
+};
+
+static const Screen_blit_simd_info Screen_blitters_simd[] = {
+#if USE_BLIT_X86_SIMD
+	{ Blit_RGB555_NBO		, Blit_RGB555_NBO_AVX2		, BLIT_AVX2	, "AVX2"	},
+	{ Blit_RGB555_NBO		, Blit_RGB555_NBO_SSE2		, BLIT_SSE2	, "SSE2"	},
+	{ Blit_RGB565_NBO		, Blit_RGB565_NBO_AVX2		, BLIT_AVX2	, "AVX2"	},
+	{ Blit_RGB565_NBO		, Blit_RGB565_NBO_SSE2		, BLIT_SSE2	, "SSE2"	},
+	{ Blit_RGB888_NBO		, Blit_RGB888_NBO_AVX2		, BLIT_AVX2	, "AVX2"	},
+	{ Blit_RGB888_NBO		, Blit_RGB888_NBO_SSSE3		, BLIT_SSSE3, "SSSE3"	},
+	{ Blit_RGB888_NBO		, Blit_RGB888_NBO_SSE2		, BLIT_SSE2	, "SSE2"	},
+	{ Blit_BGR888_NBO		, Blit_BGR888_NBO_AVX2		, BLIT_AVX2	, "AVX2"	},
+	{ Blit_BGR888_NBO		, Blit_BGR888_NBO_SSE2		, BLIT_SSE2	, "SSE2"	},
+	{ Blit_Expand_1_To_8	, Blit_Expand_1_To_8_SSE2	, BLIT_SSE2	, "SSE2"	},
+	{ Blit_Expand_2_To_8	, Blit_Expand_2_To_8_SSE2	, BLIT_SSE2	, "SSE2"	},
+	{ Blit_Expand_4_To_8	, Blit_Expand_4_To_8_SSE2	, BLIT_SSE2	, "SSE2"	},
+	{ Blit_Expand_1_To_16	, Blit_Expand_1_To_16_SSE2	, BLIT_SSE2	, "SSE2"	},
+	{ Blit_Expand_2_To_16	, Blit_Expand_2_To_16_AVX2	, BLIT_AVX2	, "AVX2"	},
+	{ Blit_Expand_4_To_16	, Blit_Expand_4_To_16_AVX2	, BLIT_AVX2	, "AVX2"	},
+	{ Blit_Expand_8_To_16	, Blit_Expand_8_To_16_AVX2	, BLIT_AVX2	, "AVX2"	},
+	{ Blit_Expand_1_To_32	, Blit_Expand_1_To_32_SSE2	, BLIT_SSE2	, "SSE2"	},
+	{ Blit_Expand_2_To_32	, Blit_Expand_2_To_32_AVX2	, BLIT_AVX2	, "AVX2"	},
+	{ Blit_Expand_4_To_32	, Blit_Expand_4_To_32_AVX2	, BLIT_AVX2	, "AVX2"	},
+	{ Blit_Expand_8_To_32	, Blit_Expand_8_To_32_AVX2	, BLIT_AVX2	, "AVX2"	},
+#endif
+#if USE_BLIT_NEON
+	{ Blit_RGB555_NBO		, Blit_RGB555_NBO_NEON		, BLIT_NEON	, "NEON"	},
+	{ Blit_RGB565_NBO		, Blit_RGB565_NBO_NEON		, BLIT_NEON	, "NEON"	},
+	{ Blit_RGB888_NBO		, Blit_RGB888_NBO_NEON		, BLIT_NEON	, "NEON"	},
+	{ Blit_BGR888_NBO		, Blit_BGR888_NBO_NEON		, BLIT_NEON	, "NEON"	},
+	{ Blit_Expand_1_To_8	, Blit_Expand_1_To_8_NEON	, BLIT_NEON	, "NEON"	},
+	{ Blit_Expand_2_To_8	, Blit_Expand_2_To_8_NEON	, BLIT_NEON	, "NEON"	},
+	{ Blit_Expand_4_To_8	, Blit_Expand_4_To_8_NEON	, BLIT_NEON	, "NEON"	},
+	{ Blit_Expand_1_To_16	, Blit_Expand_1_To_16_NEON	, BLIT_NEON	, "NEON"	},
+	{ Blit_Expand_1_To_32	, Blit_Expand_1_To_32_NEON	, BLIT_NEON	, "NEON"	},
+#endif
+	{ NULL, NULL, 0, NULL }
+};
+
+// Return the fastest variant of HANDLER this CPU supports
+static Screen_blit_func Screen_blit_simd(Screen_blit_func handler)
+{
+	static int cpu_features = -1;
+	if (cpu_features < 0)
+		cpu_features = blit_cpu_features();
+
+	for (const Screen_blit_simd_info *b = Screen_blitters_simd; b->handler; b++) {
+		if (b->handler == handler && (b->cpu_features & ~cpu_features) == 0)
+			return b->handler_simd;
+	}
+	return handler;
+}
+
 // Initialize the framebuffer update function
 // Returns FALSE, if the function was to be reduced to a simple memcpy()
 // --> In that case, VOSF is not necessary
@@ -629,5 +1179,9 @@ bool Screen_blitter_init(VisualFormat const & visual_format, bool native_byte_or
 	
 	// If the blitter simply reduces to a copy, we don't need VOSF in DGA mode
 	// --> In that case, we return FALSE
-	return (Screen_blit != Blit_Copy_Raw);
+	const bool needs_blit = (Screen_blit != Blit_Copy_Raw);
+
+	// Use a vectorized blitter if possible
+	Screen_blit = Screen_blit_simd(Screen_blit);
+	return needs_blit;
 }
@@ -0,0 +1,1158 @@
+/*
+ *  video_headless.cpp - Video/graphics emulation, headless (no display)
+ *
+ *  Basilisk II (C) 1997-2008 Christian Bauer
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ *  NOTES:
+ *    The Mac frame buffer only lives in memory: nothing is displayed and
+ *    there is no keyboard or mouse input. It keeps the Mac pixel layout
+ *    in all addressing modes.
+ *
+ *    Refreshes happen from the VBL interrupt, every "frameskip" VBLs,
+ *    in the emulation thread. They find what changed with VOSF when it is
+ *    enabled and profitable, and with tile fingerprints otherwise. Their
+ *    count and cost are printed when the emulator quits.
+ *
+ *    Refreshed frames (or only those that changed, with "capturechanged")
+ *    can be written to "capturefile", in one of these "captureformat"s:
+ *      raw  24-bit RGB frames, one after the other
+ *      y4m  YUV4MPEG2 stream, 4:4:4 Y'CbCr (ITU-R BT.601)
+ *      png  one file per frame, "capturefile" is a printf() pattern for
+ *           the refresh number, e.g. "frame%06d.png"
+ *    raw and y4m streams keep the size of their first frame, frames of
+ *    other video modes are not written to them.
+ */
+
+#include "sysdeps.h"
+
+#include <errno.h>
+#include <vector>
+
+#include "cpu_emulation.h"
+#include "main.h"
+#include "prefs.h"
+#include "user_strings.h"
+#include "video.h"
+#include "video_defs.h"
+#include "video_blit.h"
+#include "video_tiles.h"
+#include "vm_alloc.h"
+
+#define DEBUG 0
+#include "debug.h"
+
+// Supported video modes
+using std::vector;
+static vector<VIDEO_MODE> VideoModes;
+
+
+// Global variables
+static uint32 frame_skip;							// Prefs items
+
+static uint8 *the_buffer = NULL;					// Mac frame buffer (where MacOS draws into)
+static uint32 the_buffer_size;						// Size of allocated the_buffer
+
+#ifdef ENABLE_VOSF
+static bool use_vosf = false;						// Flag: VOSF enabled
+#else
+static const bool use_vosf = false;					// VOSF not possible
+#endif
+
+static bool classic_mode = false;					// Flag: Classic Mac video mode
+static bool video_opened = false;					// Flag: Frame buffer allocated
+
+static video_tiles screen_tiles;					// Tile fingerprints of the frame buffer (without VOSF)
+static uint8 palette[256 * 3];						// Mac color palette, RGB
+static bool palette_changed = false;				// Flag: whole frame looks different at next refresh
+static uint32 tick_counter = 0;						// VBLs since last refresh
+static uint32 refresh_number = 0;					// Number of the next refresh
+
+// Refresh statistics
+static uint64 stats_start;							// Time of VideoInit()
+static uint64 stats_refreshes;						// Refreshes
+static uint64 stats_changed;						// Refreshes that found changes
+static uint64 stats_changed_bytes;					// Frame buffer bytes reported as changed
+static uint64 stats_refresh_usec;					// Time spent looking for changes
+static uint64 stats_captures;						// Frames written
+static uint64 stats_capture_usec;					// Time spent writing frames
+
+// Frame capture
+enum {
+	CAPTURE_NONE,
+	CAPTURE_RAW,
+	CAPTURE_Y4M,
+	CAPTURE_PNG
+};
+
+static int capture_format = CAPTURE_NONE;			// Format of captured frames
+static const char *capture_file = NULL;				// File (pattern for PNG) to write frames to
+static bool capture_changed = false;				// Flag: only capture frames that changed
+static FILE *capture_stream = NULL;					// raw/y4m output
+static uint32 capture_width, capture_height;		// Frame size of the raw/y4m output
+static uint8 *capture_rgb = NULL;					// Frame converted to 24-bit RGB
+static uint8 *capture_line = NULL;					// Filtered PNG row, or Y'CbCr plane
+static uint32 capture_rgb_size, capture_line_size;
+
+
+/*
+ *  Framebuffer allocation routines
+ */
+
+static void *vm_acquire_framebuffer(uint32 size)
+{
+	// always try to reallocate framebuffer at the same address
+	static void *fb = VM_MAP_FAILED;
+	if (fb != VM_MAP_FAILED) {
+		if (vm_acquire_fixed(fb, size) < 0) {
+#ifndef SHEEPSHAVER
+			printf("FATAL: Could not reallocate framebuffer at previous address\n");
+#endif
+			fb = VM_MAP_FAILED;
+		}
+	}
+	if (fb == VM_MAP_FAILED)
+		fb = vm_acquire(size, VM_MAP_DEFAULT | VM_MAP_32BIT);
+	return fb;
+}
+
+static inline void vm_release_framebuffer(void *fb, uint32 size)
+{
+	vm_release(fb, size);
+}
+
+static inline int get_customized_color_depth(int default_depth)
+{
+	int display_color_depth = PrefsFindInt32("displaycolordepth");
+
+	D(bug("Get displaycolordepth %d\n", display_color_depth));
+
+	if(0 == display_color_depth)
+		return default_depth;
+	else{
+		switch (display_color_depth) {
+		case 1:
+			return VIDEO_DEPTH_1BIT;
+		case 2:
+			return VIDEO_DEPTH_2BIT;
+		case 4:
+			return VIDEO_DEPTH_4BIT;
+		case 8:
+			return VIDEO_DEPTH_8BIT;
+		case 15: case 16:
+			return VIDEO_DEPTH_16BIT;
+		case 24: case 32:
+			return VIDEO_DEPTH_32BIT;
+		default:
+			return default_depth;
+		}
+	}
+}
+
+
+/*
+ *  SheepShaver glue
+ */
+
+#ifdef SHEEPSHAVER
+// Color depth modes type
+typedef int video_depth;
+
+// 1, 2, 4 and 8 bit depths use a color palette
+static inline bool IsDirectMode(VIDEO_MODE const & mode)
+{
+	return IsDirectMode(mode.viAppleMode);
+}
+
+// Find Apple mode matching best specified dimensions
+static int find_apple_resolution(int xsize, int ysize)
+{
+	if (xsize == 640 && ysize == 480)
+		return APPLE_640x480;
+	if (xsize == 800 && ysize == 600)
+		return APPLE_800x600;
+	if (xsize == 1024 && ysize == 768)
+		return APPLE_1024x768;
+	if (xsize == 1152 && ysize == 768)
+		return APPLE_1152x768;
+	if (xsize == 1152 && ysize == 900)
+		return APPLE_1152x900;
+	if (xsize == 1280 && ysize == 1024)
+		return APPLE_1280x1024;
+	if (xsize == 1600 && ysize == 1200)
+		return APPLE_1600x1200;
+	return APPLE_CUSTOM;
+}
+
+// Display error alert
+static void ErrorAlert(int error)
+{
+	ErrorAlert(GetString(error));
+}
+
+// Get current video mode
+static inline const VIDEO_MODE &get_current_mode(void)
+{
+	return VModes[cur_mode];
+}
+#else
+
+/*
+ *  monitor_desc subclass for headless display
+ */
+
+class Headless_monitor_desc : public monitor_desc {
+public:
+	Headless_monitor_desc(const vector<VIDEO_MODE> &available_modes, video_depth default_depth, uint32 default_id) : monitor_desc(available_modes, default_depth, default_id) {}
+	~Headless_monitor_desc() {}
+
+	virtual void switch_to_current_mode(void);
+	virtual void set_palette(uint8 *pal, int num);
+	virtual void set_gamma(uint8 *gamma, int num);
+};
+
+static Headless_monitor_desc *the_monitor = NULL;	// The only display
+
+// Get current video mode
+static inline const VIDEO_MODE &get_current_mode(void)
+{
+	return the_monitor->get_current_mode();
+}
+#endif
+
+
+/*
+ *  Utility functions
+ */
+
+#ifdef SHEEPSHAVER
+// Find palette size for given color depth
+static int palette_size(int mode)
+{
+	switch (mode) {
+	case VIDEO_DEPTH_1BIT: return 2;
+	case VIDEO_DEPTH_2BIT: return 4;
+	case VIDEO_DEPTH_4BIT: return 16;
+	case VIDEO_DEPTH_8BIT: return 256;
+	case VIDEO_DEPTH_16BIT: return 32;
+	case VIDEO_DEPTH_32BIT: return 256;
+	default: return 0;
+	}
+}
+#endif
+
+// Map video_mode depth ID to numerical depth value
+static int mac_depth_of_video_depth(int video_depth)
+{
+	int depth = -1;
+	switch (video_depth) {
+	case VIDEO_DEPTH_1BIT:
+		depth = 1;
+		break;
+	case VIDEO_DEPTH_2BIT:
+		depth = 2;
+		break;
+	case VIDEO_DEPTH_4BIT:
+		depth = 4;
+		break;
+	case VIDEO_DEPTH_8BIT:
+		depth = 8;
+		break;
+	case VIDEO_DEPTH_16BIT:
+		depth = 16;
+		break;
+	case VIDEO_DEPTH_32BIT:
+		depth = 32;
+		break;
+	default:
+		abort();
+	}
+	return depth;
+}
+
+// Add mode to list of supported modes
+static void add_mode(int width, int height, int resolution_id, int bytes_per_row, int depth)
+{
+	// Fill in VideoMode entry
+	VIDEO_MODE mode;
+#ifdef SHEEPSHAVER
+	resolution_id = find_apple_resolution(width, height);
+	mode.viType = DIS_WINDOW;
+#endif
+	VIDEO_MODE_X = width;
+	VIDEO_MODE_Y = height;
+	VIDEO_MODE_RESOLUTION = resolution_id;
+	VIDEO_MODE_ROW_BYTES = bytes_per_row;
+	VIDEO_MODE_DEPTH = (video_depth)depth;
+	VideoModes.push_back(mode);
+}
+
+// Set Mac frame layout and base address (uses the_buffer/MacFrameBaseMac)
+static void set_mac_frame_buffer(void)
+{
+#ifdef SHEEPSHAVER
+	screen_base = Host2MacAddr(the_buffer);
+	D(bug("screen_base = %08x\n", screen_base));
+#else
+#if !REAL_ADDRESSING && !DIRECT_ADDRESSING
+	// Keep Mac pixels as they are, captured frames are converted from them
+	MacFrameLayout = FLAYOUT_DIRECT;
+	the_monitor->set_mac_frame_base(MacFrameBaseMac);
+
+	// Set variables used by UAE memory banking
+	const VIDEO_MODE &mode = get_current_mode();
+	MacFrameBaseHost = the_buffer;
+	MacFrameSize = VIDEO_MODE_ROW_BYTES * VIDEO_MODE_Y;
+	InitFrameBufferMapping();
+#else
+	the_monitor->set_mac_frame_base(Host2MacAddr(the_buffer));
+#endif
+	D(bug("monitor.mac_frame_base = %08x\n", the_monitor->get_mac_frame_base()));
+#endif
+}
+
+#ifdef ENABLE_VOSF
+# include "video_vosf.h"
+#endif
+
+
+/*
+ *  Frame capture
+ */
+
+// Check that the PNG file pattern holds a single %d conversion
+static bool capture_pattern_ok(const char *pattern)
+{
+	int n_conversions = 0;
+	for (const char *p = pattern; *p; p++) {
+		if (*p != '%')
+			continue;
+		if (*++p == '%')
+			continue;
+		while (*p == '0' || *p == '-' || *p == ' ' || *p == '+')
+			p++;
+		while (*p >= '0' && *p <= '9')
+			p++;
+		if (*p != 'd' && *p != 'u')
+			return false;
+		n_conversions++;
+	}
+	return n_conversions == 1;
+}
+
+static void capture_init(void)
+{
+	capture_format = CAPTURE_NONE;
+	capture_file = PrefsFindString("capturefile");
+	if (capture_file == NULL)
+		return;
+	capture_changed = PrefsFindBool("capturechanged");
+
+	int format = CAPTURE_PNG;
+	const char *format_str = PrefsFindString("captureformat");
+	if (format_str) {
+		if (strcmp(format_str, "raw") == 0)
+			format = CAPTURE_RAW;
+		else if (strcmp(format_str, "y4m") == 0)
+			format = CAPTURE_Y4M;
+		else if (strcmp(format_str, "png") != 0) {
+			fprintf(stderr, "WARNING: Unknown captureformat '%s'\n", format_str);
+			return;
+		}
+	}
+
+	if (format == CAPTURE_PNG) {
+		if (!capture_pattern_ok(capture_file)) {
+			fprintf(stderr, "WARNING: capturefile '%s' must hold one %%d for the frame number\n", capture_file);
+			return;
+		}
+	} else {
+		capture_stream = fopen(capture_file, "wb");
+		if (capture_stream == NULL) {
+			fprintf(stderr, "WARNING: Could not create %s (%s)\n", capture_file, strerror(errno));
+			return;
+		}
+		capture_width = capture_height = 0;
+	}
+	capture_format = format;
+}
+
+static void capture_exit(void)
+{
+	if (capture_stream) {
+		fclose(capture_stream);
+		capture_stream = NULL;
+	}
+	free(capture_rgb);
+	capture_rgb = NULL;
+	capture_rgb_size = 0;
+	free(capture_line);
+	capture_line = NULL;
+	capture_line_size = 0;
+	capture_format = CAPTURE_NONE;
+}
+
+// Make sure *BUF holds SIZE bytes
+static bool capture_reserve(uint8 **buf, uint32 *buf_size, uint32 size)
+{
+	if (*buf_size >= size)
+		return true;
+	uint8 *p = (uint8 *)realloc(*buf, size);
+	if (p == NULL)
+		return false;
+	*buf = p;
+	*buf_size = size;
+	return true;
+}
+
+// Convert the Mac frame buffer to 24-bit RGB in capture_rgb
+static bool capture_convert(const VIDEO_MODE &mode)
+{
+	const uint32 width = VIDEO_MODE_X, height = VIDEO_MODE_Y;
+	if (!capture_reserve(&capture_rgb, &capture_rgb_size, width * height * 3))
+		return false;
+
+	const int depth = mac_depth_of_video_depth(VIDEO_MODE_DEPTH);
+	uint8 *q = capture_rgb;
+	for (uint32 y = 0; y < height; y++) {
+		const uint8 *p = the_buffer + y * VIDEO_MODE_ROW_BYTES;
+		switch (depth) {
+		case 1: case 2: case 4: case 8: {
+			const int pixels_per_byte = 8 / depth;
+			const uint8 mask = (1 << depth) - 1;
+			for (uint32 x = 0; x < width; x++) {
+				const int shift = 8 - depth - (x % pixels_per_byte) * depth;
+				const uint8 *c = &palette[((p[x / pixels_per_byte] >> shift) & mask) * 3];
+				*q++ = c[0];
+				*q++ = c[1];
+				*q++ = c[2];
+			}
+			break;
+		}
+		case 16:
+			for (uint32 x = 0; x < width; x++, p += 2) {
+				// Big-endian x:1 R:5 G:5 B:5
+				const uint32 v = (p[0] << 8) | p[1];
+				const uint32 r = (v >> 10) & 0x1f, g = (v >> 5) & 0x1f, b = v & 0x1f;
+				*q++ = (r << 3) | (r >> 2);
+				*q++ = (g << 3) | (g >> 2);
+				*q++ = (b << 3) | (b >> 2);
+			}
+			break;
+		case 32:
+			for (uint32 x = 0; x < width; x++, p += 4) {
+				// Big-endian x:8 R:8 G:8 B:8
+				*q++ = p[1];
+				*q++ = p[2];
+				*q++ = p[3];
+			}
+			break;
+		}
+	}
+	return true;
+}
+
+// Write the converted frame to the Y4M stream
+static bool capture_y4m(uint32 width, uint32 height)
+{
+	if (capture_width == 0) {
+		capture_width = width;
+		capture_height = height;
+		fprintf(capture_stream, "YUV4MPEG2 W%u H%u F60:%u Ip A1:1 C444\n", width, height, frame_skip ? frame_skip : 1);
+	}
+	const uint32 n_pixels = width * height;
+	if (!capture_reserve(&capture_line, &capture_line_size, n_pixels * 3))
+		return false;
+
+	// Planes of Y', Cb and Cr, in studio range
+	uint8 *y_plane = capture_line, *cb_plane = y_plane + n_pixels, *cr_plane = cb_plane + n_pixels;
+	const uint8 *p = capture_rgb;
+	for (uint32 i = 0; i < n_pixels; i++, p += 3) {
+		const int r = p[0], g = p[1], b = p[2];
+		y_plane[i] = (( 66 * r + 129 * g +  25 * b + 128) >> 8) + 16;
+		cb_plane[i] = ((-38 * r -  74 * g + 112 * b + 128) >> 8) + 128;
+		cr_plane[i] = ((112 * r -  94 * g -  18 * b + 128) >> 8) + 128;
+	}
+	fputs("FRAME\n", capture_stream);
+	return fwrite(capture_line, 1, n_pixels * 3, capture_stream) == n_pixels * 3;
+}
+
+// CRC-32 of PNG chunks
+static uint32 png_crc_table[256];
+
+static uint32 png_crc(uint32 crc, const uint8 *p, uint32 len)
+{
+	if (png_crc_table[1] == 0) {
+		for (uint32 n = 0; n < 256; n++) {
+			uint32 c = n;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			png_crc_table[n] = c;
+		}
+	}
+	for (uint32 i = 0; i < len; i++)
+		crc = png_crc_table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+static inline void png_put_be32(uint8 *p, uint32 v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+// Output of a chunk whose data is written piecewise
+struct png_chunk_writer {
+	FILE *f;
+	uint32 crc;
+};
+
+static void png_chunk_begin(png_chunk_writer *w, FILE *f, const char *type, uint32 len)
+{
+	uint8 header[8];
+	png_put_be32(header, len);
+	memcpy(header + 4, type, 4);
+	fwrite(header, 1, 8, f);
+	w->f = f;
+	w->crc = png_crc(0xffffffff, header + 4, 4);
+}
+
+static inline void png_chunk_write(png_chunk_writer *w, const uint8 *p, uint32 len)
+{
+	w->crc = png_crc(w->crc, p, len);
+	fwrite(p, 1, len, w->f);
+}
+
+static void png_chunk_end(png_chunk_writer *w)
+{
+	uint8 crc[4];
+	png_put_be32(crc, w->crc ^ 0xffffffff);
+	fwrite(crc, 1, 4, w->f);
+}
+
+// Write the converted frame to a PNG file. The image data is a zlib
+// stream of stored (uncompressed) deflate blocks: it costs no more than a
+// copy and needs no zlib.
+static bool capture_png(uint32 width, uint32 height)
+{
+	char name[1024];
+	snprintf(name, sizeof(name), capture_file, refresh_number);
+	FILE *f = fopen(name, "wb");
+	if (f == NULL)
+		return false;
+
+	static const uint8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	fwrite(signature, 1, sizeof(signature), f);
+
+	png_chunk_writer w;
+	uint8 ihdr[13];
+	png_put_be32(ihdr, width);
+	png_put_be32(ihdr + 4, height);
+	ihdr[8] = 8;		// Bits per sample
+	ihdr[9] = 2;		// RGB
+	ihdr[10] = 0;		// Deflate
+	ihdr[11] = 0;		// No filtering
+	ihdr[12] = 0;		// Not interlaced
+	png_chunk_begin(&w, f, "IHDR", sizeof(ihdr));
+	png_chunk_write(&w, ihdr, sizeof(ihdr));
+	png_chunk_end(&w);
+
+	// Each row (filter type 0 and pixels) goes in blocks of at most 64K
+	const uint32 MAX_BLOCK = 0xffff;
+	const uint32 row_size = 1 + width * 3;
+	const uint32 row_blocks = (row_size + MAX_BLOCK - 1) / MAX_BLOCK;
+	if (!capture_reserve(&capture_line, &capture_line_size, row_size)) {
+		fclose(f);
+		return false;
+	}
+	png_chunk_begin(&w, f, "IDAT", 2 + height * (row_blocks * 5 + row_size) + 4);
+	static const uint8 zlib_header[2] = { 0x78, 0x01 };
+	png_chunk_write(&w, zlib_header, sizeof(zlib_header));
+	uint32 adler_a = 1, adler_b = 0;
+	for (uint32 y = 0; y < height; y++) {
+		capture_line[0] = 0;
+		memcpy(capture_line + 1, capture_rgb + y * width * 3, width * 3);
+		for (uint32 i = 0; i < row_size; i += MAX_BLOCK) {
+			const uint32 n = (row_size - i < MAX_BLOCK) ? row_size - i : MAX_BLOCK;
+			const uint8 header[5] = {
+				uint8(y == height - 1 && i + n == row_size),	// Last block?
+				uint8(n), uint8(n >> 8), uint8(~n), uint8(~n >> 8)
+			};
+			png_chunk_write(&w, header, sizeof(header));
+			png_chunk_write(&w, capture_line + i, n);
+		}
+
+		// Adler-32 of the uncompressed data, 5552 bytes at most before a modulo
+		for (uint32 i = 0; i < row_size; ) {
+			const uint32 end = (row_size - i < 5552) ? row_size : i + 5552;
+			for (; i < end; i++) {
+				adler_a += capture_line[i];
+				adler_b += adler_a;
+			}
+			adler_a %= 65521;
+			adler_b %= 65521;
+		}
+	}
+	uint8 adler[4];
+	png_put_be32(adler, (adler_b << 16) | adler_a);
+	png_chunk_write(&w, adler, sizeof(adler));
+	png_chunk_end(&w);
+
+	png_chunk_begin(&w, f, "IEND", 0);
+	png_chunk_end(&w);
+
+	const bool ok = !ferror(f);
+	return (fclose(f) == 0) && ok;
+}
+
+// Write the current frame
+static void capture_frame(void)
+{
+	const VIDEO_MODE &mode = get_current_mode();
+	const uint32 width = VIDEO_MODE_X, height = VIDEO_MODE_Y;
+
+	// Streams have a single frame size
+	if (capture_format != CAPTURE_PNG && capture_width && (width != capture_width || height != capture_height))
+		return;
+
+	uint64 start = GetTicks_usec();
+	bool ok = capture_convert(mode);
+	if (ok) {
+		switch (capture_format) {
+		case CAPTURE_RAW:
+			capture_width = width;
+			capture_height = height;
+			ok = fwrite(capture_rgb, 1, width * height * 3, capture_stream) == width * height * 3;
+			break;
+		case CAPTURE_Y4M:
+			ok = capture_y4m(width, height);
+			break;
+		case CAPTURE_PNG:
+			ok = capture_png(width, height);
+			break;
+		}
+	}
+	if (!ok) {
+		fprintf(stderr, "WARNING: Could not write frame %u to %s, capture stopped\n", refresh_number, capture_file);
+		capture_exit();
+		return;
+	}
+	stats_captures++;
+	stats_capture_usec += GetTicks_usec() - start;
+}
+
+
+/*
+ *  Screen refresh
+ */
+
+#ifdef ENABLE_VOSF
+// Report the Mac scanlines whose pages were written to, return the number of bytes they hold
+static uint32 update_display_vosf(void)
+{
+	const VIDEO_MODE &mode = get_current_mode();
+
+	uint32 n_rows = 0;
+	unsigned page = 0;
+	for (;;) {
+		const unsigned first_page = find_next_page_set(page);
+		if (first_page >= mainBuffer.pageCount)
+			break;
+
+		page = find_next_page_clear(first_page);
+		PFLAG_CLEAR_RANGE(first_page, page);
+
+		// Make the dirty pages read-only again
+		vosf_protect_pages(first_page, page);
+
+		const int y1 = mainBuffer.pageInfo[first_page].top;
+		const int y2 = mainBuffer.pageInfo[page - 1].bottom;
+		n_rows += y2 - y1 + 1;
+	}
+	mainBuffer.dirty = false;
+	return n_rows * VIDEO_MODE_ROW_BYTES;
+}
+#endif
+
+// Look for changes in the frame buffer, return the number of bytes reported as changed
+static uint32 update_display_static(void)
+{
+	const uint32 n_tiles = video_tiles_scan(&screen_tiles, the_buffer);
+	return n_tiles * screen_tiles.tile_bytes * VIDEO_TILE_ROWS;
+}
+
+static void video_refresh(void)
+{
+	if (!video_opened)
+		return;
+
+	// Update display every "frameskip" VBLs
+	if (++tick_counter < frame_skip)
+		return;
+	tick_counter = 0;
+
+	uint64 start = GetTicks_usec();
+	uint32 changed_bytes = 0;
+#ifdef ENABLE_VOSF
+	if (use_vosf) {
+		if (video_vosf_dirty()) {
+			LOCK_VOSF;
+			changed_bytes = update_display_vosf();
+			UNLOCK_VOSF;
+		}
+	}
+	else
+#endif
+		changed_bytes = update_display_static();
+	if (palette_changed) {
+		const VIDEO_MODE &mode = get_current_mode();
+		changed_bytes = VIDEO_MODE_ROW_BYTES * VIDEO_MODE_Y;
+		palette_changed = false;
+	}
+	stats_refresh_usec += GetTicks_usec() - start;
+	stats_refreshes++;
+	if (changed_bytes) {
+		stats_changed++;
+		stats_changed_bytes += changed_bytes;
+	}
+
+	if (capture_format != CAPTURE_NONE && (changed_bytes || !capture_changed))
+		capture_frame();
+	refresh_number++;
+}
+
+// Report refresh and capture costs
+static void video_print_stats(void)
+{
+	const double elapsed = double(GetTicks_usec() - stats_start) / 1e6;
+	if (stats_refreshes == 0 || elapsed <= 0)
+		return;
+	printf("Headless video: %llu refreshes in %.1f sec, %llu with changes (%.1f per sec, %.1f MB changed), %.1f usec per refresh (%s)\n",
+		   (unsigned long long)stats_refreshes, elapsed,
+		   (unsigned long long)stats_changed, double(stats_changed) / elapsed,
+		   double(stats_changed_bytes) / (1024 * 1024),
+		   double(stats_refresh_usec) / double(stats_refreshes),
+		   use_vosf ? "VOSF" : "tiles");
+	if (stats_captures)
+		printf("Headless video: %llu frames captured, %.1f usec per frame\n",
+			   (unsigned long long)stats_captures, double(stats_capture_usec) / double(stats_captures));
+}
+
+
+/*
+ *  Initialization
+ */
+
+// Allocate frame buffer for current mode
+static bool video_open(void)
+{
+	const VIDEO_MODE &mode = get_current_mode();
+	D(bug("video_open()\n"));
+	D(bug(" %dx%d (ID %02x), %d bpp\n", VIDEO_MODE_X, VIDEO_MODE_Y, VIDEO_MODE_RESOLUTION, mac_depth_of_video_depth(VIDEO_MODE_DEPTH)));
+
+	int aligned_height = (VIDEO_MODE_Y + 15) & ~15;
+	the_buffer = (uint8 *)VM_MAP_FAILED;
+
+#ifdef ENABLE_VOSF
+	use_vosf = true;
+	// Allocate memory for frame buffer (SIZE is extended to page-boundary)
+	the_buffer_size = page_extend((aligned_height + 2) * VIDEO_MODE_ROW_BYTES);
+	the_buffer = (uint8 *)vm_acquire_framebuffer(the_buffer_size);
+	the_host_buffer = NULL;
+	D(bug("the_buffer = %p\n", the_buffer));
+
+	// Check whether we can initialize the VOSF subsystem and it's profitable
+	if (the_buffer == VM_MAP_FAILED)
+		use_vosf = false;
+#ifdef SHEEPSHAVER
+	else if (!video_vosf_init()) {
+#else
+	else if (!video_vosf_init(*the_monitor)) {
+#endif
+		WarningAlert(GetString(STR_VOSF_INIT_ERR));
+		video_vosf_exit();
+		use_vosf = false;
+	}
+	else if (!video_vosf_profitable()) {
+		video_vosf_exit();
+		printf("VOSF acceleration is not profitable on this platform, disabling it\n");
+		use_vosf = false;
+	}
+	if (!use_vosf && the_buffer != VM_MAP_FAILED) {
+		vm_release_framebuffer(the_buffer, the_buffer_size);
+		the_buffer = (uint8 *)VM_MAP_FAILED;
+	}
+#endif
+	if (!use_vosf) {
+		// Allocate memory for frame buffer
+		the_buffer_size = (aligned_height + 2) * VIDEO_MODE_ROW_BYTES;
+		the_buffer = (uint8 *)vm_acquire_framebuffer(the_buffer_size);
+		if (the_buffer == VM_MAP_FAILED)
+			return false;
+		memset(the_buffer, 0, the_buffer_size);
+		D(bug("the_buffer = %p\n", the_buffer));
+
+		// Changes are found by tiles of 64 pixels (but at least 32 bytes) x 16 rows
+		const int depth = mac_depth_of_video_depth(VIDEO_MODE_DEPTH);
+		const uint32 tile_bytes = depth < 4 ? 32 : 8 * depth;
+		video_tiles_init(&screen_tiles, TrivialBytesPerRow(VIDEO_MODE_X, VIDEO_MODE_DEPTH), VIDEO_MODE_Y, VIDEO_MODE_ROW_BYTES, tile_bytes);
+	}
+
+	// Set frame buffer base
+	set_mac_frame_buffer();
+
+	tick_counter = 0;
+	video_opened = true;
+	return true;
+}
+
+#ifdef SHEEPSHAVER
+bool VideoInit(void)
+{
+	const bool classic = false;
+#else
+bool VideoInit(bool classic)
+{
+#endif
+	classic_mode = classic;
+
+#ifdef ENABLE_VOSF
+	// Zero the mainBuffer structure
+	mainBuffer.dirtyPages = NULL;
+	mainBuffer.pageInfo = NULL;
+#endif
+
+	// Read prefs
+	frame_skip = PrefsFindInt32("frameskip");
+
+	// Get screen mode from preferences
+	const char *mode_str = NULL;
+	if (classic_mode)
+		mode_str = "win/512/342";
+	else
+		mode_str = PrefsFindString("screen");
+
+	// Determine default dimensions, there is no display to limit them
+	int default_width, default_height;
+	if (classic) {
+		default_width = 512;
+		default_height = 384;
+	}
+	else {
+		default_width = 640;
+		default_height = 480;
+	}
+	if (mode_str) {
+		if (sscanf(mode_str, "win/%d/%d", &default_width, &default_height) != 2)
+			sscanf(mode_str, "dga/%d/%d", &default_width, &default_height);
+	}
+	if (default_width <= 0)
+		default_width = 640;
+	if (default_height <= 0)
+		default_height = 480;
+
+	// All depths are available, the default one is the deepest
+	int default_depth = VIDEO_DEPTH_32BIT;
+
+	// Initialize list of video modes to try
+	struct {
+		int w;
+		int h;
+		int resolution_id;
+	}
+#ifdef SHEEPSHAVER
+	// Omit Classic resolutions
+	video_modes[] = {
+		{   -1,   -1, 0x80 },
+		{  640,  480, 0x81 },
+		{  800,  600, 0x82 },
+		{ 1024,  768, 0x83 },
+		{ 1152,  870, 0x84 },
+		{ 1280, 1024, 0x85 },
+		{ 1600, 1200, 0x86 },
+		{ 0, }
+	};
+#else
+	video_modes[] = {
+		{   -1,   -1, 0x80 },
+		{  512,  384, 0x80 },
+		{  640,  480, 0x81 },
+		{  800,  600, 0x82 },
+		{ 1024,  768, 0x83 },
+		{ 1152,  870, 0x84 },
+		{ 1280, 1024, 0x85 },
+		{ 1600, 1200, 0x86 },
+		{ 0, }
+	};
+#endif
+	video_modes[0].w = default_width;
+	video_modes[0].h = default_height;
+
+	// Construct list of supported modes
+	if (classic)
+		add_mode(512, 342, 0x80, 64, VIDEO_DEPTH_1BIT);
+	else {
+		for (int i = 0; video_modes[i].w != 0; i++) {
+			const int w = video_modes[i].w;
+			const int h = video_modes[i].h;
+			if (i > 0 && (w >= default_width || h >= default_height))
+				continue;
+			for (int d = VIDEO_DEPTH_1BIT; d <= default_depth; d++)
+				add_mode(w, h, video_modes[i].resolution_id, TrivialBytesPerRow(w, (video_depth)d), d);
+		}
+	}
+
+	// Start with the requested depth at the default dimensions
+	int color_depth = get_customized_color_depth(default_depth);
+	if (classic)
+		color_depth = VIDEO_DEPTH_1BIT;
+	D(bug("Return get_customized_color_depth %d\n", color_depth));
+
+#ifdef SHEEPSHAVER
+	cur_mode = 0;
+	for (int i = 0; i < (int)VideoModes.size(); i++) {
+		if ((int)VideoModes[i].viXsize == default_width && (int)VideoModes[i].viYsize == default_height && (int)VideoModes[i].viAppleMode == color_depth)
+			cur_mode = i;
+		VModes[i] = VideoModes[i];
+	}
+	VideoInfo *p = &VModes[VideoModes.size()];
+	p->viType = DIS_INVALID;        // End marker
+	p->viRowBytes = 0;
+	p->viXsize = p->viYsize = 0;
+	p->viAppleMode = 0;
+	p->viAppleID = 0;
+	display_type = DIS_WINDOW;
+#else
+	// Create Headless_monitor_desc for this (the only) display, the first
+	// modes have the default dimensions
+	const VIDEO_MODE &mode = VideoModes[0];
+	the_monitor = new Headless_monitor_desc(VideoModes, (video_depth)color_depth, VIDEO_MODE_RESOLUTION);
+	VideoMonitors.push_back(the_monitor);
+#endif
+
+	// Set up frame capture
+	capture_init();
+	stats_start = GetTicks_usec();
+
+	// Allocate frame buffer
+	return video_open();
+}
+
+
+/*
+ *  Deinitialization
+ */
+
+// Release frame buffer
+static void video_close(void)
+{
+	D(bug("video_close()\n"));
+	video_opened = false;
+
+#ifdef ENABLE_VOSF
+	if (use_vosf)
+		video_vosf_exit();
+#endif
+	if (!use_vosf)
+		video_tiles_exit(&screen_tiles);
+
+	// the_buffer shall always be mapped through vm_acquire_framebuffer()
+	if (the_buffer != VM_MAP_FAILED && the_buffer != NULL) {
+		D(bug(" releasing the_buffer at %p (%d bytes)\n", the_buffer, the_buffer_size));
+		vm_release_framebuffer(the_buffer, the_buffer_size);
+		the_buffer = NULL;
+	}
+}
+
+void VideoExit(void)
+{
+	if (video_opened)
+		video_close();
+	video_print_stats();
+	capture_exit();
+}
+
+
+/*
+ *  Close down full-screen mode (if bringing up error alerts is unsafe while in full-screen mode)
+ */
+
+void VideoQuitFullScreen(void)
+{
+}
+
+
+/*
+ *  Execute video VBL routine
+ */
+
+#ifdef SHEEPSHAVER
+void VideoVBL(void)
+{
+	video_refresh();
+
+	// Execute video VBL
+	if (private_data != NULL && private_data->interruptsEnabled)
+		VSLDoInterruptService(private_data->vslServiceID);
+}
+#else
+void VideoInterrupt(void)
+{
+	video_refresh();
+}
+#endif
+
+// Refreshes are driven by VBLs only
+void VideoRefresh(void)
+{
+}
+
+
+/*
+ *  Set palette
+ */
+
+static void set_palette(const uint8 *pal, int num)
+{
+	const VIDEO_MODE &mode = get_current_mode();
+
+	// Gamma tables of direct modes are not applied to captured frames
+	if (IsDirectMode(mode))
+		return;
+	if (num > 256)
+		num = 256;
+	memcpy(palette, pal, num * 3);
+
+	// Frame buffer contents look different. Marking all VOSF pages dirty
+	// would leave them write-protected until the next refresh, and this
+	// is the thread that has to run it
+	palette_changed = true;
+}
+
+#ifdef SHEEPSHAVER
+void video_set_palette(void)
+{
+	int n_colors = palette_size(get_current_mode().viAppleMode);
+	uint8 pal[256 * 3];
+	for (int c = 0; c < n_colors; c++) {
+		pal[c*3 + 0] = mac_pal[c].red;
+		pal[c*3 + 1] = mac_pal[c].green;
+		pal[c*3 + 2] = mac_pal[c].blue;
+	}
+	set_palette(pal, n_colors);
+}
+
+void video_set_gamma(int n_colors)
+{
+	// Not applied to captured frames
+}
+#else
+void Headless_monitor_desc::set_palette(uint8 *pal, int num)
+{
+	::set_palette(pal, num);
+}
+
+void Headless_monitor_desc::set_gamma(uint8 *gamma, int num)
+{
+	// Not applied to captured frames
+}
+#endif
+
+
+/*
+ *  Switch video mode
+ */
+
+static void switch_to_current_mode(void)
+{
+	// Reallocate frame buffer
+	video_close();
+	if (!video_open()) {
+		ErrorAlert(STR_OPEN_WINDOW_ERR);
+		QuitEmulator();
+	}
+}
+
+#ifdef SHEEPSHAVER
+int16 video_mode_change(VidLocals *csSave, uint32 ParamPtr)
+{
+	/* return if no mode change */
+	if ((csSave->saveData == ReadMacInt32(ParamPtr + csData)) &&
+	    (csSave->saveMode == ReadMacInt16(ParamPtr + csMode))) return noErr;
+
+	/* first find video mode in table */
+	for (int i=0; VModes[i].viType != DIS_INVALID; i++) {
+		if ((ReadMacInt16(ParamPtr + csMode) == VModes[i].viAppleMode) &&
+		    (ReadMacInt32(ParamPtr + csData) == VModes[i].viAppleID)) {
+			csSave->saveMode = ReadMacInt16(ParamPtr + csMode);
+			csSave->saveData = ReadMacInt32(ParamPtr + csData);
+			csSave->savePage = ReadMacInt16(ParamPtr + csPage);
+
+			// Refreshes run from VBLs, nothing to pause
+			DisableInterrupt();
+			cur_mode = i;
+			switch_to_current_mode();
+
+			WriteMacInt32(ParamPtr + csBaseAddr, screen_base);
+			csSave->saveBaseAddr=screen_base;
+			csSave->saveData=VModes[cur_mode].viAppleID;/* First mode ... */
+			csSave->saveMode=VModes[cur_mode].viAppleMode;
+
+			EnableInterrupt();
+			return noErr;
+		}
+	}
+	return paramErr;
+}
+#else
+void Headless_monitor_desc::switch_to_current_mode(void)
+{
+	::switch_to_current_mode();
+}
+#endif
+
+
+/*
+ *  Cursor and dirty areas (SheepShaver)
+ */
+
+#ifdef SHEEPSHAVER
+bool video_can_change_cursor(void)
+{
+	return false;
+}
+
+void video_set_cursor(void)
+{
+}
+
+void video_set_dirty_area(int x, int y, int w, int h)
+{
+#ifdef ENABLE_VOSF
+	if (use_vosf) {
+		const VIDEO_MODE &mode = get_current_mode();
+		vosf_set_dirty_area(x, y, w, h, VIDEO_MODE_X, VIDEO_MODE_Y, VIDEO_MODE_ROW_BYTES);
+		return;
+	}
+#endif
+
+	// Tile fingerprints see changes by themselves
+}
+#endif
@@ -0,0 +1,151 @@
+/*
+ *  video_tiles.h - Video/graphics emulation, change detection by tile fingerprints
+ *
+ *  Basilisk II (C) 1997-2008 Christian Bauer
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef VIDEO_TILES_H
+#define VIDEO_TILES_H
+
+// Note: this file must be #include'd only in the video drivers
+
+/*
+ *  Without VOSF, refreshed modes look for the parts of the Mac frame
+ *  buffer that changed since the last refresh. Rather than comparing it
+ *  with a copy, the frame buffer is cut into tiles and each tile keeps a
+ *  64-bit fingerprint of its contents. A refresh reads the frame buffer
+ *  once and reports the tiles whose fingerprint changed.
+ *
+ *  Each 64-bit word of a tile goes through h = (h ^ word) * K. For a
+ *  given word, this is a bijection of h, so a tile with a single changed
+ *  word always gets a different fingerprint. Unrelated contents may only
+ *  collide with a probability of about 2^-64.
+ */
+
+const int VIDEO_TILE_ROWS = 16;			// Height of a tile
+const int VIDEO_TILE_LANES = 4;			// Independent hashes per tile, interleaved by words
+
+struct video_tiles {
+	uint32 width;				// Bytes per row covered by tiles
+	uint32 height;				// Rows covered by tiles
+	uint32 row_bytes;			// Bytes per row of the frame buffer
+	uint32 tile_bytes;			// Width of a tile in bytes, a multiple of 8 * VIDEO_TILE_LANES
+	uint32 n_x, n_y;			// Number of tiles across and down
+	bool invalid;				// Flag: report all tiles at next scan
+	uint64 *fingerprints;		// Fingerprint of each tile, at last scan
+	uint64 *lanes;				// Hashes of a row of tiles, while scanning
+	uint32 *dirty;				// Tiles that changed at last scan
+};
+
+static const uint64 VIDEO_TILE_K = UVAL64(0x9e3779b97f4a7c15);
+
+static inline uint64 video_tiles_load(const uint8 *p)
+{
+	uint64 w;
+	memcpy(&w, p, sizeof(w));
+	return w;
+}
+
+// Hash LEN bytes at P into the lanes H of a tile
+static inline void video_tiles_hash(uint64 *h, const uint8 *p, uint32 len)
+{
+	uint64 h0 = h[0], h1 = h[1], h2 = h[2], h3 = h[3];
+	uint32 i = 0;
+	for (; i + 32 <= len; i += 32) {
+		h0 = (h0 ^ video_tiles_load(p + i +  0)) * VIDEO_TILE_K;
+		h1 = (h1 ^ video_tiles_load(p + i +  8)) * VIDEO_TILE_K;
+		h2 = (h2 ^ video_tiles_load(p + i + 16)) * VIDEO_TILE_K;
+		h3 = (h3 ^ video_tiles_load(p + i + 24)) * VIDEO_TILE_K;
+	}
+	for (; i + 8 <= len; i += 8)
+		h0 = (h0 ^ video_tiles_load(p + i)) * VIDEO_TILE_K;
+	if (i < len) {
+		uint64 w = 0;
+		memcpy(&w, p + i, len - i);
+		h0 = (h0 ^ w) * VIDEO_TILE_K;
+	}
+	h[0] = h0; h[1] = h1; h[2] = h2; h[3] = h3;
+}
+
+static void video_tiles_exit(video_tiles *t)
+{
+	delete[] t->fingerprints;
+	delete[] t->lanes;
+	delete[] t->dirty;
+	t->fingerprints = NULL;
+	t->lanes = NULL;
+	t->dirty = NULL;
+}
+
+// Cover WIDTH bytes of HEIGHT rows of a frame buffer with tiles of TILE_BYTES per row
+static void video_tiles_init(video_tiles *t, uint32 width, uint32 height, uint32 row_bytes, uint32 tile_bytes)
+{
+	t->width = width;
+	t->height = height;
+	t->row_bytes = row_bytes;
+	t->tile_bytes = tile_bytes;
+	t->n_x = (width + tile_bytes - 1) / tile_bytes;
+	t->n_y = (height + VIDEO_TILE_ROWS - 1) / VIDEO_TILE_ROWS;
+	t->invalid = true;
+	t->fingerprints = new uint64[t->n_x * t->n_y];
+	t->lanes = new uint64[t->n_x * VIDEO_TILE_LANES];
+	t->dirty = new uint32[t->n_x * t->n_y];
+}
+
+// Report all tiles as changed at next scan
+static inline void video_tiles_invalidate(video_tiles *t)
+{
+	t->invalid = true;
+}
+
+// Fingerprint the frame buffer at BUFFER, return the number of tiles
+// listed in t->dirty[] (as y * t->n_x + x)
+static uint32 video_tiles_scan(video_tiles *t, const uint8 *buffer)
+{
+	uint32 n_dirty = 0;
+	for (uint32 ty = 0; ty < t->n_y; ty++) {
+		const uint32 y = ty * VIDEO_TILE_ROWS;
+		const uint32 rows = (t->height - y < (uint32)VIDEO_TILE_ROWS) ? t->height - y : VIDEO_TILE_ROWS;
+
+		// Hash a row of tiles, one frame buffer row at a time
+		memset(t->lanes, 0, t->n_x * VIDEO_TILE_LANES * sizeof(uint64));
+		for (uint32 j = y; j < y + rows; j++) {
+			const uint8 *p = buffer + j * t->row_bytes;
+			uint32 x = 0;
+			uint64 *lanes = t->lanes;
+			for (; x + t->tile_bytes <= t->width; x += t->tile_bytes, lanes += VIDEO_TILE_LANES)
+				video_tiles_hash(lanes, p + x, t->tile_bytes);
+			if (x < t->width)
+				video_tiles_hash(lanes, p + x, t->width - x);
+		}
+
+		// Compare with the last fingerprints
+		for (uint32 tx = 0; tx < t->n_x; tx++) {
+			const uint64 *h = &t->lanes[tx * VIDEO_TILE_LANES];
+			const uint64 f = (((h[0] * VIDEO_TILE_K) ^ h[1]) * VIDEO_TILE_K ^ h[2]) * VIDEO_TILE_K ^ h[3];
+			const uint32 i = ty * t->n_x + tx;
+			if (f != t->fingerprints[i] || t->invalid) {
+				t->fingerprints[i] = f;
+				t->dirty[n_dirty++] = i;
+			}
+		}
+	}
+	t->invalid = false;
+	return n_dirty;
+}
+
+#endif /* VIDEO_TILES_H */
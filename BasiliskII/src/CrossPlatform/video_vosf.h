@@ -30,17 +30,76 @@
 #include "util_windows.h"
 #endif
 
+// Linux can track frame buffer writes without signals
+#if defined(__linux__) && defined(HAVE_LINUX_USERFAULTFD_H)
+#include <linux/userfaultfd.h>
+#ifdef UFFDIO_REGISTER_MODE_WP
+#define USE_VOSF_UFFD 1
+#endif
+#endif
+
+#if USE_VOSF_UFFD
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+
+// Linux 6.7 ABI, not in older kernel headers
+#ifndef UFFD_USER_MODE_ONLY
+#define UFFD_USER_MODE_ONLY			1
+#endif
+#ifndef UFFD_FEATURE_WP_UNPOPULATED
+#define UFFD_FEATURE_WP_UNPOPULATED	(1 << 13)
+#endif
+#ifndef UFFD_FEATURE_WP_ASYNC
+#define UFFD_FEATURE_WP_ASYNC		(1 << 15)
+#endif
+#ifndef PAGEMAP_SCAN
+struct page_region {
+	__u64 start;
+	__u64 end;
+	__u64 categories;
+};
+struct pm_scan_arg {
+	__u64 size;
+	__u64 flags;
+	__u64 start;
+	__u64 end;
+	__u64 walk_end;
+	__u64 vec;
+	__u64 vec_len;
+	__u64 max_pages;
+	__u64 category_inverted;
+	__u64 category_mask;
+	__u64 category_anyof_mask;
+	__u64 return_mask;
+};
+#define PAGE_IS_WRITTEN				(1 << 1)
+#define PM_SCAN_WP_MATCHING			(1 << 0)
+#define PM_SCAN_CHECK_WPASYNC		(1 << 1)
+#define PAGEMAP_SCAN				_IOWR('f', 16, struct pm_scan_arg)
+#endif
+#endif
+
 // Import SDL-backend-specific functions
 #ifdef USE_SDL_VIDEO
 extern void update_sdl_video(SDL_Surface *screen, Sint32 x, Sint32 y, Sint32 w, Sint32 h);
 extern void update_sdl_video(SDL_Surface *screen, int numrects, SDL_Rect *rects);
 #endif
 
-// Glue for SDL and X11 support
+// Glue for SDL, X11 and headless support
 #ifdef TEST_VOSF_PERFORMANCE
 #define MONITOR_INIT			/* nothing */
 #else
-#ifdef USE_SDL_VIDEO
+#if defined(USE_HEADLESS_VIDEO)
+#ifdef SHEEPSHAVER
+#define MONITOR_INIT			/* nothing */
+#else
+#define MONITOR_INIT			Headless_monitor_desc &monitor
+#endif
+#elif defined(USE_SDL_VIDEO)
 #define MONITOR_INIT			SDL_monitor_desc &monitor
 #define VIDEO_DRV_WIN_INIT		driver_base *drv
 #define VIDEO_DRV_DGA_INIT		driver_base *drv
@@ -92,6 +151,24 @@ struct ScreenPageInfo {
     unsigned top, bottom;		// Mapping between this virtual page and Mac scanlines
 };
 
+/*
+ *  Frame buffer writes are tracked with one of:
+ *
+ *  VOSF_TRACK_SIGSEGV  pages are write-protected, Screen_fault_handler()
+ *                      catches the first write to each of them and makes
+ *                      the page writable until the next update.
+ *
+ *  VOSF_TRACK_UFFD     Linux 6.7+ asynchronous userfaultfd write-protect.
+ *                      The kernel resolves write faults by itself and one
+ *                      PAGEMAP_SCAN ioctl per update reports the written
+ *                      pages and write-protects them again.
+ */
+
+enum {
+	VOSF_TRACK_SIGSEGV,
+	VOSF_TRACK_UFFD
+};
+
 struct ScreenInfo {
     uintptr memStart;			// Start address aligned to page boundary
     uint32 memLength;			// Length of the memory addressed by the screen pages
@@ -104,10 +181,16 @@ struct ScreenInfo {
 	bool very_dirty;			// Flag: set if the frame buffer was completely modified (e.g. colormap changes)
     char * dirtyPages;			// Table of flags set if page was altered
     ScreenPageInfo * pageInfo;	// Table of mappings page -> Mac scanlines
+	int tracking;				// How writes are tracked (VOSF_TRACK_*)
 };
 
 static ScreenInfo mainBuffer;
 
+#if USE_VOSF_UFFD
+static int vosf_uffd = -1;		// userfaultfd the frame buffer is registered with
+static int vosf_pagemap = -1;	// /proc/self/pagemap, for PAGEMAP_SCAN
+#endif
+
 #define PFLAG_SET_VALUE			0x00
 #define PFLAG_CLEAR_VALUE		0x01
 #define PFLAG_SET_VALUE_4		0x00000000
@@ -223,6 +306,149 @@ static uint32 page_extend(uint32 size)
 }
 
 
+/*
+ *  Dirty page tracking
+ */
+
+#if USE_VOSF_UFFD
+static void vosf_uffd_exit(void)
+{
+	if (vosf_pagemap >= 0) {
+		close(vosf_pagemap);
+		vosf_pagemap = -1;
+	}
+	if (vosf_uffd >= 0) {
+		close(vosf_uffd);						// This also unregisters the frame buffer
+		vosf_uffd = -1;
+	}
+}
+
+static bool vosf_uffd_init(void)
+{
+	// Faults are resolved by the kernel, so we only need to register for
+	// user-mode ones, which unprivileged processes are always allowed to
+	vosf_uffd = syscall(__NR_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY);
+	if (vosf_uffd < 0) {
+		D(bug("VOSF: userfaultfd not available (%s)\n", strerror(errno)));
+		return false;
+	}
+
+	struct uffdio_api api;
+	api.api = UFFD_API;
+	api.features = UFFD_FEATURE_WP_ASYNC | UFFD_FEATURE_WP_UNPOPULATED;
+	api.ioctls = 0;
+
+	struct uffdio_register reg;
+	reg.range.start = mainBuffer.memStart;
+	reg.range.len = mainBuffer.memLength;
+	reg.mode = UFFDIO_REGISTER_MODE_WP;
+	reg.ioctls = 0;
+
+	struct uffdio_writeprotect wp;
+	wp.range = reg.range;
+	wp.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+
+	if (ioctl(vosf_uffd, UFFDIO_API, &api) < 0
+	||	ioctl(vosf_uffd, UFFDIO_REGISTER, &reg) < 0
+	||	ioctl(vosf_uffd, UFFDIO_WRITEPROTECT, &wp) < 0
+	||	(vosf_pagemap = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC)) < 0) {
+		D(bug("VOSF: asynchronous write-protect not available (%s)\n", strerror(errno)));
+		vosf_uffd_exit();
+		return false;
+	}
+	return true;
+}
+
+// Mark the pages written to since the last scan, and write-protect them again
+static void vosf_uffd_scan(void)
+{
+	const int N_REGIONS = 16;
+	page_region regions[N_REGIONS];
+	pm_scan_arg arg;
+	memset(&arg, 0, sizeof(arg));
+	arg.size = sizeof(arg);
+	arg.flags = PM_SCAN_WP_MATCHING | PM_SCAN_CHECK_WPASYNC;
+	arg.start = mainBuffer.memStart;
+	arg.end = mainBuffer.memStart + mainBuffer.memLength;
+	arg.vec = (uintptr)regions;
+	arg.vec_len = N_REGIONS;
+	arg.category_mask = PAGE_IS_WRITTEN;
+	arg.return_mask = PAGE_IS_WRITTEN;
+
+	for (;;) {
+		const int n = ioctl(vosf_pagemap, PAGEMAP_SCAN, &arg);
+		if (n < 0) {
+			// Don't lose updates
+			PFLAG_SET_ALL;
+			return;
+		}
+		for (int i = 0; i < n; i++) {
+			const unsigned first_page = (regions[i].start - mainBuffer.memStart) >> mainBuffer.pageBits;
+			const unsigned last_page = (regions[i].end - mainBuffer.memStart) >> mainBuffer.pageBits;
+			PFLAG_SET_RANGE(first_page, last_page);
+			mainBuffer.dirty = true;
+		}
+		if (n < N_REGIONS || arg.walk_end >= arg.end)
+			break;
+		arg.start = arg.walk_end;
+	}
+}
+#endif
+
+// Start tracking writes with method TRACKING, from a clean frame buffer
+static bool vosf_set_tracking(int tracking)
+{
+#if USE_VOSF_UFFD
+	if (mainBuffer.tracking == VOSF_TRACK_UFFD)
+		vosf_uffd_exit();
+#endif
+	mainBuffer.tracking = VOSF_TRACK_SIGSEGV;
+
+	switch (tracking) {
+	case VOSF_TRACK_SIGSEGV:
+		return vm_protect((char *)mainBuffer.memStart, mainBuffer.memLength, VM_PAGE_READ) == 0;
+#if USE_VOSF_UFFD
+	case VOSF_TRACK_UFFD:
+		if (vm_protect((char *)mainBuffer.memStart, mainBuffer.memLength, VM_PAGE_READ | VM_PAGE_WRITE) != 0)
+			return false;
+		if (!vosf_uffd_init())
+			return false;
+		mainBuffer.tracking = VOSF_TRACK_UFFD;
+		return true;
+#endif
+	}
+	return false;
+}
+
+// Catch writes to pages [ first_page, last_page [ again
+static inline void vosf_protect_pages(unsigned first_page, unsigned last_page)
+{
+	// PAGEMAP_SCAN already write-protected the pages it reported
+	if (mainBuffer.tracking == VOSF_TRACK_SIGSEGV) {
+		const uintptr offset = uintptr(first_page) << mainBuffer.pageBits;
+		const uint32 length = (last_page - first_page) << mainBuffer.pageBits;
+		vm_protect((char *)mainBuffer.memStart + offset, length, VM_PAGE_READ);
+	}
+}
+
+
+/*
+ *  Check whether the frame buffer was touched since the last update
+ */
+
+static inline bool video_vosf_dirty(void)
+{
+#if USE_VOSF_UFFD
+	if (mainBuffer.tracking == VOSF_TRACK_UFFD) {
+		LOCK_VOSF;
+		vosf_uffd_scan();
+		UNLOCK_VOSF;
+	}
+#endif
+	return mainBuffer.dirty;
+}
+
+
 /*
  *  Check if VOSF acceleration is profitable on this platform
  */
@@ -233,18 +459,10 @@ static uint32 page_extend(uint32 size)
 const int VOSF_PROFITABLE_TRIES_DFL = 3;		// Make 3 attempts for full screen update
 const int VOSF_PROFITABLE_THRESHOLD = 16667/2;	// 60 Hz (half of the quantum)
 
-static bool video_vosf_profitable(uint32 *duration_p = NULL, uint32 *n_page_faults_p = NULL)
+// Time N_TRIES full screen updates with the current tracking method
+static bool vosf_time_updates(uint32 n_tries, bool accel, uint32 *duration_p)
 {
 	uint32 duration = 0;
-	uint32 n_tries = VOSF_PROFITABLE_TRIES;
-	const uint32 n_page_faults = mainBuffer.pageCount * n_tries;
-
-#ifdef SHEEPSHAVER
-	const bool accel = PrefsFindBool("gfxaccel");
-#else
-	const bool accel = false;
-#endif
-
 	for (uint32 i = 0; i < n_tries; i++) {
 		uint64 start = GetTicks_usec();
 		for (uint32 p = 0; p < mainBuffer.pageCount; p++) {
@@ -254,13 +472,51 @@ static bool video_vosf_profitable(uint32 *duration_p = NULL, uint32 *n_page_faul
 			else
 				addr[0] = 0; // Trigger Screen_fault_handler()
 		}
+#if USE_VOSF_UFFD
+		if (mainBuffer.tracking == VOSF_TRACK_UFFD)
+			vosf_uffd_scan();
+#endif
 		duration += uint32(GetTicks_usec() - start);
 
 		PFLAG_CLEAR_ALL;
 		mainBuffer.dirty = false;
-		if (vm_protect((char *)mainBuffer.memStart, mainBuffer.memLength, VM_PAGE_READ) != 0)
+		if (mainBuffer.tracking == VOSF_TRACK_SIGSEGV
+		&&	vm_protect((char *)mainBuffer.memStart, mainBuffer.memLength, VM_PAGE_READ) != 0)
+			return false;
+	}
+	*duration_p = duration;
+	return true;
+}
+
+static bool video_vosf_profitable(uint32 *duration_p = NULL, uint32 *n_page_faults_p = NULL)
+{
+	uint32 duration = 0;
+	uint32 n_tries = VOSF_PROFITABLE_TRIES;
+	const uint32 n_page_faults = mainBuffer.pageCount * n_tries;
+
+#ifdef SHEEPSHAVER
+	const bool accel = PrefsFindBool("gfxaccel");
+#else
+	const bool accel = false;
+#endif
+
+	if (!vosf_time_updates(n_tries, accel, &duration))
+		return false;
+
+#if USE_VOSF_UFFD
+	// Compare with SIGSEGV handling and keep the fastest
+	if (mainBuffer.tracking == VOSF_TRACK_UFFD) {
+		uint32 sigsegv_duration;
+		if (!vosf_set_tracking(VOSF_TRACK_SIGSEGV) || !vosf_time_updates(n_tries, accel, &sigsegv_duration))
 			return false;
+		D(bug("userfaultfd tracking: %u usec, SIGSEGV tracking: %u usec\n", duration, sigsegv_duration));
+		if (sigsegv_duration < duration || !vosf_set_tracking(VOSF_TRACK_UFFD)) {
+			duration = sigsegv_duration;
+			if (!vosf_set_tracking(VOSF_TRACK_SIGSEGV))
+				return false;
+		}
 	}
+#endif
 
 	if (duration_p)
 	  *duration_p = duration;
@@ -327,8 +583,8 @@ static bool video_vosf_init(MONITOR_INIT)
 			a = mainBuffer.memLength;
 	}
 	
-	// We can now write-protect the frame buffer
-	if (vm_protect((char *)mainBuffer.memStart, mainBuffer.memLength, VM_PAGE_READ) != 0)
+	// We can now write-protect the frame buffer, preferably without signals
+	if (!vosf_set_tracking(VOSF_TRACK_UFFD) && !vosf_set_tracking(VOSF_TRACK_SIGSEGV))
 		return false;
 	
 	// The frame buffer is sane, i.e. there is no write to it yet
@@ -343,6 +599,10 @@ static bool video_vosf_init(MONITOR_INIT)
 
 static void video_vosf_exit(void)
 {
+#if USE_VOSF_UFFD
+	vosf_uffd_exit();
+#endif
+	mainBuffer.tracking = VOSF_TRACK_SIGSEGV;
 	if (mainBuffer.pageInfo) {
 		free(mainBuffer.pageInfo);
 		mainBuffer.pageInfo = NULL;
@@ -366,7 +626,8 @@ static void vosf_do_set_dirty_area(uintptr first, uintptr last)
 	for (int i = first_page; i <= last_page; i++) {
 		if (PFLAG_ISCLEAR(i)) {
 			PFLAG_SET(i);
-			vm_protect(addr, mainBuffer.pageSize, VM_PAGE_READ | VM_PAGE_WRITE);
+			if (mainBuffer.tracking == VOSF_TRACK_SIGSEGV)
+				vm_protect(addr, mainBuffer.pageSize, VM_PAGE_READ | VM_PAGE_WRITE);
 		}
 		addr += mainBuffer.pageSize;
 	}
@@ -487,7 +748,7 @@ There are two cases to check:
 	than pageCount.
 */
 
-#ifndef TEST_VOSF_PERFORMANCE
+#if !defined(TEST_VOSF_PERFORMANCE) && !defined(USE_HEADLESS_VIDEO)
 static void update_display_window_vosf(VIDEO_DRV_WIN_INIT)
 {
 	VIDEO_MODE_INIT;
@@ -502,9 +763,7 @@ static void update_display_window_vosf(VIDEO_DRV_WIN_INIT)
 		PFLAG_CLEAR_RANGE(first_page, page);
 
 		// Make the dirty pages read-only again
-		const int32 offset  = first_page << mainBuffer.pageBits;
-		const uint32 length = (page - first_page) << mainBuffer.pageBits;
-		vm_protect((char *)mainBuffer.memStart + offset, length, VM_PAGE_READ);
+		vosf_protect_pages(first_page, page);
 		
 		// There is at least one line to update
 		const int y1 = mainBuffer.pageInfo[first_page].top;
@@ -542,7 +801,7 @@ static void update_display_window_vosf(VIDEO_DRV_WIN_INIT)
  *	(only in Real or Direct Addressing mode)
  */
 
-#ifndef TEST_VOSF_PERFORMANCE
+#if !defined(TEST_VOSF_PERFORMANCE) && !defined(USE_HEADLESS_VIDEO)
 #if REAL_ADDRESSING || DIRECT_ADDRESSING
 
 static void update_display_dga_vosf(VIDEO_DRV_DGA_INIT)
@@ -559,7 +818,7 @@ static void update_display_dga_vosf(VIDEO_DRV_DGA_INIT)
 	// Full screen update requested?
 	if (mainBuffer.very_dirty) {
 		PFLAG_CLEAR_ALL;
-		vm_protect((char *)mainBuffer.memStart, mainBuffer.memLength, VM_PAGE_READ);
+		vosf_protect_pages(0, mainBuffer.pageCount);
 		memcpy(the_buffer_copy, the_buffer, VIDEO_MODE_ROW_BYTES * VIDEO_MODE_Y);
 		VIDEO_DRV_LOCK_PIXELS;
 		int i1 = 0, i2 = 0;
@@ -597,9 +856,7 @@ static void update_display_dga_vosf(VIDEO_DRV_DGA_INIT)
 		PFLAG_CLEAR_RANGE(first_page, page);
 
 		// Make the dirty pages read-only again
-		const int32 offset  = first_page << mainBuffer.pageBits;
-		const uint32 length = (page - first_page) << mainBuffer.pageBits;
-		vm_protect((char *)mainBuffer.memStart + offset, length, VM_PAGE_READ);
+		vosf_protect_pages(first_page, page);
 
 		// Optimized for scanlines, don't process overlapping lines again
 		uint32 y1 = mainBuffer.pageInfo[first_page].top;
@@ -392,6 +392,16 @@ void *vm_acquire(size_t size, int options) {
 #endif
 }
 
+void *vm_acquire_hint(void *addr, size_t size, int options) {
+#if defined(HAVE_MMAP_VM) && !defined(MEM_BULK)
+	// The hint would turn into a fixed mapping where MAP_32BIT is
+	// emulated with MAP_FIXED
+	if (addr && !((options & VM_MAP_32BIT) && (FORCE_MAP_32BIT & MAP_FIXED)))
+		next_address = (char *)addr;
+#endif
+	return vm_acquire(size, options);
+}
+
 int vm_acquire_fixed(void *addr, size_t size, int options) {
 #ifdef MEM_BULK
 	vm_uintptr_t addr_mac = (vm_uintptr_t)addr - VMBaseDiff;
@@ -460,6 +470,23 @@ int vm_protect(void * addr, size_t size, int prot)
 #endif
 }
 
+/* Write to every page of the region starting at ADDR and extending
+   SIZE bytes, leaving its contents unchanged.  */
+
+void vm_touch(void * addr, size_t size)
+{
+	if (size == 0)
+		return;
+	// vm_get_page_size() is the allocation granularity on Windows
+	const vm_uintptr_t page_size = 4096;
+	volatile char *p = (volatile char *)addr;
+	volatile char *end = p + size;
+	while (p < end) {
+		*p = *p;
+		p = (volatile char *)(((vm_uintptr_t)p + page_size) & ~(page_size - 1));
+	}
+}
+
 /* Return the addresses of the pages that got modified in the
    specified range [ ADDR, ADDR + SIZE [ since the last reset of the watch
    bits. Returns 0 if successful, -1 for errors.  */
@@ -101,6 +101,12 @@ extern void * vm_acquire(size_t size, int options = VM_MAP_DEFAULT);
 
 extern void * vm_acquire_reserved(size_t size);
 
+/* Allocate zero-filled memory of SIZE bytes, preferably at ADDR. Existing
+   mappings are left alone, so the return value is the actual mapping
+   address chosen, which may differ from ADDR, or VM_MAP_FAILED for errors.  */
+
+extern void * vm_acquire_hint(void * addr, size_t size, int options = VM_MAP_DEFAULT);
+
 extern int vm_init_reserved(void * host_address);
 
 /* Allocate zero-filled memory at exactly ADDR (which must be page-aligned).
@@ -118,6 +124,13 @@ extern int vm_release(void * addr, size_t size);
 
 extern int vm_protect(void * addr, size_t size, int prot);
 
+/* Write to every page of the region starting at ADDR and extending
+   SIZE bytes, leaving its contents unchanged. Pages write-protected
+   by the emulator are resolved by the SIGSEGV handler that way, system
+   calls would fail with EFAULT on them instead.  */
+
+extern void vm_touch(void * addr, size_t size);
+
 /* Return the addresses of the pages that got modified since the last
    reset of the write-tracking state for the specified range [ ADDR,
    ADDR + SIZE [. Returns 0 if successful, -1 for errors.  */
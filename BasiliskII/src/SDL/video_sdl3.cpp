@@ -66,6 +66,7 @@
 #include "video.h"
 #include "video_defs.h"
 #include "video_blit.h"
+#include "video_tiles.h"
 #include "vm_alloc.h"
 #include "cdrom.h"
 
@@ -113,7 +114,8 @@ static int16 mouse_wheel_lines;
 static bool mouse_wheel_reverse;
 
 static uint8 *the_buffer = NULL;					// Mac frame buffer (where MacOS draws into)
-static uint8 *the_buffer_copy = NULL;				// Copy of Mac frame buffer (for refreshed modes)
+static uint8 *the_buffer_copy = NULL;				// Copy of Mac frame buffer (for VOSF refresh)
+static video_tiles screen_tiles;					// Fingerprints of the Mac frame buffer (for static refresh)
 static uint32 the_buffer_size;						// Size of allocated the_buffer
 
 static bool redraw_thread_active = false;			// Flag: Redraw thread installed
@@ -142,6 +144,11 @@ static bool classic_mode = false;					// Flag: Classic Mac video mode
 static bool use_keycodes = false;					// Flag: Use keycodes rather than keysyms
 static int keycode_table[256];						// X keycode -> Mac keycode translation table
 
+// Damage tracking: separate areas are uploaded to sdl_texture on their own,
+// unless merging them costs less than UPDATE_RECT_SLACK more pixels
+const int MAX_UPDATE_RECTS = 16;
+const int UPDATE_RECT_SLACK = 64 * 64;
+
 // SDL variables
 SDL_Window * sdl_window = NULL;				        // Wraps an OS-native window
 static SDL_Surface * host_surface = NULL;			// Surface in host-OS display format
@@ -149,8 +156,12 @@ static SDL_Surface * guest_surface = NULL;			// Surface in guest-OS display form
 static SDL_Renderer * sdl_renderer = NULL;			// Handle to SDL2 renderer
 static SDL_ThreadID sdl_renderer_thread_id = 0;		// Thread ID where the SDL_renderer was created, and SDL_renderer ops should run (for compatibility w/ d3d9)
 static SDL_Texture * sdl_texture = NULL;			// Handle to a GPU texture, with which to draw guest_surface to
-static SDL_Rect sdl_update_video_rect = {0,0,0,0};  // Union of all rects to update, when updating sdl_texture
-static SDL_Mutex * sdl_update_video_mutex = NULL;   // Mutex to protect sdl_update_video_rect
+static SDL_Rect sdl_update_video_rects[MAX_UPDATE_RECTS];	// Areas to update, when updating sdl_texture
+static int sdl_update_video_nrects = 0;				// Number of areas in sdl_update_video_rects[]
+static SDL_Mutex * sdl_update_video_mutex = NULL;   // Mutex to protect sdl_update_video_rects[]
+static uint64 sdl_update_video_bytes = 0;			// Bytes copied to sdl_texture
+static uint64 sdl_update_video_count = 0;			// Updates of sdl_texture copied to the display
+static uint64 sdl_update_video_start = 0;			// Time of VideoInit(), in usecs
 static int screen_depth;							// Depth of current screen
 #ifdef SHEEPSHAVER
 static SDL_Cursor *sdl_cursor = NULL;				// Copy of Mac cursor
@@ -819,10 +830,7 @@ static SDL_Surface *init_sdl_video(int width, int height, int depth, Uint32 flag
     }
 	SDL_SetTextureBlendMode(sdl_texture, SDL_BLENDMODE_NONE);
 
-    sdl_update_video_rect.x = 0;
-    sdl_update_video_rect.y = 0;
-    sdl_update_video_rect.w = 0;
-    sdl_update_video_rect.h = 0;
+    sdl_update_video_nrects = 0;
 
 	SDL_assert(guest_surface == NULL);
 	SDL_assert(host_surface == NULL);
@@ -890,9 +898,60 @@ static SDL_Surface *init_sdl_video(int width, int height, int depth, Uint32 flag
     return guest_surface;
 }
 
+// Add an area to update, sdl_update_video_mutex must be held
+static void add_update_rect(SDL_Rect r)
+{
+	if (SDL_RectEmpty(&r))
+		return;
+
+	// Merge with the areas it overlaps or nearly touches. The result may in
+	// turn reach other areas, so start over after each merge
+	for (int i = 0; i < sdl_update_video_nrects; i++) {
+		const SDL_Rect &q = sdl_update_video_rects[i];
+		SDL_Rect u;
+		SDL_GetRectUnion(&q, &r, &u);
+		if (u.w * u.h <= q.w * q.h + r.w * r.h + UPDATE_RECT_SLACK) {
+			r = u;
+			sdl_update_video_rects[i] = sdl_update_video_rects[--sdl_update_video_nrects];
+			i = -1;
+		}
+	}
+	if (sdl_update_video_nrects < MAX_UPDATE_RECTS) {
+		sdl_update_video_rects[sdl_update_video_nrects++] = r;
+		return;
+	}
+
+	// List full, grow the area whose bounding box gets the least larger
+	int best = 0, best_growth = 0;
+	for (int i = 0; i < sdl_update_video_nrects; i++) {
+		const SDL_Rect &q = sdl_update_video_rects[i];
+		SDL_Rect u;
+		SDL_GetRectUnion(&q, &r, &u);
+		int growth = u.w * u.h - q.w * q.h;
+		if (i == 0 || growth < best_growth) {
+			best = i;
+			best_growth = growth;
+		}
+	}
+	SDL_GetRectUnion(&sdl_update_video_rects[best], &r, &sdl_update_video_rects[best]);
+}
+
+// Update the whole screen
+static void set_update_rect_full(int width, int height)
+{
+	SDL_LockMutex(sdl_update_video_mutex);
+	sdl_update_video_rects[0].x = 0;
+	sdl_update_video_rects[0].y = 0;
+	sdl_update_video_rects[0].w = width;
+	sdl_update_video_rects[0].h = height;
+	sdl_update_video_nrects = 1;
+	SDL_UnlockMutex(sdl_update_video_mutex);
+}
+
 static int present_sdl_video()
 {
-	if (SDL_RectEmpty(&sdl_update_video_rect)) return 0;
+	// Nothing changed, the last frame stays on screen
+	if (sdl_update_video_nrects == 0) return 0;
 	
 	if (!sdl_renderer || !sdl_texture || !guest_surface) {
 		printf("WARNING: A video mode does not appear to have been set.\n");
@@ -914,7 +973,7 @@ static int present_sdl_video()
 	SDL_SetRenderDrawColor(sdl_renderer, 0, 0, 0, 0);	// Use black
 	SDL_RenderClear(sdl_renderer);						// Clear the display
 	
-	// We're about to work with sdl_update_video_rect, so stop other threads from
+	// We're about to work with sdl_update_video_rects[], so stop other threads from
 	// modifying it!
 	LOCK_PALETTE;
 	SDL_LockMutex(sdl_update_video_mutex);
@@ -923,53 +982,56 @@ static int present_sdl_video()
 		host_surface != NULL &&
 		guest_surface != NULL)
 	{
-		SDL_Rect destRect = sdl_update_video_rect;
-		int result = SDL_BlitSurface(guest_surface, &sdl_update_video_rect, host_surface, &destRect);
-		if (!result) {
-			SDL_UnlockMutex(sdl_update_video_mutex);
-			UNLOCK_PALETTE;
-			return -1;
+		for (int i = 0; i < sdl_update_video_nrects; i++) {
+			SDL_Rect destRect = sdl_update_video_rects[i];
+			int result = SDL_BlitSurface(guest_surface, &sdl_update_video_rects[i], host_surface, &destRect);
+			if (!result) {
+				SDL_UnlockMutex(sdl_update_video_mutex);
+				UNLOCK_PALETTE;
+				return -1;
+			}
 		}
 	}
 	UNLOCK_PALETTE; // passed potential deadlock, can unlock palette
 	
-	// Update the host OS' texture
-	uint8_t *srcPixels = (uint8_t *)host_surface->pixels +
-		sdl_update_video_rect.y * host_surface->pitch +
-		sdl_update_video_rect.x * SDL_GetPixelFormatDetails(host_surface->format)->bytes_per_pixel;
-
-	uint8_t *dstPixels;
-	int dstPitch;
-	if (!SDL_LockTexture(sdl_texture, &sdl_update_video_rect, (void **)&dstPixels, &dstPitch)) {
-		SDL_UnlockMutex(sdl_update_video_mutex);
-		return -1;
-	}
+	// Update the host OS' texture, one area at a time
+	for (int i = 0; i < sdl_update_video_nrects; i++) {
+		const SDL_Rect &r = sdl_update_video_rects[i];
+		uint8_t *srcPixels = (uint8_t *)host_surface->pixels +
+			r.y * host_surface->pitch +
+			r.x * SDL_GetPixelFormatDetails(host_surface->format)->bytes_per_pixel;
+
+		uint8_t *dstPixels;
+		int dstPitch;
+		if (!SDL_LockTexture(sdl_texture, &r, (void **)&dstPixels, &dstPitch)) {
+			SDL_UnlockMutex(sdl_update_video_mutex);
+			return -1;
+		}
 #ifdef VIDEO_CHROMAKEY
-	if (display_type == DISPLAY_CHROMAKEY)
-		for (int y = 0; y < sdl_update_video_rect.h; y++) {
-			uint32_t *src = (uint32_t *)srcPixels, *dst = (uint32_t *)dstPixels;
-			for (int i = 0; i < sdl_update_video_rect.w; i++) {
-				uint32 d = *src++;
-				*dst++ = d | (d == VIDEO_CHROMAKEY ? 0 : 0xff); // alpha value
+		if (display_type == DISPLAY_CHROMAKEY)
+			for (int y = 0; y < r.h; y++) {
+				uint32_t *src = (uint32_t *)srcPixels, *dst = (uint32_t *)dstPixels;
+				for (int i = 0; i < r.w; i++) {
+					uint32 d = *src++;
+					*dst++ = d | (d == VIDEO_CHROMAKEY ? 0 : 0xff); // alpha value
+				}
+				srcPixels += host_surface->pitch;
+				dstPixels += dstPitch;
 			}
-			srcPixels += host_surface->pitch;
-			dstPixels += dstPitch;
-		}
-	else
+		else
 #endif
-		for (int y = 0; y < sdl_update_video_rect.h; y++) {
-			memcpy(dstPixels, srcPixels, sdl_update_video_rect.w << 2);
-			srcPixels += host_surface->pitch;
-			dstPixels += dstPitch;
-		}
-	SDL_UnlockTexture(sdl_texture);
+			for (int y = 0; y < r.h; y++) {
+				memcpy(dstPixels, srcPixels, r.w << 2);
+				srcPixels += host_surface->pitch;
+				dstPixels += dstPitch;
+			}
+		SDL_UnlockTexture(sdl_texture);
+		sdl_update_video_bytes += (r.w << 2) * r.h;
+	}
 
-    // We are done working with pixels in host_surface.  Reset sdl_update_video_rect, then let
+    // We are done working with pixels in host_surface.  Reset sdl_update_video_rects[], then let
     // other threads modify it, as-needed.
-    sdl_update_video_rect.x = 0;
-    sdl_update_video_rect.y = 0;
-    sdl_update_video_rect.w = 0;
-    sdl_update_video_rect.h = 0;
+    sdl_update_video_nrects = 0;
     SDL_UnlockMutex(sdl_update_video_mutex);
 
     // Copy the texture to the display
@@ -979,6 +1041,8 @@ static int present_sdl_video()
 	
     // Update the display
 	SDL_RenderPresent(sdl_renderer);
+
+	sdl_update_video_count++;
     
     // Indicate success to the caller!
     return 0;
@@ -991,7 +1055,7 @@ void update_sdl_video(SDL_Surface *s, int numrects, SDL_Rect *rects)
     
     SDL_LockMutex(sdl_update_video_mutex);
     for (int i = 0; i < numrects; ++i) {
-		SDL_GetRectUnion(&sdl_update_video_rect, &rects[i], &sdl_update_video_rect);
+		add_update_rect(rects[i]);
     }
     SDL_UnlockMutex(sdl_update_video_mutex);
 }
@@ -1076,10 +1140,14 @@ void driver_base::init()
 	if (!use_vosf) {
 		// Allocate memory for frame buffer
 		the_buffer_size = (aligned_height + 2) * pitch;
-		the_buffer_copy = (uint8 *)calloc(1, the_buffer_size);
 		the_buffer = (uint8 *)vm_acquire_framebuffer(the_buffer_size);
 		memset(the_buffer, 0, the_buffer_size);
-		D(bug("the_buffer = %p, the_buffer_copy = %p\n", the_buffer, the_buffer_copy));
+		D(bug("the_buffer = %p\n", the_buffer));
+
+		// Changes are found by tiles of 64 pixels (but at least 32 bytes) x 16 rows
+		const int depth = mac_depth_of_video_depth(VIDEO_MODE_DEPTH);
+		const uint32 tile_bytes = depth < 4 ? 32 : 8 * depth;
+		video_tiles_init(&screen_tiles, TrivialBytesPerRow(VIDEO_MODE_X, VIDEO_MODE_DEPTH), VIDEO_MODE_Y, VIDEO_MODE_ROW_BYTES, tile_bytes);
 	}
 
 	set_video_mode(display_type == DISPLAY_SCREEN ? SDL_WINDOW_FULLSCREEN : 0, pitch);
@@ -1129,12 +1197,7 @@ void driver_base::adapt_to_video_mode() {
 	if (private_data)
 		private_data->cursorHardware = hardware_cursor;
 #endif
-	SDL_LockMutex(sdl_update_video_mutex);
-	sdl_update_video_rect.x = 0;
-	sdl_update_video_rect.y = 0;
-	sdl_update_video_rect.w = VIDEO_MODE_X;
-	sdl_update_video_rect.h = VIDEO_MODE_Y;
-	SDL_UnlockMutex(sdl_update_video_mutex);
+	set_update_rect_full(VIDEO_MODE_X, VIDEO_MODE_Y);
 	
 	// Hide cursor
 	hardware_cursor ? SDL_ShowCursor() : SDL_HideCursor();
@@ -1163,12 +1226,8 @@ driver_base::~driver_base()
 	}
 
 	// Free frame buffer(s)
-	if (!use_vosf) {
-		if (the_buffer_copy) {
-			free(the_buffer_copy);
-			the_buffer_copy = NULL;
-		}
-	}
+	if (!use_vosf)
+		video_tiles_exit(&screen_tiles);
 #ifdef ENABLE_VOSF
 	else {
 		if (the_buffer_copy) {
@@ -1192,12 +1251,7 @@ void driver_base::update_palette(void)
 
 	if ((int)VIDEO_MODE_DEPTH <= VIDEO_DEPTH_8BIT) {
 		SDL_SetSurfacePalette(s, sdl_palette);
-		SDL_LockMutex(sdl_update_video_mutex);
-		sdl_update_video_rect.x = 0;
-		sdl_update_video_rect.y = 0;
-		sdl_update_video_rect.w = VIDEO_MODE_X;
-		sdl_update_video_rect.h = VIDEO_MODE_Y;
-		SDL_UnlockMutex(sdl_update_video_mutex);
+		set_update_rect_full(VIDEO_MODE_X, VIDEO_MODE_Y);
 	}
 }
 
@@ -1389,6 +1443,7 @@ bool VideoInit(bool classic)
 {
 #endif
 	classic_mode = classic;
+	sdl_update_video_start = GetTicks_usec();
 
 #ifdef ENABLE_VOSF
 	// Zero the mainBuffer structure
@@ -1634,8 +1689,22 @@ void SDL_monitor_desc::video_close(void)
 	drv = NULL;
 }
 
+// Report texture upload bandwidth
+static void video_print_stats(void)
+{
+	const double elapsed = double(GetTicks_usec() - sdl_update_video_start) / 1e6;
+	if (sdl_update_video_count == 0 || elapsed <= 0)
+		return;
+	printf("SDL video: %llu updates in %.1f sec, %.1f MB uploaded to texture (%.1f MB per sec)\n",
+		   (unsigned long long)sdl_update_video_count, elapsed,
+		   double(sdl_update_video_bytes) / (1024 * 1024),
+		   double(sdl_update_video_bytes) / (1024 * 1024) / elapsed);
+}
+
 void VideoExit(void)
 {
+	video_print_stats();
+
 	// Close displays
 	vector<monitor_desc *>::iterator i, end = VideoMonitors.end();
 	for (i = VideoMonitors.begin(); i != end; ++i)
@@ -2231,13 +2300,16 @@ static void force_complete_window_refresh()
 			LOCK_VOSF;
 			PFLAG_SET_ALL;
 			UNLOCK_VOSF;
+
+			// Ensure each byte of the_buffer_copy differs from the_buffer to force a full update.
+			const VIDEO_MODE &mode = VideoMonitors[0]->get_current_mode();
+			const int len = VIDEO_MODE_ROW_BYTES * VIDEO_MODE_Y;
+			for (int i = 0; i < len; i++)
+				the_buffer_copy[i] = !the_buffer[i];
+			return;
 		}
 #endif
-		// Ensure each byte of the_buffer_copy differs from the_buffer to force a full update.
-		const VIDEO_MODE &mode = VideoMonitors[0]->get_current_mode();
-		const int len = VIDEO_MODE_ROW_BYTES * VIDEO_MODE_Y;
-		for (int i = 0; i < len; i++)
-			the_buffer_copy[i] = !the_buffer[i];
+		video_tiles_invalidate(&screen_tiles);
 	}
 }
 
@@ -2429,210 +2501,56 @@ static void handle_events(void)
  *  Window display update
  */
 
-// Static display update (fixed frame rate, but incremental)
+// Static display update (fixed frame rate, tile fingerprints based)
 static void update_display_static(driver_base *drv)
 {
-	// Incremental update code
-	int wide = 0, high = 0;
-	uint32 x1, x2, y1, y2;
 	const VIDEO_MODE &mode = drv->mode;
-	int bytes_per_row = VIDEO_MODE_ROW_BYTES;
-	uint8 *p, *p2;
-	uint32 x2_clipped, wide_clipped;
-
-	// Check for first line from top and first line from bottom that have changed
-	y1 = 0;
-	for (uint32 j = 0; j < VIDEO_MODE_Y; j++) {
-		if (memcmp(&the_buffer[j * bytes_per_row], &the_buffer_copy[j * bytes_per_row], bytes_per_row)) {
-			y1 = j;
-			break;
-		}
-	}
-	y2 = y1 - 1;
-	for (uint32 j = VIDEO_MODE_Y; j-- > y1; ) {
-		if (memcmp(&the_buffer[j * bytes_per_row], &the_buffer_copy[j * bytes_per_row], bytes_per_row)) {
-			y2 = j;
-			break;
-		}
-	}
-	high = y2 - y1 + 1;
-
-	// Check for first column from left and first column from right that have changed
-	if (high) {
-		if ((int)VIDEO_MODE_DEPTH < (int)VIDEO_DEPTH_8BIT) {
-			const int src_bytes_per_row = bytes_per_row;
-			const int dst_bytes_per_row = drv->s->pitch;
-			const int pixels_per_byte = 8/mac_depth_of_video_depth(VIDEO_MODE_DEPTH);
-
-			const uint32 line_len = TrivialBytesPerRow(VIDEO_MODE_X, VIDEO_MODE_DEPTH);
-			
-			x1 = line_len;
-			for (uint32 j = y1; j <= y2; j++) {
-				p = &the_buffer[j * bytes_per_row];
-				p2 = &the_buffer_copy[j * bytes_per_row];
-				for (uint32 i = 0; i < x1; i++) {
-					if (*p != *p2) {
-						x1 = i;
-						break;
-					}
-					p++; p2++;
-				}
-			}
-			x2 = x1;
-			for (uint32 j = y1; j <= y2; j++) {
-				p = &the_buffer[j * bytes_per_row];
-				p2 = &the_buffer_copy[j * bytes_per_row];
-				p += bytes_per_row;
-				p2 += bytes_per_row;
-				for (uint32 i = line_len; i > x2; i--) {
-					p--; p2--;
-					if (*p != *p2) {
-						x2 = i;
-						break;
-					}
-				}
-			}
-
-			x1 *= pixels_per_byte;
-			x2 *= pixels_per_byte;
-			wide = x2 - x1;
-			x2_clipped = x2 > VIDEO_MODE_X? VIDEO_MODE_X : x2;
-			wide_clipped = x2_clipped - x1;
-
-			// Update copy of the_buffer
-			if (high && wide) {
-
-				// Lock surface, if required
-				if (SDL_MUSTLOCK(drv->s))
-					SDL_LockSurface(drv->s);
-
-				// Blit to screen surface
-				int si = y1 * src_bytes_per_row + (x1 / pixels_per_byte);
-				int di = y1 * dst_bytes_per_row + x1;
-				for (uint32 j = y1; j <= y2; j++) {
-					memcpy(the_buffer_copy + si, the_buffer + si, wide / pixels_per_byte);
-					Screen_blit((uint8 *)drv->s->pixels + di, the_buffer + si, wide / pixels_per_byte);
-					si += src_bytes_per_row;
-					di += dst_bytes_per_row;
-				}
-
-				// Unlock surface, if required
-				if (SDL_MUSTLOCK(drv->s))
-					SDL_UnlockSurface(drv->s);
-
-				// Refresh display
-				update_sdl_video(drv->s, x1, y1, wide_clipped, high);
-			}
-
-		} else {
-			const int bytes_per_pixel = VIDEO_MODE_ROW_BYTES / VIDEO_MODE_X;
-			const int dst_bytes_per_row = drv->s->pitch;
-
-			x1 = VIDEO_MODE_X;
-			for (uint32 j = y1; j <= y2; j++) {
-				p = &the_buffer[j * bytes_per_row];
-				p2 = &the_buffer_copy[j * bytes_per_row];
-				for (uint32 i = 0; i < x1 * bytes_per_pixel; i++) {
-					if (*p != *p2) {
-						x1 = i / bytes_per_pixel;
-						break;
-					}
-					p++; p2++;
-				}
-			}
-			x2 = x1;
-			for (uint32 j = y1; j <= y2; j++) {
-				p = &the_buffer[j * bytes_per_row];
-				p2 = &the_buffer_copy[j * bytes_per_row];
-				p += bytes_per_row;
-				p2 += bytes_per_row;
-				for (uint32 i = VIDEO_MODE_X * bytes_per_pixel; i > x2 * bytes_per_pixel; i--) {
-					p--;
-					p2--;
-					if (*p != *p2) {
-						x2 = i / bytes_per_pixel;
-						break;
-					}
-				}
-			}
-			wide = x2 - x1;
+	const int depth = mac_depth_of_video_depth(VIDEO_MODE_DEPTH);
 
-			// Update copy of the_buffer
-			if (high && wide) {
-
-				// Lock surface, if required
-				if (SDL_MUSTLOCK(drv->s))
-					SDL_LockSurface(drv->s);
-
-				// Blit to screen surface
-				for (uint32 j = y1; j <= y2; j++) {
-					uint32 i = j * bytes_per_row + x1 * bytes_per_pixel;
-					int dst_i = j * dst_bytes_per_row + x1 * bytes_per_pixel;
-					memcpy(the_buffer_copy + i, the_buffer + i, bytes_per_pixel * wide);
-					Screen_blit((uint8 *)drv->s->pixels + dst_i, the_buffer + i, bytes_per_pixel * wide);
-				}
-
-				// Unlock surface, if required
-				if (SDL_MUSTLOCK(drv->s))
-					SDL_UnlockSurface(drv->s);
-
-				// Refresh display
-				update_sdl_video(drv->s, x1, y1, wide, high);
-			}
-		}
-	}
-}
-
-// Static display update (fixed frame rate, bounding boxes based)
-// XXX use NQD bounding boxes to help detect dirty areas?
-static void update_display_static_bbox(driver_base *drv)
-{
-	const VIDEO_MODE &mode = drv->mode;
-	bool blit = (int)VIDEO_MODE_DEPTH == VIDEO_DEPTH_16BIT;
+	// Find the tiles that changed
+	const uint32 n_tiles = video_tiles_scan(&screen_tiles, the_buffer);
+	if (n_tiles == 0)
+		return;
 
-	// Allocate bounding boxes for SDL_UpdateRects()
-	const uint32 N_PIXELS = 64;
-	const uint32 n_x_boxes = (VIDEO_MODE_X + N_PIXELS - 1) / N_PIXELS;
-	const uint32 n_y_boxes = (VIDEO_MODE_Y + N_PIXELS - 1) / N_PIXELS;
-	SDL_Rect *boxes = (SDL_Rect *)alloca(sizeof(SDL_Rect) * n_x_boxes * n_y_boxes);
-	uint32 nr_boxes = 0;
+	// The screen surface is the Mac frame buffer itself, except for 1/2/4-bit
+	// modes (expanded to 8 bits) and 16-bit modes (byte-swapped)
+	const bool blit = depth < 8 || depth == 16;
 
 	// Lock surface, if required
 	if (SDL_MUSTLOCK(drv->s))
 		SDL_LockSurface(drv->s);
 
 	// Update the surface from Mac screen
+	SDL_Rect *boxes = (SDL_Rect *)alloca(sizeof(SDL_Rect) * n_tiles);
 	const uint32 bytes_per_row = VIDEO_MODE_ROW_BYTES;
-	const uint32 bytes_per_pixel = bytes_per_row / VIDEO_MODE_X;
 	const uint32 dst_bytes_per_row = drv->s->pitch;
-	for (uint32 y = 0; y < VIDEO_MODE_Y; y += N_PIXELS) {
-		uint32 h = N_PIXELS;
+	for (uint32 i = 0; i < n_tiles; i++) {
+		const uint32 tx = screen_tiles.dirty[i] % screen_tiles.n_x;
+		const uint32 ty = screen_tiles.dirty[i] / screen_tiles.n_x;
+		const uint32 xb = tx * screen_tiles.tile_bytes;
+		uint32 xs = screen_tiles.tile_bytes;
+		if (xs > screen_tiles.width - xb)
+			xs = screen_tiles.width - xb;
+		const uint32 y = ty * VIDEO_TILE_ROWS;
+		uint32 h = VIDEO_TILE_ROWS;
 		if (h > VIDEO_MODE_Y - y)
 			h = VIDEO_MODE_Y - y;
-		for (uint32 x = 0; x < VIDEO_MODE_X; x += N_PIXELS) {
-			uint32 w = N_PIXELS;
-			if (w > VIDEO_MODE_X - x)
-				w = VIDEO_MODE_X - x;
-			const int xs = w * bytes_per_pixel;
-			const int xb = x * bytes_per_pixel;
-			bool dirty = false;
-			for (uint32 j = y; j < (y + h); j++) {
-				const uint32 yb = j * bytes_per_row;
-				const uint32 dst_yb = j * dst_bytes_per_row;
-				if (memcmp(&the_buffer[yb + xb], &the_buffer_copy[yb + xb], xs) != 0) {
-					memcpy(&the_buffer_copy[yb + xb], &the_buffer[yb + xb], xs);
-					if (blit) Screen_blit((uint8 *)drv->s->pixels + dst_yb + xb, the_buffer + yb + xb, xs);
-					dirty = true;
-				}
-			}
-			if (dirty) {
-				boxes[nr_boxes].x = x;
-				boxes[nr_boxes].y = y;
-				boxes[nr_boxes].w = w;
-				boxes[nr_boxes].h = h;
-				nr_boxes++;
-			}
+
+		const uint32 x = xb * 8 / depth;
+		uint32 w = xs * 8 / depth;
+		if (w > VIDEO_MODE_X - x)
+			w = VIDEO_MODE_X - x;
+
+		if (blit) {
+			const uint32 dst_xb = depth < 8 ? x : xb;
+			for (uint32 j = y; j < y + h; j++)
+				Screen_blit((uint8 *)drv->s->pixels + j * dst_bytes_per_row + dst_xb, the_buffer + j * bytes_per_row + xb, xs);
 		}
+
+		boxes[i].x = x;
+		boxes[i].y = y;
+		boxes[i].w = w;
+		boxes[i].h = h;
 	}
 
 	// Unlock surface, if required
@@ -2640,8 +2558,7 @@ static void update_display_static_bbox(driver_base *drv)
 		SDL_UnlockSurface(drv->s);
 
 	// Refresh display
-	if (nr_boxes)
-		update_sdl_video(drv->s, nr_boxes, boxes);
+	update_sdl_video(drv->s, n_tiles, boxes);
 }
 
 
@@ -2705,7 +2622,7 @@ static void video_refresh_dga_vosf(void)
 	static uint32 tick_counter = 0;
 	if (++tick_counter >= frame_skip) {
 		tick_counter = 0;
-		if (mainBuffer.dirty) {
+		if (video_vosf_dirty()) {
 			LOCK_VOSF;
 			update_display_dga_vosf(drv);
 			UNLOCK_VOSF;
@@ -2723,7 +2640,7 @@ static void video_refresh_window_vosf(void)
 	static uint32 tick_counter = 0;
 	if (++tick_counter >= frame_skip) {
 		tick_counter = 0;
-		if (mainBuffer.dirty) {
+		if (video_vosf_dirty()) {
 			LOCK_VOSF;
 			update_display_window_vosf(drv);
 			UNLOCK_VOSF;
@@ -2741,11 +2658,7 @@ static void video_refresh_window_static(void)
 	static uint32 tick_counter = 0;
 	if (++tick_counter >= frame_skip) {
 		tick_counter = 0;
-		const VIDEO_MODE &mode = drv->mode;
-		if ((int)VIDEO_MODE_DEPTH >= VIDEO_DEPTH_8BIT)
-			update_display_static_bbox(drv);
-		else
-			update_display_static(drv);
+		update_display_static(drv);
 	}
 }
 
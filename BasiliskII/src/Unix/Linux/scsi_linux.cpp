@@ -256,7 +256,8 @@ bool scsi_send_cmd(size_t data_length, bool reading, int sg_size, uint8 **sg_ptr
 		*stat = h->target_status << 1;
 	}
 
-	// Process S/G table when reading
+	// Process S/G table when reading (data is read into our own buffer
+	// first, so write-protected Mac pages are handled by the SIGSEGV handler)
 	if (reading && h->result == 0) {
 		D(bug(" reading from buffer\n"));
 		uint8 *buffer_ptr = buffer + sizeof(sg_header);
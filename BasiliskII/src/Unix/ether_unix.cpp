@@ -103,6 +103,7 @@ extern "C" {
 #include "user_strings.h"
 #include "ether.h"
 #include "ether_defs.h"
+#include "vm_alloc.h"
 
 #ifndef NO_STD_NAMESPACE
 using std::map;
@@ -1086,6 +1087,9 @@ void ether_do_interrupt(void)
 	ssize_t length;
 	for (;;) {
 
+		// Packet buffer may be write-protected if it held translated code
+		vm_touch(Mac2HostAddr(packet), 1516);
+
 #ifndef SHEEPSHAVER
 		if (udp_tunnel) {
 
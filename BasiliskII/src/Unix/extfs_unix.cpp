@@ -30,6 +30,7 @@
 #include "sysdeps.h"
 #include "extfs.h"
 #include "extfs_defs.h"
+#include "vm_alloc.h"
 
 #define DEBUG 0
 #include "debug.h"
@@ -231,9 +232,9 @@ void get_finfo(const char *path, uint32 finfo, uint32 fxinfo, bool is_dir)
 	// Read Finder info file
 	int fd = open_finf(path, O_RDONLY);
 	if (fd >= 0) {
-		ssize_t actual = read(fd, Mac2HostAddr(finfo), SIZEOF_FInfo);
+		ssize_t actual = extfs_read(fd, Mac2HostAddr(finfo), SIZEOF_FInfo);
 		if (fxinfo)
-			actual += read(fd, Mac2HostAddr(fxinfo), SIZEOF_FXInfo);
+			actual += extfs_read(fd, Mac2HostAddr(fxinfo), SIZEOF_FXInfo);
 		close(fd);
 		if (actual >= SIZEOF_FInfo)
 			return;
@@ -315,6 +316,8 @@ void close_rfork(const char *path, int fd)
 
 ssize_t extfs_read(int fd, void *buffer, size_t length)
 {
+	// Buffer may be write-protected if it held translated code
+	vm_touch(buffer, length);
 	return read(fd, buffer, length);
 }
 
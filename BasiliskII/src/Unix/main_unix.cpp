@@ -33,7 +33,7 @@
 #endif
 #endif
 
-#ifndef USE_SDL_VIDEO
+#if !defined(USE_SDL_VIDEO) && !defined(USE_HEADLESS_VIDEO)
 # include <X11/Xlib.h>
 #endif
 
@@ -108,6 +108,9 @@ extern bool UseJIT;
 extern void flush_icache_range(uint8 *start, uint32 size); // from compemu_support.cpp
 #endif
 #endif
+#ifdef UPDATE_UAE
+extern void flush_predecoded_blocks(void); // from newcpu.cpp
+#endif
 
 #ifdef ENABLE_MON
 # include "mon.h"
@@ -144,7 +147,7 @@ bool TwentyFourBitAddressing;
 
 
 // Global variables
-#ifndef USE_SDL_VIDEO
+#if !defined(USE_SDL_VIDEO) && !defined(USE_HEADLESS_VIDEO)
 extern char *x_display_name;						// X11 display name
 extern Display *x_display;							// X11 display handle
 #ifdef X11_LOCK_TYPE
@@ -206,6 +209,11 @@ static struct sigaction sigint_sa;	// sigaction for SIGINT handler
 static void sigint_handler(...);
 #endif
 
+#if USE_JIT
+static struct sigaction sigprof_sa;	// sigaction for SIGUSR2 handler
+static void sigprof_handler(...);
+#endif
+
 #if REAL_ADDRESSING
 static bool lm_area_mapped = false;	// Flag: Low Memory area mmap()ped
 #endif
@@ -276,6 +284,13 @@ static sigsegv_return_t sigsegv_handler(sigsegv_info_t *sip)
 		return SIGSEGV_RETURN_SUCCESS;
 #endif
 
+#if USE_JIT && defined(UPDATE_UAE)
+	// Handle writes to write-protected translated code
+	extern bool compiler_handle_write_fault(uintptr fault_address);
+	if (compiler_handle_write_fault(fault_address))
+		return SIGSEGV_RETURN_SUCCESS;
+#endif
+
 #ifdef HAVE_SIGSEGV_SKIP_INSTRUCTION
 	// Ignore writes to ROM
 	if (((uintptr)fault_address - (uintptr)ROMBaseHost) < ROMSize)
@@ -384,7 +399,7 @@ void cpu_do_check_ticks(void)
 		emulated_ticks += emulated_ticks_quantum;
 }
 #else
-uint16 emulated_ticks;
+// Called by the CPU when it takes an interrupt raised by SPCFLAG_INT
 void cpu_do_check_ticks(void)
 {
 	static int delay = -1;
@@ -469,7 +484,7 @@ int main(int argc, char **argv)
 	for (int i=1; i<argc; i++) {
 		if (strcmp(argv[i], "--help") == 0) {
 			usage(argv[0]);
-#ifndef USE_SDL_VIDEO
+#if !defined(USE_SDL_VIDEO) && !defined(USE_HEADLESS_VIDEO)
 		} else if (strcmp(argv[i], "--display") == 0) {
 			i++; // don't remove the argument, gtk_init() needs it too
 			if (i < argc)
@@ -585,7 +600,7 @@ int main(int argc, char **argv)
 		}
 	}
 
-#ifndef USE_SDL_VIDEO
+#if !defined(USE_SDL_VIDEO) && !defined(USE_HEADLESS_VIDEO)
 	// Open display
 	x_display = XOpenDisplay(x_display_name);
 	if (x_display == NULL) {
@@ -881,6 +896,16 @@ int main(int argc, char **argv)
 	sigaction(SIGINT, &sigint_sa, NULL);
 #endif
 
+#if USE_JIT
+	// Setup SIGUSR2 handler to print the JIT profile
+	if (UseJIT && PrefsFindBool("jitprofile")) {
+		sigemptyset(&sigprof_sa.sa_mask);
+		sigprof_sa.sa_handler = (void (*)(int))sigprof_handler;
+		sigprof_sa.sa_flags = SA_RESTART;
+		sigaction(SIGUSR2, &sigprof_sa, NULL);
+	}
+#endif
+
 #ifndef USE_CPU_EMUL_SERVICES
 #if defined(HAVE_PTHREADS)
 
@@ -1046,7 +1071,7 @@ void QuitEmulator(void)
 	PrefsExit();
 
 	// Close X11 server connection
-#ifndef USE_SDL_VIDEO
+#if !defined(USE_SDL_VIDEO) && !defined(USE_HEADLESS_VIDEO)
 	if (x_display)
 		XCloseDisplay(x_display);
 #endif
@@ -1076,6 +1101,9 @@ void FlushCodeCache(void *start, uint32 size)
 		flush_icache_range((uint8 *)start, size);
 #endif
 #endif
+#ifdef UPDATE_UAE
+	flush_predecoded_blocks();
+#endif
 #if !EMULATED_68K && defined(__NetBSD__)
 	m68k_sync_icache(start, size);
 #endif
@@ -1107,6 +1135,19 @@ static void sigint_handler(...)
 #endif
 
 
+/*
+ *  SIGUSR2 handler, asks the JIT compiler for its profile
+ */
+
+#if USE_JIT
+static void sigprof_handler(...)
+{
+	extern void compiler_request_profile_dump(void);
+	compiler_request_profile_dump();
+}
+#endif
+
+
 #ifdef HAVE_PTHREADS
 /*
  *  Pthread configuration
@@ -1702,7 +1743,7 @@ void ErrorAlert(const char *text)
 			return;
 	}
 #ifdef ENABLE_GTK
-#ifndef USE_SDL_VIDEO
+#if !defined(USE_SDL_VIDEO) && !defined(USE_HEADLESS_VIDEO)
 	if (x_display == NULL) {
 		printf(GetString(STR_SHELL_ERROR_PREFIX), text);
 		return;
@@ -1728,7 +1769,7 @@ void WarningAlert(const char *text)
 			return;
 	}
 #ifdef ENABLE_GTK
-#ifndef USE_SDL_VIDEO
+#if !defined(USE_SDL_VIDEO) && !defined(USE_HEADLESS_VIDEO)
 	if (x_display == NULL) {
 		printf(GetString(STR_SHELL_WARNING_PREFIX), text);
 		return;
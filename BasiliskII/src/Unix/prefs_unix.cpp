@@ -43,6 +43,11 @@ prefs_desc platform_prefs_items[] = {
 	{"idlewait", TYPE_BOOLEAN, false,      "sleep when idle"},
 #ifdef USE_SDL_VIDEO
 	{"sdlrender", TYPE_STRING, false,      "SDL_Renderer driver (\"auto\", \"software\" (may be faster), etc.)"},
+#endif
+#ifdef USE_HEADLESS_VIDEO
+	{"capturefile", TYPE_STRING, false,    "file to write refreshed frames to (for PNG, a pattern with %d)"},
+	{"captureformat", TYPE_STRING, false,  "format of captured frames (\"raw\", \"y4m\" or \"png\")"},
+	{"capturechanged", TYPE_BOOLEAN, false, "only capture the frames that changed"},
 #endif
 	{NULL, TYPE_END, false, NULL} // End of list
 };
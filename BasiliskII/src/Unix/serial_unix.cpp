@@ -738,7 +738,13 @@ void *XSERDPort::input_func(void *arg)
 		void *buf = Mac2HostAddr(ReadMacInt32(s->input_pb + ioBuffer));
 		uint32 length = ReadMacInt32(s->input_pb + ioReqCount);
 		D(bug("input_func waiting for %ld bytes of data...\n", length));
-		int32 actual = read(s->fd, buf, length);
+
+		// Read into a local buffer, the Mac buffer may get write-protected
+		// by the JIT while we are blocked and read() would then fail
+		uint8 data[4096];
+		int32 actual = read(s->fd, data, length < sizeof(data) ? length : sizeof(data));
+		if (actual > 0)
+			memcpy(buf, data, actual);
 		D(bug(" %ld bytes received\n", actual));
 
 #if MONITOR
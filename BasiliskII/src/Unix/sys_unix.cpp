@@ -56,6 +56,7 @@
 #include "prefs.h"
 #include "user_strings.h"
 #include "sys.h"
+#include "vm_alloc.h"
 #include "disk_unix.h"
 
 #if defined(BINCUE)
@@ -755,6 +756,9 @@ size_t Sys_read(void *arg, void *buffer, loff_t offset, size_t length)
 	if (!fh)
 		return 0;
 
+	// Buffer may be write-protected if it held translated code
+	vm_touch(buffer, length);
+
 #if defined(BINCUE)
 	if (fh->is_bincue)
 		return read_bincue(fh->bincue_fd, buffer, offset, length);
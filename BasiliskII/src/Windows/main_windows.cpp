@@ -195,7 +195,7 @@ static void sigsegv_dump_state(sigsegv_info_t *sip)
 #endif
 }
 
-uint16 emulated_ticks;
+// Called by the CPU when it takes an interrupt raised by SPCFLAG_INT
 void cpu_do_check_ticks(void)
 {
 	static int delay = -1;
@@ -60,12 +60,17 @@ prefs_desc common_prefs_items[] = {
 	{"nosound", TYPE_BOOLEAN, false,  "don't enable sound output"},
 	{"noclipconversion", TYPE_BOOLEAN, false, "don't convert clipboard contents"},
 	{"nogui", TYPE_BOOLEAN, false,    "disable GUI"},
+	{"predecode", TYPE_BOOLEAN, false,   "enable predecoded 68k interpreter"},
 	{"jit", TYPE_BOOLEAN, false,         "enable JIT compiler"},
 	{"jitfpu", TYPE_BOOLEAN, false,      "enable JIT compilation of FPU instructions"},
 	{"jitdebug", TYPE_BOOLEAN, false,    "enable JIT debugger (requires mon builtin)"},
 	{"jitcachesize", TYPE_INT32, false,  "translation cache size in KB"},
 	{"jitlazyflush", TYPE_BOOLEAN, false, "enable lazy invalidation of translation cache"},
+	{"jitprotect", TYPE_BOOLEAN, false,  "write-protect translated code pages to detect changes"},
 	{"jitinline", TYPE_BOOLEAN, false,   "enable translation through constant jumps"},
+	{"jittrace", TYPE_BOOLEAN, false,    "enable translation through biased conditional branches"},
+	{"jitprofile", TYPE_BOOLEAN, false,  "collect and report JIT translation statistics"},
+	{"jitperf", TYPE_STRING, false,      "tell Linux perf about translated code (perfmap or jitdump)"},
 	{"jitblacklist", TYPE_STRING, false, "blacklist opcodes from translation"},
 	{"keyboardtype", TYPE_INT32, false, "hardware keyboard type"},
 	{"keycodes", TYPE_BOOLEAN, false, "use keycodes rather than keysyms to decode keyboard"},
@@ -85,7 +90,7 @@ prefs_desc common_prefs_items[] = {
 	{"title", TYPE_STRING, false,	"window title"},
 	{"sound_buffer", TYPE_INT32, false,	"sound buffer length"},
 	{"name_encoding", TYPE_INT32, false,	"file name encoding"},
-	{"delay", TYPE_INT32, false,	"additional delay [uS] every 64k instructions"},
+	{"delay", TYPE_INT32, false,	"additional delay [uS] on every interrupt"},
 	{"init_grab", TYPE_BOOLEAN, false,	"initially grabbing mouse"},
 	{"xpram", TYPE_STRING, false, "path of xpram file"},
 	{NULL, TYPE_END, false, NULL} // End of list
@@ -113,6 +118,7 @@ void AddPrefsDefaults(void)
 	PrefsAddBool("nosound", false);
 	PrefsAddBool("noclipconversion", false);
 	PrefsAddBool("nogui", false);
+	PrefsAddBool("predecode", false);
 	
 #if USE_JIT
 	// JIT compiler specific options
@@ -121,7 +127,10 @@ void AddPrefsDefaults(void)
 	PrefsAddBool("jitdebug", false);
 	PrefsAddInt32("jitcachesize", 8192);
 	PrefsAddBool("jitlazyflush", true);
+	PrefsAddBool("jitprotect", false);
 	PrefsAddBool("jitinline", true);
+	PrefsAddBool("jittrace", false);
+	PrefsAddBool("jitprofile", false);
 #else
 	PrefsAddBool("jit", false);
 #endif
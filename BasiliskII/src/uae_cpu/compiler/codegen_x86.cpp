@@ -4051,6 +4051,24 @@ static bool target_check_bsf(void)
  *************************************************************************/
 
 
+#if defined(USE_JIT_FPU_SSE)
+
+/* FP registers are held as scalar doubles in %xmm0 .. %xmm14, and %xmm15
+   is a scratch register. The x87 unit is only used transiently, through
+   memory, for the operations that SSE2 lacks. */
+#define FP_XMM(r)	(X86_XMM0+(r))
+#define FP_SCRATCH	(X86_XMM0+15)
+
+static __inline__ void raw_fp_init(void)
+{
+}
+
+static __inline__ void raw_fp_cleanup_drop(void)
+{
+}
+
+#else
+
 static __inline__ void raw_fp_init(void)
 {
     int i;
@@ -4168,6 +4186,8 @@ static __inline__ void tos_make(int r)
 					 and pop it*/
 }
 
+#endif
+
 /* FP helper functions */
 #if USE_NEW_RTASM
 #define DEFINE_OP(NAME, GEN)			\
@@ -4204,6 +4224,346 @@ DEFINE_OP(fldt,  0xdb, 0x2d);
 #endif
 #undef DEFINE_OP
 
+#if defined(USE_JIT_FPU_SSE)
+
+/* Memory slot used to move values between %xmm registers and the x87 stack */
+static double fp_x87_temp;
+
+static const double fp_const_pi		= 3.14159265358979323846;
+static const double fp_const_log10_2	= 0.30102999566398119521;
+static const double fp_const_log2_e	= 1.44269504088896340736;
+static const double fp_const_loge_2	= 0.69314718055994530942;
+static const double fp_const_one	= 1.0;
+static const uae_u64 fp_abs_mask	= UVAL64(0x7fffffffffffffff);
+static const uae_u64 fp_sign_mask	= UVAL64(0x8000000000000000);
+
+static inline void raw_fp_load_const(int r, const void *c)
+{
+    MOVSDmr((uintptr)c, X86_NOREG, X86_NOREG, 1, r);
+}
+
+/* Push the value of FP register r onto the x87 stack */
+static inline void raw_fp_x87_push(int r)
+{
+    MOVSDrm(FP_XMM(r), (uintptr)&fp_x87_temp, X86_NOREG, X86_NOREG, 1);
+    raw_fldl((uintptr)&fp_x87_temp);
+}
+
+/* Pop the top of the x87 stack into FP register r */
+static inline void raw_fp_x87_pop(int r)
+{
+    raw_fstpl((uintptr)&fp_x87_temp);
+    MOVSDmr((uintptr)&fp_x87_temp, X86_NOREG, X86_NOREG, 1, FP_XMM(r));
+}
+
+LOWFUNC(NONE,WRITE,2,raw_fmov_mr,(MEMW m, FR r))
+{
+    MOVSDrm(FP_XMM(r), m, X86_NOREG, X86_NOREG, 1);
+}
+LENDFUNC(NONE,WRITE,2,raw_fmov_mr,(MEMW m, FR r))
+
+LOWFUNC(NONE,WRITE,2,raw_fmov_mr_drop,(MEMW m, FR r))
+{
+    MOVSDrm(FP_XMM(r), m, X86_NOREG, X86_NOREG, 1);
+}
+LENDFUNC(NONE,WRITE,2,raw_fmov_mr,(MEMW m, FR r))
+
+LOWFUNC(NONE,READ,2,raw_fmov_rm,(FW r, MEMR m))
+{
+    MOVSDmr(m, X86_NOREG, X86_NOREG, 1, FP_XMM(r));
+}
+LENDFUNC(NONE,READ,2,raw_fmov_rm,(FW r, MEMR m))
+
+LOWFUNC(NONE,READ,2,raw_fmovi_rm,(FW r, MEMR m))
+{
+    CVTSI2SDLmr(m, X86_NOREG, X86_NOREG, 1, FP_XMM(r));
+}
+LENDFUNC(NONE,READ,2,raw_fmovi_rm,(FW r, MEMR m))
+
+LOWFUNC(NONE,WRITE,2,raw_fmovi_mr,(MEMW m, FR r))
+{
+    /* cvtsd2si needs an integer register, fistp can store to memory */
+    raw_fp_x87_push(r);
+    FISTPLm(m, X86_NOREG, X86_NOREG, 1);
+}
+LENDFUNC(NONE,WRITE,2,raw_fmovi_mr,(MEMW m, FR r))
+
+LOWFUNC(NONE,READ,2,raw_fmovs_rm,(FW r, MEMR m))
+{
+    CVTSS2SDmr(m, X86_NOREG, X86_NOREG, 1, FP_XMM(r));
+}
+LENDFUNC(NONE,READ,2,raw_fmovs_rm,(FW r, MEMR m))
+
+LOWFUNC(NONE,WRITE,2,raw_fmovs_mr,(MEMW m, FR r))
+{
+    CVTSD2SSrr(FP_XMM(r), FP_SCRATCH);
+    MOVSSrm(FP_SCRATCH, m, X86_NOREG, X86_NOREG, 1);
+}
+LENDFUNC(NONE,WRITE,2,raw_fmovs_mr,(MEMW m, FR r))
+
+LOWFUNC(NONE,WRITE,2,raw_fmov_ext_mr,(MEMW m, FR r))
+{
+    raw_fp_x87_push(r);
+    raw_fstpt(m);	/* store and pop it */
+}
+LENDFUNC(NONE,WRITE,2,raw_fmov_ext_mr,(MEMW m, FR r))
+
+LOWFUNC(NONE,WRITE,2,raw_fmov_ext_mr_drop,(MEMW m, FR r))
+{
+    raw_fp_x87_push(r);
+    raw_fstpt(m);	/* store and pop it */
+}
+LENDFUNC(NONE,WRITE,2,raw_fmov_ext_mr,(MEMW m, FR r))
+
+LOWFUNC(NONE,READ,2,raw_fmov_ext_rm,(FW r, MEMR m))
+{
+    raw_fldt(m);
+    raw_fp_x87_pop(r);
+}
+LENDFUNC(NONE,READ,2,raw_fmov_ext_rm,(FW r, MEMR m))
+
+LOWFUNC(NONE,NONE,1,raw_fmov_pi,(FW r))
+{
+    raw_fp_load_const(FP_XMM(r), &fp_const_pi);
+}
+LENDFUNC(NONE,NONE,1,raw_fmov_pi,(FW r))
+
+LOWFUNC(NONE,NONE,1,raw_fmov_log10_2,(FW r))
+{
+    raw_fp_load_const(FP_XMM(r), &fp_const_log10_2);
+}
+LENDFUNC(NONE,NONE,1,raw_fmov_log10_2,(FW r))
+
+LOWFUNC(NONE,NONE,1,raw_fmov_log2_e,(FW r))
+{
+    raw_fp_load_const(FP_XMM(r), &fp_const_log2_e);
+}
+LENDFUNC(NONE,NONE,1,raw_fmov_log2_e,(FW r))
+
+LOWFUNC(NONE,NONE,1,raw_fmov_loge_2,(FW r))
+{
+    raw_fp_load_const(FP_XMM(r), &fp_const_loge_2);
+}
+LENDFUNC(NONE,NONE,1,raw_fmov_loge_2,(FW r))
+
+LOWFUNC(NONE,NONE,1,raw_fmov_1,(FW r))
+{
+    raw_fp_load_const(FP_XMM(r), &fp_const_one);
+}
+LENDFUNC(NONE,NONE,1,raw_fmov_1,(FW r))
+
+LOWFUNC(NONE,NONE,1,raw_fmov_0,(FW r))
+{
+    XORPDrr(FP_XMM(r), FP_XMM(r));
+}
+LENDFUNC(NONE,NONE,1,raw_fmov_0,(FW r))
+
+LOWFUNC(NONE,NONE,2,raw_fmov_rr,(FW d, FR s))
+{
+    if (d!=s)
+	MOVAPDrr(FP_XMM(s), FP_XMM(d));
+}
+LENDFUNC(NONE,NONE,2,raw_fmov_rr,(FW d, FR s))
+
+LOWFUNC(NONE,READ,4,raw_fldcw_m_indexed,(R4 index, IMM base))
+{
+    emit_byte(0xd9);
+    emit_byte(0xa8+index);
+    emit_long(base);
+}
+LENDFUNC(NONE,READ,4,raw_fldcw_m_indexed,(R4 index, IMM base))
+
+
+LOWFUNC(NONE,NONE,2,raw_fsqrt_rr,(FW d, FR s))
+{
+    SQRTSDrr(FP_XMM(s), FP_XMM(d));
+}
+LENDFUNC(NONE,NONE,2,raw_fsqrt_rr,(FW d, FR s))
+
+LOWFUNC(NONE,NONE,2,raw_fabs_rr,(FW d, FR s))
+{
+    raw_fp_load_const(FP_SCRATCH, &fp_abs_mask);
+    if (d!=s)
+	MOVAPDrr(FP_XMM(s), FP_XMM(d));
+    ANDPDrr(FP_SCRATCH, FP_XMM(d)); /* clear the sign bit */
+}
+LENDFUNC(NONE,NONE,2,raw_fabs_rr,(FW d, FR s))
+
+LOWFUNC(NONE,NONE,2,raw_frndint_rr,(FW d, FR s))
+{
+    raw_fp_x87_push(s);
+    emit_byte(0xd9);
+    emit_byte(0xfc); /* take frndint */
+    raw_fp_x87_pop(d);
+}
+LENDFUNC(NONE,NONE,2,raw_frndint_rr,(FW d, FR s))
+
+LOWFUNC(NONE,NONE,2,raw_fcos_rr,(FW d, FR s))
+{
+    raw_fp_x87_push(s);
+    emit_byte(0xd9);
+    emit_byte(0xff); /* take cos */
+    raw_fp_x87_pop(d);
+}
+LENDFUNC(NONE,NONE,2,raw_fcos_rr,(FW d, FR s))
+
+LOWFUNC(NONE,NONE,2,raw_fsin_rr,(FW d, FR s))
+{
+    raw_fp_x87_push(s);
+    emit_byte(0xd9);
+    emit_byte(0xfe); /* take sin */
+    raw_fp_x87_pop(d);
+}
+LENDFUNC(NONE,NONE,2,raw_fsin_rr,(FW d, FR s))
+
+LOWFUNC(NONE,NONE,2,raw_ftwotox_rr,(FW d, FR s))
+{
+    raw_fp_x87_push(s);
+
+    emit_byte(0xd9);
+    emit_byte(0xc0);  /* duplicate top of stack */
+    emit_byte(0xd9);
+    emit_byte(0xfc);  /* rndint */
+    emit_byte(0xd9);
+    emit_byte(0xc9);  /* swap top two elements */
+    emit_byte(0xd8);
+    emit_byte(0xe1);  /* subtract rounded from original */
+    emit_byte(0xd9);
+    emit_byte(0xf0);  /* f2xm1 */
+    x86_fadd_m((uintptr)&fp_const_one);
+    emit_byte(0xd9);
+    emit_byte(0xfd);  /* and scale it */
+    emit_byte(0xdd);
+    emit_byte(0xd9);  /* take the rounded value off */
+    raw_fp_x87_pop(d);
+}
+LENDFUNC(NONE,NONE,2,raw_ftwotox_rr,(FW d, FR s))
+
+LOWFUNC(NONE,NONE,2,raw_fetox_rr,(FW d, FR s))
+{
+    raw_fp_x87_push(s);
+    emit_byte(0xd9);
+    emit_byte(0xea);   /* fldl2e */
+    emit_byte(0xde);
+    emit_byte(0xc9);  /* fmulp --- multiply source by log2(e) */
+
+    emit_byte(0xd9);
+    emit_byte(0xc0);  /* duplicate top of stack */
+    emit_byte(0xd9);
+    emit_byte(0xfc);  /* rndint */
+    emit_byte(0xd9);
+    emit_byte(0xc9);  /* swap top two elements */
+    emit_byte(0xd8);
+    emit_byte(0xe1);  /* subtract rounded from original */
+    emit_byte(0xd9);
+    emit_byte(0xf0);  /* f2xm1 */
+    x86_fadd_m((uintptr)&fp_const_one);
+    emit_byte(0xd9);
+    emit_byte(0xfd);  /* and scale it */
+    emit_byte(0xdd);
+    emit_byte(0xd9);  /* take the rounded value off */
+    raw_fp_x87_pop(d);
+}
+LENDFUNC(NONE,NONE,2,raw_fetox_rr,(FW d, FR s))
+
+LOWFUNC(NONE,NONE,2,raw_flog2_rr,(FW d, FR s))
+{
+    raw_fp_x87_push(s);
+    emit_byte(0xd9);
+    emit_byte(0xe8); /* push '1' */
+    emit_byte(0xd9);
+    emit_byte(0xc9); /* swap top two */
+    emit_byte(0xd9);
+    emit_byte(0xf1); /* take 1*log2(x) */
+    raw_fp_x87_pop(d);
+}
+LENDFUNC(NONE,NONE,2,raw_flog2_rr,(FW d, FR s))
+
+
+LOWFUNC(NONE,NONE,2,raw_fneg_rr,(FW d, FR s))
+{
+    raw_fp_load_const(FP_SCRATCH, &fp_sign_mask);
+    if (d!=s)
+	MOVAPDrr(FP_XMM(s), FP_XMM(d));
+    XORPDrr(FP_SCRATCH, FP_XMM(d)); /* flip the sign bit */
+}
+LENDFUNC(NONE,NONE,2,raw_fneg_rr,(FW d, FR s))
+
+LOWFUNC(NONE,NONE,2,raw_fadd_rr,(FRW d, FR s))
+{
+    ADDSDrr(FP_XMM(s), FP_XMM(d));
+}
+LENDFUNC(NONE,NONE,2,raw_fadd_rr,(FRW d, FR s))
+
+LOWFUNC(NONE,NONE,2,raw_fsub_rr,(FRW d, FR s))
+{
+    SUBSDrr(FP_XMM(s), FP_XMM(d));
+}
+LENDFUNC(NONE,NONE,2,raw_fsub_rr,(FRW d, FR s))
+
+LOWFUNC(NONE,NONE,2,raw_fcmp_rr,(FR d, FR s))
+{
+    UCOMISDrr(FP_XMM(s), FP_XMM(d));
+}
+LENDFUNC(NONE,NONE,2,raw_fcmp_rr,(FR d, FR s))
+
+LOWFUNC(NONE,NONE,2,raw_fmul_rr,(FRW d, FR s))
+{
+    MULSDrr(FP_XMM(s), FP_XMM(d));
+}
+LENDFUNC(NONE,NONE,2,raw_fmul_rr,(FRW d, FR s))
+
+LOWFUNC(NONE,NONE,2,raw_fdiv_rr,(FRW d, FR s))
+{
+    DIVSDrr(FP_XMM(s), FP_XMM(d));
+}
+LENDFUNC(NONE,NONE,2,raw_fdiv_rr,(FRW d, FR s))
+
+LOWFUNC(NONE,NONE,2,raw_frem_rr,(FRW d, FR s))
+{
+    raw_fp_x87_push(s);
+    raw_fp_x87_push(d);
+    emit_byte(0xd9);
+    emit_byte(0xf8); /* take rem from dest by source */
+    emit_byte(0xdd);
+    emit_byte(0xd9); /* take the source off */
+    raw_fp_x87_pop(d);
+}
+LENDFUNC(NONE,NONE,2,raw_frem_rr,(FRW d, FR s))
+
+LOWFUNC(NONE,NONE,2,raw_frem1_rr,(FRW d, FR s))
+{
+    raw_fp_x87_push(s);
+    raw_fp_x87_push(d);
+    emit_byte(0xd9);
+    emit_byte(0xf5); /* take rem1 from dest by source */
+    emit_byte(0xdd);
+    emit_byte(0xd9); /* take the source off */
+    raw_fp_x87_pop(d);
+}
+LENDFUNC(NONE,NONE,2,raw_frem1_rr,(FRW d, FR s))
+
+
+LOWFUNC(NONE,NONE,1,raw_ftst_r,(FR r))
+{
+    XORPDrr(FP_SCRATCH, FP_SCRATCH);
+    UCOMISDrr(FP_SCRATCH, FP_XMM(r));
+}
+LENDFUNC(NONE,NONE,1,raw_ftst_r,(FR r))
+
+/* ucomisd doesn't need any integer register */
+#define FFLAG_NREG_CLOBBER_CONDITION 0
+#define FFLAG_NREG EAX_INDEX
+
+static __inline__ void raw_fflags_into_flags(int r)
+{
+    XORPDrr(FP_SCRATCH, FP_SCRATCH);
+    UCOMISDrr(FP_SCRATCH, FP_XMM(r)); /* compare value with 0 */
+}
+
+#else
+
+
 LOWFUNC(NONE,WRITE,2,raw_fmov_mr,(MEMW m, FR r))
 {
     make_tos(r);
@@ -4756,3 +5116,5 @@ static __inline__ void raw_fflags_into_flags(int r)
     emit_byte(0xdd);
     emit_byte(0xd9+p);  /* store value back, and get rid of 0 */
 }
+
+#endif
@@ -135,7 +135,11 @@ union cacheline {
 #else
 #define N_REGS 8  /* really only 7, but they are numbered 0,1,2,3,5,6,7 */
 #endif
+#if defined(USE_JIT_FPU_SSE)
+#define N_FREGS 15 /* %xmm0-%xmm14, %xmm15 is kept as a scratch register */
+#else
 #define N_FREGS 6 /* That leaves us two positions on the stack to play with */
+#endif
 
 /* Functions exposed to newcpu, or to what was moved from newcpu.c to
  * compemu_support.c */
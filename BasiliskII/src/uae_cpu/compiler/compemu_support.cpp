@@ -62,12 +62,14 @@
 #include <stdlib.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <signal.h>
 
 #include "cpu_emulation.h"
 #include "main.h"
 #include "prefs.h"
 #include "user_strings.h"
 #include "vm_alloc.h"
+#include "jit_perf.h"
 
 #include "m68k.h"
 #include "memory.h"
@@ -4964,6 +4966,240 @@ struct scratch_t {
 
 static scratch_t scratch;
 
+/********************************************************************
+ * Translation profiler                                             *
+ ********************************************************************/
+
+/* With the "jitprofile" pref, translated blocks count their own entries
+   and the instructions they leave to the interpreter, while
+   execute_normal() and exec_nostats() count the instructions they run.
+   Each entry of a block is credited to all of its instructions, even
+   when it is left early. Per-opcode counts are indexed in m68k order. */
+
+struct jit_profile_block {
+	uae_u8 *pc_p;
+	uae_u64 entries;			// Bumped by translated code, since last translation
+	uae_u32 compiles;
+	uae_u32 checksum_failures;
+	uae_u32 nops;
+	uae_u16 *ops;				// Opcodes of the last translation
+	jit_profile_block *next;	// Hash chain (and LazyBlockAllocator free list)
+};
+
+const int PROFILE_HASH_SIZE = 4096;
+const int PROFILE_TOP_OPCODES = 50;
+const int PROFILE_TOP_BLOCKS = 20;
+
+static bool jit_profile = false; // Flag: collect translation statistics
+static volatile sig_atomic_t profile_dump_requested = 0;
+static LazyBlockAllocator<jit_profile_block> ProfileBlockAllocator;
+static jit_profile_block *profile_blocks[PROFILE_HASH_SIZE];
+static uae_u64 profile_retired_count[65536];	// Entries of blocks translated again since
+static uae_u64 profile_fallback_count[65536];	// Bumped by translated code
+static uae_u64 profile_interp_count[65536];
+static uae_u32 profile_block_ends[65536];
+static uae_u32 profile_checksum_failures = 0;
+static const uae_u64 *profile_sort_key;
+
+static inline uae_u32 profile_hash(uae_u8 *pc_p)
+{
+	return ((uintptr)pc_p >> 1) & (PROFILE_HASH_SIZE - 1);
+}
+
+static jit_profile_block *profile_find_block(uae_u8 *pc_p)
+{
+	jit_profile_block *pb = profile_blocks[profile_hash(pc_p)];
+	while (pb && pb->pc_p != pc_p)
+		pb = pb->next;
+	return pb;
+}
+
+/* Records a new translation of the block at pc_hist[0], the previous
+   translation's entries are moved over to its opcodes */
+static jit_profile_block *profile_block_compiled(cpu_history *pc_hist, int blocklen)
+{
+	uae_u8 *pc_p = (uae_u8 *)pc_hist[0].location;
+	jit_profile_block *pb = profile_find_block(pc_p);
+	if (!pb) {
+		pb = ProfileBlockAllocator.acquire();
+		memset(pb, 0, sizeof(*pb));
+		pb->pc_p = pc_p;
+		pb->next = profile_blocks[profile_hash(pc_p)];
+		profile_blocks[profile_hash(pc_p)] = pb;
+	}
+	for (uae_u32 i = 0; i < pb->nops; i++)
+		profile_retired_count[pb->ops[i]] += pb->entries;
+	pb->entries = 0;
+	pb->compiles++;
+
+	if (pb->nops != (uae_u32)blocklen) {
+		free(pb->ops);
+		pb->ops = (uae_u16 *)malloc(blocklen * sizeof(uae_u16));
+		pb->nops = pb->ops ? blocklen : 0;
+	}
+	for (uae_u32 i = 0; i < pb->nops; i++)
+		pb->ops[i] = do_get_mem_word(pc_hist[i].location);
+
+	uae_u32 last = do_get_mem_word(pc_hist[blocklen - 1].location);
+	if (end_block(cft_map(last)))
+		profile_block_ends[last]++;
+	return pb;
+}
+
+/* Emits a 64-bit increment of a counter, flags are clobbered */
+static void profile_emit_count(uae_u64 *counter)
+{
+	raw_add_l_mi((uintptr)counter, 1);
+	raw_jcc_b_oponly(NATIVE_CC_CC);
+	uae_s8 *branchadd = (uae_s8 *)get_target();
+	emit_byte(0);
+	raw_add_l_mi((uintptr)counter + 4, 1);
+	*branchadd = (uintptr)get_target() - ((uintptr)branchadd + 1);
+}
+
+static inline void profile_interpreted(uae_u32 opcode)
+{
+	if (jit_profile)
+		profile_interp_count[cft_map(opcode)]++;
+}
+
+static void profile_checksum_failed(blockinfo *bi)
+{
+	jit_profile_block *pb = profile_find_block(bi->pc_p);
+	if (pb)
+		pb->checksum_failures++;
+	profile_checksum_failures++;
+}
+
+static int profile_opcode_compare(const void *e1, const void *e2)
+{
+	uae_u64 a = profile_sort_key[*(const uae_u16 *)e1];
+	uae_u64 b = profile_sort_key[*(const uae_u16 *)e2];
+	return a < b ? 1 : (a > b ? -1 : 0);
+}
+
+static int profile_block_compare(const void *e1, const void *e2)
+{
+	const jit_profile_block *a = *(const jit_profile_block * const *)e1;
+	const jit_profile_block *b = *(const jit_profile_block * const *)e2;
+	if (a->compiles != b->compiles)
+		return a->compiles < b->compiles ? 1 : -1;
+	if (a->checksum_failures != b->checksum_failures)
+		return a->checksum_failures < b->checksum_failures ? 1 : -1;
+	return 0;
+}
+
+static const char *profile_opcode_name(uae_u32 opcode)
+{
+	struct instr *dp = table68k + opcode;
+	struct mnemolookup *lookup;
+	for (lookup = lookuptab; lookup->mnemo != dp->mnemo; lookup++)
+		;
+	return lookup->name;
+}
+
+/* Prints the statistics gathered so far, opcodes that miss translation most first */
+static void compiler_dump_profile(void)
+{
+	uae_u64 *compiled = (uae_u64 *)malloc(65536 * sizeof(uae_u64));
+	uae_u64 *missed = (uae_u64 *)malloc(65536 * sizeof(uae_u64));
+	uae_u16 *opcodes = (uae_u16 *)malloc(65536 * sizeof(uae_u16));
+	if (!compiled || !missed || !opcodes) {
+		free(compiled);
+		free(missed);
+		free(opcodes);
+		return;
+	}
+
+	uae_u32 nblocks = 0, recompiles = 0;
+	memcpy(compiled, profile_retired_count, 65536 * sizeof(uae_u64));
+	for (int h = 0; h < PROFILE_HASH_SIZE; h++) {
+		for (jit_profile_block *pb = profile_blocks[h]; pb; pb = pb->next) {
+			for (uae_u32 i = 0; i < pb->nops; i++)
+				compiled[pb->ops[i]] += pb->entries;
+			recompiles += pb->compiles - 1;
+			nblocks++;
+		}
+	}
+
+	uae_u64 total_compiled = 0, total_fallback = 0, total_interp = 0;
+	for (int i = 0; i < 65536; i++) {
+		opcodes[i] = i;
+		missed[i] = profile_fallback_count[i] + profile_interp_count[i];
+		total_compiled += compiled[i];
+		total_fallback += profile_fallback_count[i];
+		total_interp += profile_interp_count[i];
+	}
+	uae_u64 total = total_compiled + total_fallback + total_interp;
+
+	write_log("### JIT profile\n");
+	write_log("Instructions translated  : %llu (%.1f%%)\n", (unsigned long long)total_compiled, total ? 100.0*double(total_compiled)/double(total) : 0.0);
+	write_log("Interpreted in blocks    : %llu (%.1f%%)\n", (unsigned long long)total_fallback, total ? 100.0*double(total_fallback)/double(total) : 0.0);
+	write_log("Interpreted alone        : %llu (%.1f%%)\n", (unsigned long long)total_interp, total ? 100.0*double(total_interp)/double(total) : 0.0);
+	write_log("Blocks translated        : %u (%u recompilations)\n", nblocks, recompiles);
+	write_log("Block checksum failures  : %u\n", profile_checksum_failures);
+	write_log("Translation cache flushes: %d hard, %d lazy\n", hard_flush_count, soft_flush_count);
+
+	profile_sort_key = missed;
+	qsort(opcodes, 65536, sizeof(uae_u16), profile_opcode_compare);
+	write_log("Rank Opc          Translated         In blocks            Alone   Ends Name\n");
+	for (int i = 0; i < PROFILE_TOP_OPCODES; i++) {
+		uae_u16 opcode = opcodes[i];
+		if (!missed[opcode])
+			break;
+		write_log("%03d: %04x %16llu %16llu %16llu %6u %s\n", i, opcode,
+			(unsigned long long)compiled[opcode],
+			(unsigned long long)profile_fallback_count[opcode],
+			(unsigned long long)profile_interp_count[opcode],
+			profile_block_ends[opcode], profile_opcode_name(opcode));
+	}
+
+	/* Opcodes closing the most blocks */
+	for (int i = 0; i < 65536; i++) {
+		opcodes[i] = i;
+		missed[i] = profile_block_ends[i];
+	}
+	qsort(opcodes, 65536, sizeof(uae_u16), profile_opcode_compare);
+	write_log("Rank Opc  Ends Name\n");
+	for (int i = 0; i < PROFILE_TOP_OPCODES / 5; i++) {
+		uae_u16 opcode = opcodes[i];
+		if (!profile_block_ends[opcode])
+			break;
+		write_log("%03d: %04x %6u %s\n", i, opcode, profile_block_ends[opcode], profile_opcode_name(opcode));
+	}
+	profile_sort_key = NULL;
+	free(compiled);
+	free(missed);
+	free(opcodes);
+
+	/* Blocks translated most often */
+	jit_profile_block **blocks = (jit_profile_block **)malloc(nblocks * sizeof(jit_profile_block *));
+	if (blocks) {
+		uae_u32 n = 0;
+		for (int h = 0; h < PROFILE_HASH_SIZE; h++) {
+			for (jit_profile_block *pb = profile_blocks[h]; pb; pb = pb->next)
+				blocks[n++] = pb;
+		}
+		qsort(blocks, nblocks, sizeof(jit_profile_block *), profile_block_compare);
+		write_log("Rank PC        Compiles Checksum failures Length\n");
+		for (uae_u32 i = 0; i < nblocks && i < (uae_u32)PROFILE_TOP_BLOCKS; i++) {
+			jit_profile_block *pb = blocks[i];
+			if (pb->compiles < 2)
+				break;
+			write_log("%03d: %08x %8u %17u %6u\n", i, get_virtual_address(pb->pc_p),
+				pb->compiles, pb->checksum_failures, pb->nops);
+		}
+		free(blocks);
+	}
+	fflush(stdout);
+}
+
+/* Called from a signal handler, the report is printed from the emulation thread */
+void compiler_request_profile_dump(void)
+{
+	profile_dump_requested = 1;
+}
+
 /********************************************************************
  * Support functions exposed to newcpu                              *
  ********************************************************************/
@@ -4993,6 +5229,9 @@ void compiler_init(void)
 	avoid_fpu = true;
 #endif
 	write_log("<JIT compiler> : compile FPU instructions : %s\n", !avoid_fpu ? "yes" : "no");
+#ifdef USE_JIT_FPU_SSE
+	write_log("<JIT compiler> : FPU registers held in SSE2 doubles\n");
+#endif
 	
 	// Get size of the translation cache (in KB)
 	cache_size = PrefsFindInt32("jitcachesize");
@@ -5018,8 +5257,14 @@ void compiler_init(void)
 	follow_const_jumps = PrefsFindBool("jitinline");
 #endif
 	write_log("<JIT compiler> : translate through constant jumps : %s\n", str_on_off(follow_const_jumps));
+	jit_profile = PrefsFindBool("jitprofile");
+	write_log("<JIT compiler> : translation profiler : %s\n", str_on_off(jit_profile));
 	write_log("<JIT compiler> : separate blockinfo allocation : %s\n", str_on_off(USE_SEPARATE_BIA));
 	
+	// Tell host profilers about translated code
+	jit_perf_init(PrefsFindString("jitperf"));
+	write_log("<JIT compiler> : translated code info for perf : %s\n", str_on_off(jit_perf_enabled));
+	
 	// Build compiler tables
 	build_comp();
 	
@@ -5046,6 +5291,10 @@ void compiler_exit(void)
 		vm_release(compiled_code, cache_size * 1024);
 		compiled_code = 0;
 	}
+	jit_perf_exit();
+
+	if (jit_profile)
+		compiler_dump_profile();
 
 	// Deallocate popallspace
 	if (popallspace) {
@@ -5873,6 +6122,8 @@ static inline int block_check_checksum(blockinfo* bi)
 	   and set it up to be recompiled */
 	/* write_log("discard %p/%p (%x %x/%x %x)\n",bi,bi->pc_p,
 	   c1,c2,bi->c1,bi->c2); */
+	if (jit_profile)
+	    profile_checksum_failed(bi);
 	invalidate_block(bi);
 	raise_in_cl_list(bi);
     }
@@ -6542,6 +6793,26 @@ void compiler_dumpstate(void)
 }
 #endif
 
+/* Name a translated block after its 68k address, and the MacsBug
+   symbol of the routine it belongs to, if any */
+static void perf_add_block(cpu_history* pc_hist, uae_u8* code, uae_u32 size)
+{
+	uae_u8* p=(uae_u8*)pc_hist[0].location;
+	uaecptr pc=start_pc+(p-start_pc_p);
+	uae_u8* end=NULL;
+	if (p>=RAMBaseHost && p<RAMBaseHost+RAMSize)
+		end=RAMBaseHost+RAMSize;
+	else if (p>=ROMBaseHost && p<ROMBaseHost+ROMSize)
+		end=ROMBaseHost+ROMSize;
+
+	char sym[64], name[96];
+	if (end && jit_perf_macsbug_name(p,end,sym,sizeof(sym)))
+		snprintf(name,sizeof(name),"m68k_%08x %s",pc,sym);
+	else
+		snprintf(name,sizeof(name),"m68k_%08x",pc);
+	jit_perf_add_code(code,size,name);
+}
+
 static void compile_block(cpu_history* pc_hist, int blocklen)
 {
     if (letit && compiled_code) {
@@ -6571,6 +6842,7 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 	blockinfo* bi=NULL;
 	blockinfo* bi2;
 	int extra_len=0;
+	jit_profile_block* pb=NULL;
 
 	redo_current_block=0;
 	if (current_compile_p>=max_compile_start)
@@ -6609,6 +6881,8 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 	remove_deps(bi); /* We are about to create new code */
 	bi->optlevel=optlev;
 	bi->pc_p=(uae_u8*)pc_hist[0].location;
+	if (jit_profile)
+	    pb=profile_block_compiled(pc_hist,blocklen);
 #if USE_CHECKSUM_INFO
 	free_checksum_info_chain(bi->csi);
 	bi->csi = NULL;
@@ -6693,6 +6967,8 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 	    raw_call((uintptr)cpu_do_check_ticks);
 	    *branchadd=(uintptr)get_target()-((uintptr)branchadd+1);
 #endif
+	    if (pb)
+		profile_emit_count(&pb->entries);
 
 #if JIT_DEBUG
 		if (JITDebug) {
@@ -6768,6 +7044,8 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 			// raw_cputbl_count[] is indexed with plain opcode (in m68k order)
 			raw_add_l_mi((uintptr)&raw_cputbl_count[cft_map(opcode)],1);
 #endif
+		    if (pb)
+			profile_emit_count(&profile_fallback_count[cft_map(opcode)]);
 #if USE_NORMAL_CALLING_CONVENTION
 		    raw_inc_sp(4);
 #endif
@@ -6990,6 +7268,8 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 	raw_jmp((uintptr)bi->direct_handler);
 
 	current_compile_p=get_target();
+	if (jit_perf_enabled)
+		perf_add_block(pc_hist,(uae_u8*)current_block_start_target,current_compile_p-(uae_u8*)current_block_start_target);
 	raise_in_cl_list(bi);
 	
 	/* We will flush soon, anyway, so let's do it now */
@@ -7022,6 +7302,7 @@ void exec_nostats(void)
 		m68k_record_step(m68k_getpc());
 #endif
 		(*cpufunctbl[opcode])(opcode);
+		profile_interpreted(opcode);
 		cpu_check_ticks();
 		if (end_block(opcode) || SPCFLAGS_TEST(SPCFLAG_ALL)) {
 			return; /* We will deal with the spcflags in the caller */
@@ -7048,6 +7329,7 @@ void execute_normal(void)
 			m68k_record_step(m68k_getpc());
 #endif
 			(*cpufunctbl[opcode])(opcode);
+			profile_interpreted(opcode);
 			cpu_check_ticks();
 			if (end_block(opcode) || SPCFLAGS_TEST(SPCFLAG_ALL) || blocklen>=MAXRUN) {
 				compile_block(pc_hist, blocklen);
@@ -7065,6 +7347,11 @@ static void m68k_do_compile_execute(void)
 {
 	for (;;) {
 		((compiled_handler)(pushall_call_handler))();
+		if (profile_dump_requested) {
+			profile_dump_requested = 0;
+			if (jit_profile)
+				compiler_dump_profile();
+		}
 		/* Whenever we return from that, we should check spcflags */
 		if (SPCFLAGS_TEST(SPCFLAG_ALL)) {
 			if (m68k_do_specialties ())
@@ -2029,6 +2029,7 @@ int main(void)
 	    GENIA("cmpnle", CMP, X86_SSE_CC_NLE);
 	    GENIA("cmpord", CMP, X86_SSE_CC_O);
 	    GEN1("movap", MOVAP);
+	    GEN1("movs", MOVS);
 	    GEN("movdqa", MOVDQA);
 	    GEN("movdqu", MOVDQU);
 	    GEN("movd", MOVDXD);
@@ -2174,6 +2175,7 @@ int main(void)
 			GENIA("cmpnle", CMP, X86_SSE_CC_NLE);
 			GENIA("cmpord", CMP, X86_SSE_CC_O);
 			GEN1("movap", MOVAP);
+			GEN1("movs", MOVS);
 			GEN("movdqa", MOVDQA);
 			GEN("movdqu", MOVDQU);
 #if 0
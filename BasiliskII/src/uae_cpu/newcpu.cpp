@@ -1362,6 +1362,9 @@ int m68k_do_specialties (void)
 	if (SPCFLAGS_TEST( SPCFLAG_INT )) {
 		SPCFLAGS_CLEAR( SPCFLAG_INT );
 		SPCFLAGS_SET( SPCFLAG_DOINT );
+#ifndef USE_CPU_EMUL_SERVICES
+		cpu_do_check_ticks();
+#endif
 	}
 	if (SPCFLAGS_TEST( SPCFLAG_BRK )) {
 		SPCFLAGS_CLEAR( SPCFLAG_BRK );
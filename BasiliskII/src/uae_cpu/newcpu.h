@@ -348,11 +348,9 @@ static inline void cpu_check_ticks(void)
 		cpu_do_check_ticks();
 }
 #else
-extern uint16 emulated_ticks;
+/* Ticks come from a host timer, which raises SPCFLAG_INT on its own */
 static inline void cpu_check_ticks(void)
 {
-	if (!++emulated_ticks)
-		cpu_do_check_ticks();
 }
 #endif
  
@@ -101,6 +101,14 @@ bool Init680x0(void)
 	memory_init();
 #endif
 
+#if PREDECODE_CACHE
+	UsePredecode = PrefsFindBool("predecode");
+#if USE_JIT
+	// The JIT compiler supersedes the predecoded interpreter
+	if (compiler_use_jit())
+		UsePredecode = false;
+#endif
+#endif
 	init_m68k();
 #if USE_JIT
 	UseJIT = compiler_use_jit();
@@ -1594,6 +1594,7 @@ struct cpuinfo_x86 {
 	uae_u8	x86_model;
 	uae_u8	x86_mask;
 	bool	x86_has_xmm2;
+	bool	x86_has_avx2;
 	int		cpuid_level;	// Maximum supported CPUID level, -1=no CPUID
 	char	x86_vendor_id[16];
 	uintptr	x86_clflush_size;
@@ -1738,6 +1739,20 @@ cpuid(uae_u32 op, uae_u32 *eax, uae_u32 *ebx, uae_u32 *ecx, uae_u32 *edx)
 	cpuid_count(op, 0, eax, ebx, ecx, edx);
 }
 
+/* Get the OS enabled state components, only valid if OSXSAVE is set */
+static uae_u32 xgetbv0(void)
+{
+#ifdef _MSC_VER
+	return (uae_u32)_xgetbv(0);
+#else
+	uae_u32 xcr0_lo, xcr0_hi;
+	__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" /* xgetbv */
+		: "=a" (xcr0_lo), "=d" (xcr0_hi)
+		: "c" (0));
+	return xcr0_lo;
+#endif
+}
+
 static void raw_init_cpu(void)
 {
 	struct cpuinfo_x86 *c = &cpuinfo;
@@ -1766,10 +1781,11 @@ static void raw_init_cpu(void)
 	x86_get_cpu_vendor(c);
 
 	/* Intel-defined flags: level 0x00000001 */
+	uae_u32 ext_hwcap = 0;
 	c->x86_brand_id = 0;
 	if ( c->cpuid_level >= 0x00000001 ) {
 		uae_u32 tfms, brand_id;
-		cpuid(0x00000001, &tfms, &brand_id, &dummy, &c->x86_hwcap);
+		cpuid(0x00000001, &tfms, &brand_id, &ext_hwcap, &c->x86_hwcap);
 		c->x86 = (tfms >> 8) & 15;
 		if (c->x86 == 0xf)
 			c->x86 += (tfms >> 20) & 0xff; /* extended family */
@@ -1860,6 +1876,15 @@ static void raw_init_cpu(void)
 
 	c->x86_has_xmm2 = (c->x86_hwcap & (1 << 26)) != 0;
 
+	/* AVX2 also needs the OS to save YMM registers (OSXSAVE, XCR0 bits 1-2) */
+	c->x86_has_avx2 = false;
+	if (c->cpuid_level >= 0x00000007 && (ext_hwcap & (1 << 27)) && (ext_hwcap & (1 << 28))) {
+		uae_u32 ext_features;
+		cpuid_count(0x00000007, 0, &dummy, &ext_features, &dummy, &dummy);
+		if ((ext_features & (1 << 5)) && (xgetbv0() & 6) == 6)
+			c->x86_has_avx2 = true;
+	}
+
 	/* Can the host CPU suffer from partial register stalls? */
 	// non-RAT_STALL mode is currently broken
 	have_rat_stall = true; //(c->x86_vendor == X86_VENDOR_INTEL);
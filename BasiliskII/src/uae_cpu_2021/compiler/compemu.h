@@ -58,6 +58,7 @@ extern void compiler_dumpstate(void);
 #define TAGMASK 0x0000ffff
 #define TAGSIZE (TAGMASK+1)
 #define MAXRUN 1024
+#define MAX_SIDE_EXITS 4 /* Conditional branches followed within one trace */
 #define cacheline(x) (((uintptr)x)&TAGMASK)
 
 extern uae_u8* start_pc_p;
@@ -103,6 +104,14 @@ union cacheline {
 /* Does flush_icache_range() only check for blocks falling in the requested range? */
 #define LAZY_FLUSH_ICACHE_RANGE 0
 
+/* Write-protect guest pages holding translated code so that lazy flushes
+   only check blocks from pages that were written to (requires checksum_info) */
+#if defined(UAE)
+#define USE_CODE_PAGE_PROTECTION 0
+#else
+#define USE_CODE_PAGE_PROTECTION USE_CHECKSUM_INFO
+#endif
+
 #define USE_F_ALIAS 1
 #define USE_OFFSET 1
 #define COMP_DEBUG 1
@@ -183,6 +192,9 @@ extern void (*flush_icache)(void);
 #endif
 extern void alloc_cache(void);
 extern int check_for_cache_miss(void);
+#if USE_CODE_PAGE_PROTECTION
+extern bool compiler_handle_write_fault(uintptr fault_address);
+#endif
 
 /* JIT FPU compilation */
 struct jit_disable_opcodes {
@@ -472,6 +484,7 @@ typedef struct blockinfo_t {
 #endif
     uae_u8* pc_p;
 
+    uae_u32 c0; /* First source word, cheap first check before checksumming */
     uae_u32 c1;
     uae_u32 c2;
 #if USE_CHECKSUM_INFO
@@ -491,8 +504,11 @@ typedef struct blockinfo_t {
     uae_u8 status;
     uae_u8 havestate;
 
-    dependency  dep[2];  /* Holds things we depend on */
+    dependency  dep[2+MAX_SIDE_EXITS];  /* Holds things we depend on */
     dependency* deplist; /* List of things that depend on this */
+
+    uae_u8* trace_exit_p; /* Most frequent exit of the closing Bcc */
+    uae_u8  trace_bias;   /* Confidence in trace_exit_p */
     smallstate  env;
 
 #ifdef JIT_DEBUG
@@ -515,7 +531,7 @@ void do_nothing(void);
 
 #else
 
-static inline void flush_icache(void) { }
+static inline void flush_icache(void) { flush_predecoded_blocks(); }
 
 #endif /* !USE_JIT */
 
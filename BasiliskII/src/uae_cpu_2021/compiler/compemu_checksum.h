@@ -0,0 +1,160 @@
+/*
+ * compiler/compemu_checksum.h - Block checksum kernels
+ *
+ * Basilisk II (C) 1997-2008 Christian Bauer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef COMPEMU_CHECKSUM_H
+#define COMPEMU_CHECKSUM_H
+
+/* A block checksum is the sum (c1) and the xor (c2) of the 32-bit words
+   covering the block source. Both are order independent, so the words
+   can be processed several at a time. The kernels below add to C1 and
+   xor to C2 the LEN bytes worth of words starting at POS, i.e. they
+   read (LEN + 3) / 4 words. */
+
+typedef void (*checksum_words_func)(const uae_u32 *pos, uae_s32 len, uae_u32 *c1, uae_u32 *c2);
+
+static void checksum_words_generic(const uae_u32 *pos, uae_s32 len, uae_u32 *c1, uae_u32 *c2)
+{
+	uae_u32 k1 = 0;
+	uae_u32 k2 = 0;
+
+	while (len > 0) {
+		k1 += *pos;
+		k2 ^= *pos;
+		pos++;
+		len -= 4;
+	}
+
+	*c1 += k1;
+	*c2 ^= k2;
+}
+
+#if defined(CPU_i386) || defined(CPU_x86_64)
+#define USE_CHECKSUM_SIMD 1
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#ifdef __GNUC__
+#define CHECKSUM_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CHECKSUM_TARGET(isa)
+#endif
+
+CHECKSUM_TARGET("sse2")
+static void checksum_words_sse2(const uae_u32 *pos, uae_s32 len, uae_u32 *c1, uae_u32 *c2)
+{
+	const int n = (len + 3) / 4;
+	__m128i s0 = _mm_setzero_si128(), s1 = _mm_setzero_si128();
+	__m128i x0 = _mm_setzero_si128(), x1 = _mm_setzero_si128();
+	int i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m128i v0 = _mm_loadu_si128((const __m128i *)(pos + i));
+		__m128i v1 = _mm_loadu_si128((const __m128i *)(pos + i + 4));
+		s0 = _mm_add_epi32(s0, v0);
+		s1 = _mm_add_epi32(s1, v1);
+		x0 = _mm_xor_si128(x0, v0);
+		x1 = _mm_xor_si128(x1, v1);
+	}
+	if (i + 4 <= n) {
+		__m128i v0 = _mm_loadu_si128((const __m128i *)(pos + i));
+		s0 = _mm_add_epi32(s0, v0);
+		x0 = _mm_xor_si128(x0, v0);
+		i += 4;
+	}
+
+	uae_u32 s[4], x[4];
+	_mm_storeu_si128((__m128i *)s, _mm_add_epi32(s0, s1));
+	_mm_storeu_si128((__m128i *)x, _mm_xor_si128(x0, x1));
+	uae_u32 k1 = s[0] + s[1] + s[2] + s[3];
+	uae_u32 k2 = x[0] ^ x[1] ^ x[2] ^ x[3];
+	for (; i < n; i++) {
+		k1 += pos[i];
+		k2 ^= pos[i];
+	}
+
+	*c1 += k1;
+	*c2 ^= k2;
+}
+
+CHECKSUM_TARGET("avx2")
+static void checksum_words_avx2(const uae_u32 *pos, uae_s32 len, uae_u32 *c1, uae_u32 *c2)
+{
+	const int n = (len + 3) / 4;
+	__m256i s0 = _mm256_setzero_si256(), s1 = _mm256_setzero_si256();
+	__m256i x0 = _mm256_setzero_si256(), x1 = _mm256_setzero_si256();
+	int i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m256i v0 = _mm256_loadu_si256((const __m256i *)(pos + i));
+		__m256i v1 = _mm256_loadu_si256((const __m256i *)(pos + i + 8));
+		s0 = _mm256_add_epi32(s0, v0);
+		s1 = _mm256_add_epi32(s1, v1);
+		x0 = _mm256_xor_si256(x0, v0);
+		x1 = _mm256_xor_si256(x1, v1);
+	}
+	if (i + 8 <= n) {
+		__m256i v0 = _mm256_loadu_si256((const __m256i *)(pos + i));
+		s0 = _mm256_add_epi32(s0, v0);
+		x0 = _mm256_xor_si256(x0, v0);
+		i += 8;
+	}
+	s0 = _mm256_add_epi32(s0, s1);
+	x0 = _mm256_xor_si256(x0, x1);
+
+	__m128i s = _mm_add_epi32(_mm256_castsi256_si128(s0), _mm256_extracti128_si256(s0, 1));
+	__m128i x = _mm_xor_si128(_mm256_castsi256_si128(x0), _mm256_extracti128_si256(x0, 1));
+	if (i + 4 <= n) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(pos + i));
+		s = _mm_add_epi32(s, v);
+		x = _mm_xor_si128(x, v);
+		i += 4;
+	}
+
+	uae_u32 sv[4], xv[4];
+	_mm_storeu_si128((__m128i *)sv, s);
+	_mm_storeu_si128((__m128i *)xv, x);
+	uae_u32 k1 = sv[0] + sv[1] + sv[2] + sv[3];
+	uae_u32 k2 = xv[0] ^ xv[1] ^ xv[2] ^ xv[3];
+	for (; i < n; i++) {
+		k1 += pos[i];
+		k2 ^= pos[i];
+	}
+
+	*c1 += k1;
+	*c2 ^= k2;
+}
+
+#undef CHECKSUM_TARGET
+#endif
+
+/* Return the fastest kernel the host supports */
+static inline checksum_words_func get_checksum_words_func(bool has_sse2, bool has_avx2)
+{
+#if USE_CHECKSUM_SIMD
+	if (has_avx2)
+		return checksum_words_avx2;
+	if (has_sse2)
+		return checksum_words_sse2;
+#endif
+	return checksum_words_generic;
+}
+
+#endif /* COMPEMU_CHECKSUM_H */
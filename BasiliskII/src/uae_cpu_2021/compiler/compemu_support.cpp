@@ -75,6 +75,7 @@
 #include "main.h"
 #include "prefs.h"
 #include "vm_alloc.h"
+#include "jit_perf.h"
 
 #include "m68k.h"
 #include "memory.h"
@@ -89,6 +90,7 @@
 #endif
 #else
 #include "compiler/compemu.h"
+#include "compiler/compemu_checksum.h"
 #include "fpu/fpu.h"
 #include "fpu/flags.h"
 // #include "parameters.h"
@@ -246,6 +248,8 @@ static int reg_count_compare(const void *ap, const void *bp)
 #ifdef PROFILE_COMPILE_TIME
 #include <time.h>
 static uae_u32 compile_count	= 0;
+static uae_u32 checksum_count	= 0;
+static uae_u32 checksum_skip_count = 0;
 static clock_t compile_time		= 0;
 static clock_t emul_start_time	= 0;
 static clock_t emul_end_time	= 0;
@@ -295,11 +299,18 @@ static bool follow_const_jumps = true; // Flag: translation through constant jum
 #else
 const bool follow_const_jumps = false;
 #endif
+#ifdef UAE
+const bool trace_branches = false;
+#else
+static bool trace_branches = true; // Flag: translation through biased conditional branches
+#endif
+const int TRACE_MIN_BIAS = 6; // Confidence needed before a Bcc is followed
 
 const uae_u32 MIN_CACHE_SIZE = 1024; // Minimal translation cache size (1 MB)
 static uae_u32 cache_size = 0; // Size of total cache allocated for compiled blocks
 static uae_u32		current_cache_size	= 0;		// Cache grows upwards: how much has been consumed already
 static bool		lazy_flush		= true;	// Flag: lazy translation cache invalidation
+static checksum_words_func checksum_words = checksum_words_generic; // Block checksum kernel
 // Flag: compile FPU instructions ?
 #ifdef UAE
 #ifdef USE_JIT_FPU
@@ -361,6 +372,11 @@ static inline bool is_const_jump(uae_u32 opcode)
 	return (prop[opcode].cflow == fl_const_jump);
 }
 
+static inline bool is_cond_branch(uae_u32 opcode)
+{
+	return ((prop[opcode].cflow & fl_end_block) == fl_branch);
+}
+
 #if 0
 static inline bool may_trap(uae_u32 opcode)
 {
@@ -445,6 +461,9 @@ extern const struct cputbl op_smalltbl_5_nf[];
 static void flush_icache_hard(void);
 static void flush_icache_lazy(void);
 static void flush_icache_none(void);
+#if USE_CODE_PAGE_PROTECTION
+static void flush_icache_protect(void);
+#endif
 void (*flush_icache)(void) = flush_icache_none;
 
 static bigstate live;
@@ -696,8 +715,10 @@ static inline void remove_dep(dependency* d)
    depends on anything else */
 static inline void remove_deps(blockinfo* bi)
 {
-	remove_dep(&(bi->dep[0]));
-	remove_dep(&(bi->dep[1]));
+	int i;
+
+	for (i=0;i<2+MAX_SIDE_EXITS;i++)
+		remove_dep(&(bi->dep[i]));
 }
 
 static inline void adjust_jmpdep(dependency* d, cpuop_func* a)
@@ -741,7 +762,9 @@ static inline void invalidate_block(blockinfo* bi)
 	set_dhtu(bi,bi->direct_pen);
 	bi->needed_flags=0xff;
 	bi->status=BI_INVALID;
-	for (i=0;i<2;i++) {
+	bi->trace_exit_p=NULL;
+	bi->trace_bias=0;
+	for (i=0;i<2+MAX_SIDE_EXITS;i++) {
 		bi->dep[i].jmp_off=NULL;
 		bi->dep[i].target=NULL;
 	}
@@ -2887,6 +2910,414 @@ struct scratch_t {
 
 static scratch_t scratch;
 
+/********************************************************************
+ * Write-protection of translated code pages                        *
+ ********************************************************************/
+
+#if USE_CODE_PAGE_PROTECTION
+/* Guest RAM pages holding translated code are write-protected. A lazy
+   flush then only needs to check the blocks from pages that got written
+   to since the previous flush. Pages that keep being written to mix
+   code and data, they are left writable and their blocks are always
+   checksummed, as without write-protection. */
+
+enum {
+	CODE_PAGE_NONE,			// No translated code
+	CODE_PAGE_PROTECTED,	// Write-protected, unchanged since last flush
+	CODE_PAGE_DIRTY,		// Written to since last flush
+	CODE_PAGE_MIXED			// Code and data, left writable
+};
+
+const int CODE_PAGE_MAX_WRITES = 8; // Writes before a page is considered mixed
+
+static bool protect_code_pages = false; // Flag: write-protect translated code pages
+static uae_u8 *code_pages_base = NULL;
+static uae_u32 code_pages_count = 0;
+static int code_page_bits = 0;
+static uae_u8 *code_page_state = NULL;
+static uae_u8 *code_page_writes = NULL;
+static volatile bool code_pages_dirty = false;
+
+#ifdef PROFILE_COMPILE_TIME
+static uae_u32 code_page_faults = 0;
+static uae_u32 flush_blocks_kept = 0;
+static uae_u32 flush_blocks_checked = 0;
+#endif
+
+static inline uae_u8 *code_page_addr(uae_u32 page)
+{
+	return code_pages_base + ((uintptr)page << code_page_bits);
+}
+
+static inline uae_u32 code_page_size(void)
+{
+	return 1 << code_page_bits;
+}
+
+static bool init_code_pages(void)
+{
+	const uae_u32 page_size = vm_get_page_size();
+	if ((page_size & (page_size - 1)) != 0 || ((uintptr)RAMBaseHost & (page_size - 1)) != 0)
+		return false;
+
+	code_page_bits = 0;
+	while ((1U << code_page_bits) < page_size)
+		code_page_bits++;
+	code_pages_base = RAMBaseHost;
+	code_pages_count = RAMSize >> code_page_bits;
+	code_page_state = (uae_u8 *)calloc(code_pages_count, 1);
+	code_page_writes = (uae_u8 *)calloc(code_pages_count, 1);
+	if (code_page_state == NULL || code_page_writes == NULL) {
+		free(code_page_state);
+		free(code_page_writes);
+		code_page_state = code_page_writes = NULL;
+		return false;
+	}
+	return true;
+}
+
+/* Make all pages writable again, e.g. once all blocks are gone */
+static void reset_code_pages(void)
+{
+	for (uae_u32 page = 0; page < code_pages_count; page++) {
+		if (code_page_state[page] != CODE_PAGE_NONE) {
+			/* Unprotect first, a concurrent write would not be ours otherwise */
+			vm_protect(code_page_addr(page), code_page_size(), VM_PAGE_READ | VM_PAGE_WRITE);
+			code_page_state[page] = CODE_PAGE_NONE;
+		}
+		code_page_writes[page] = 0;
+	}
+	code_pages_dirty = false;
+}
+
+static void exit_code_pages(void)
+{
+	if (code_page_state) {
+		reset_code_pages();
+		protect_code_pages = false;
+		free(code_page_state);
+		free(code_page_writes);
+		code_page_state = code_page_writes = NULL;
+	}
+}
+
+/* Get the range of pages covered by CSI, returns false if it is not all in RAM */
+static inline bool get_code_pages(const checksum_info *csi, uae_u32 *first, uae_u32 *last)
+{
+	if (csi->start_p < code_pages_base || csi->length == 0)
+		return false;
+	*first = (csi->start_p - code_pages_base) >> code_page_bits;
+	*last = (csi->start_p + csi->length - 1 - code_pages_base) >> code_page_bits;
+	return *last < code_pages_count;
+}
+
+static void protect_block_pages(blockinfo *bi)
+{
+	uae_u32 first, last;
+	for (checksum_info *csi = bi->csi; csi; csi = csi->next) {
+		if (!get_code_pages(csi, &first, &last))
+			continue;
+		for (uae_u32 page = first; page <= last; page++) {
+			if (code_page_state[page] == CODE_PAGE_NONE) {
+				code_page_state[page] = CODE_PAGE_PROTECTED;
+				vm_protect(code_page_addr(page), code_page_size(), VM_PAGE_READ);
+			}
+		}
+	}
+}
+
+/* Check whether BI source pages were not written to since last flush */
+static bool block_pages_protected(blockinfo *bi)
+{
+	uae_u32 first, last;
+	for (checksum_info *csi = bi->csi; csi; csi = csi->next) {
+		if (!get_code_pages(csi, &first, &last))
+			return false;
+		for (uae_u32 page = first; page <= last; page++) {
+			if (code_page_state[page] != CODE_PAGE_PROTECTED)
+				return false;
+		}
+	}
+	return bi->csi != NULL;
+}
+
+/* Write-protect again pages written to since last flush */
+static void protect_dirty_code_pages(void)
+{
+	if (!code_pages_dirty)
+		return;
+	code_pages_dirty = false;
+	for (uae_u32 page = 0; page < code_pages_count; page++) {
+		if (code_page_state[page] == CODE_PAGE_DIRTY) {
+			code_page_state[page] = CODE_PAGE_PROTECTED;
+			vm_protect(code_page_addr(page), code_page_size(), VM_PAGE_READ);
+		}
+	}
+}
+
+/* Called from the SIGSEGV handler, returns true if the fault was a write to translated code */
+bool compiler_handle_write_fault(uintptr fault_address)
+{
+	if (!protect_code_pages || fault_address < (uintptr)code_pages_base)
+		return false;
+	const uintptr page = (fault_address - (uintptr)code_pages_base) >> code_page_bits;
+	if (page >= code_pages_count || code_page_state[page] == CODE_PAGE_NONE)
+		return false;
+
+	if (code_page_state[page] == CODE_PAGE_PROTECTED) {
+		if (++code_page_writes[page] >= CODE_PAGE_MAX_WRITES)
+			code_page_state[page] = CODE_PAGE_MIXED;
+		else
+			code_page_state[page] = CODE_PAGE_DIRTY;
+		code_pages_dirty = true;
+#ifdef PROFILE_COMPILE_TIME
+		code_page_faults++;
+#endif
+	}
+	vm_protect(code_page_addr(page), code_page_size(), VM_PAGE_READ | VM_PAGE_WRITE);
+	return true;
+}
+#endif
+
+/********************************************************************
+ * Translation profiler                                             *
+ ********************************************************************/
+
+#ifndef UAE
+/* With the "jitprofile" pref, translated blocks count their own entries
+   and the instructions they leave to the interpreter, while
+   execute_normal() and exec_nostats() count the instructions they run.
+   Each entry of a block is credited to all of its instructions, even
+   when a side exit leaves it early. Per-opcode counts are indexed in
+   m68k order. */
+
+struct jit_profile_block {
+	uae_u8 *pc_p;
+	uae_u64 entries;			// Bumped by translated code, since last translation
+	uae_u32 compiles;
+	uae_u32 checksum_failures;
+	uae_u32 nops;
+	uae_u16 *ops;				// Opcodes of the last translation
+	jit_profile_block *next;	// Hash chain (and LazyBlockAllocator free list)
+};
+
+const int PROFILE_HASH_SIZE = 4096;
+const int PROFILE_TOP_OPCODES = 50;
+const int PROFILE_TOP_BLOCKS = 20;
+
+static bool jit_profile = false; // Flag: collect translation statistics
+static volatile sig_atomic_t profile_dump_requested = 0;
+static LazyBlockAllocator<jit_profile_block> ProfileBlockAllocator;
+static jit_profile_block *profile_blocks[PROFILE_HASH_SIZE];
+static uae_u64 profile_retired_count[65536];	// Entries of blocks translated again since
+static uae_u64 profile_fallback_count[65536];	// Bumped by translated code
+static uae_u64 profile_interp_count[65536];
+static uae_u32 profile_block_ends[65536];
+static uae_u32 profile_checksum_failures = 0;
+static uae_u32 profile_hard_flushes = 0;
+static uae_u32 profile_lazy_flushes = 0;
+static const uae_u64 *profile_sort_key;
+
+static inline uae_u32 profile_hash(uae_u8 *pc_p)
+{
+	return ((uintptr)pc_p >> 1) & (PROFILE_HASH_SIZE - 1);
+}
+
+static jit_profile_block *profile_find_block(uae_u8 *pc_p)
+{
+	jit_profile_block *pb = profile_blocks[profile_hash(pc_p)];
+	while (pb && pb->pc_p != pc_p)
+		pb = pb->next;
+	return pb;
+}
+
+/* Records a new translation of the block at pc_hist[0], the previous
+   translation's entries are moved over to its opcodes */
+static jit_profile_block *profile_block_compiled(cpu_history *pc_hist, int blocklen)
+{
+	uae_u8 *pc_p = (uae_u8 *)pc_hist[0].location;
+	jit_profile_block *pb = profile_find_block(pc_p);
+	if (!pb) {
+		pb = ProfileBlockAllocator.acquire();
+		memset(pb, 0, sizeof(*pb));
+		pb->pc_p = pc_p;
+		pb->next = profile_blocks[profile_hash(pc_p)];
+		profile_blocks[profile_hash(pc_p)] = pb;
+	}
+	for (uae_u32 i = 0; i < pb->nops; i++)
+		profile_retired_count[pb->ops[i]] += pb->entries;
+	pb->entries = 0;
+	pb->compiles++;
+
+	if (pb->nops != (uae_u32)blocklen) {
+		free(pb->ops);
+		pb->ops = (uae_u16 *)malloc(blocklen * sizeof(uae_u16));
+		pb->nops = pb->ops ? blocklen : 0;
+	}
+	for (uae_u32 i = 0; i < pb->nops; i++)
+		pb->ops[i] = do_get_mem_word(pc_hist[i].location);
+
+	uae_u32 last = do_get_mem_word(pc_hist[blocklen - 1].location);
+	if (end_block(cft_map(last)))
+		profile_block_ends[last]++;
+	return pb;
+}
+
+/* Emits a 64-bit increment of a counter, flags are clobbered */
+static void profile_emit_count(uae_u64 *counter)
+{
+	compemu_raw_add_l_mi((uintptr)counter, 1);
+	compemu_raw_jcc_b_oponly(NATIVE_CC_CC);
+	uae_u8 *branchadd = get_target();
+	skip_byte();
+	compemu_raw_add_l_mi((uintptr)counter + 4, 1);
+	*branchadd = get_target() - (branchadd + 1);
+}
+
+static inline void profile_interpreted(uae_u32 opcode)
+{
+	if (jit_profile)
+		profile_interp_count[cft_map(opcode)]++;
+}
+
+static void profile_checksum_failed(blockinfo *bi)
+{
+	jit_profile_block *pb = profile_find_block(bi->pc_p);
+	if (pb)
+		pb->checksum_failures++;
+	profile_checksum_failures++;
+}
+
+static int profile_opcode_compare(const void *e1, const void *e2)
+{
+	uae_u64 a = profile_sort_key[*(const uae_u16 *)e1];
+	uae_u64 b = profile_sort_key[*(const uae_u16 *)e2];
+	return a < b ? 1 : (a > b ? -1 : 0);
+}
+
+static int profile_block_compare(const void *e1, const void *e2)
+{
+	const jit_profile_block *a = *(const jit_profile_block * const *)e1;
+	const jit_profile_block *b = *(const jit_profile_block * const *)e2;
+	if (a->compiles != b->compiles)
+		return a->compiles < b->compiles ? 1 : -1;
+	if (a->checksum_failures != b->checksum_failures)
+		return a->checksum_failures < b->checksum_failures ? 1 : -1;
+	return 0;
+}
+
+static const char *profile_opcode_name(uae_u32 opcode)
+{
+	struct instr *dp = table68k + opcode;
+	struct mnemolookup *lookup;
+	for (lookup = lookuptab; lookup->mnemo != (instrmnem)dp->mnemo; lookup++)
+		;
+	return lookup->name;
+}
+
+/* Prints the statistics gathered so far, opcodes that miss translation most first */
+static void compiler_dump_profile(void)
+{
+	uae_u64 *compiled = (uae_u64 *)malloc(65536 * sizeof(uae_u64));
+	uae_u64 *missed = (uae_u64 *)malloc(65536 * sizeof(uae_u64));
+	uae_u16 *opcodes = (uae_u16 *)malloc(65536 * sizeof(uae_u16));
+	if (!compiled || !missed || !opcodes) {
+		free(compiled);
+		free(missed);
+		free(opcodes);
+		return;
+	}
+
+	uae_u32 nblocks = 0, recompiles = 0;
+	memcpy(compiled, profile_retired_count, 65536 * sizeof(uae_u64));
+	for (int h = 0; h < PROFILE_HASH_SIZE; h++) {
+		for (jit_profile_block *pb = profile_blocks[h]; pb; pb = pb->next) {
+			for (uae_u32 i = 0; i < pb->nops; i++)
+				compiled[pb->ops[i]] += pb->entries;
+			recompiles += pb->compiles - 1;
+			nblocks++;
+		}
+	}
+
+	uae_u64 total_compiled = 0, total_fallback = 0, total_interp = 0;
+	for (int i = 0; i < 65536; i++) {
+		opcodes[i] = i;
+		missed[i] = profile_fallback_count[i] + profile_interp_count[i];
+		total_compiled += compiled[i];
+		total_fallback += profile_fallback_count[i];
+		total_interp += profile_interp_count[i];
+	}
+	uae_u64 total = total_compiled + total_fallback + total_interp;
+
+	bug("### JIT profile\n");
+	bug("Instructions translated  : %llu (%.1f%%)\n", (unsigned long long)total_compiled, total ? 100.0*double(total_compiled)/double(total) : 0.0);
+	bug("Interpreted in blocks    : %llu (%.1f%%)\n", (unsigned long long)total_fallback, total ? 100.0*double(total_fallback)/double(total) : 0.0);
+	bug("Interpreted alone        : %llu (%.1f%%)\n", (unsigned long long)total_interp, total ? 100.0*double(total_interp)/double(total) : 0.0);
+	bug("Blocks translated        : %u (%u recompilations)\n", nblocks, recompiles);
+	bug("Block checksum failures  : %u\n", profile_checksum_failures);
+	bug("Translation cache flushes: %u hard, %u lazy\n", profile_hard_flushes, profile_lazy_flushes);
+
+	profile_sort_key = missed;
+	qsort(opcodes, 65536, sizeof(uae_u16), profile_opcode_compare);
+	bug("Rank Opc          Translated         In blocks            Alone   Ends Name\n");
+	for (int i = 0; i < PROFILE_TOP_OPCODES; i++) {
+		uae_u16 opcode = opcodes[i];
+		if (!missed[opcode])
+			break;
+		bug("%03d: %04x %16llu %16llu %16llu %6u %s\n", i, opcode,
+			(unsigned long long)compiled[opcode],
+			(unsigned long long)profile_fallback_count[opcode],
+			(unsigned long long)profile_interp_count[opcode],
+			profile_block_ends[opcode], profile_opcode_name(opcode));
+	}
+
+	/* Opcodes closing the most blocks */
+	for (int i = 0; i < 65536; i++) {
+		opcodes[i] = i;
+		missed[i] = profile_block_ends[i];
+	}
+	qsort(opcodes, 65536, sizeof(uae_u16), profile_opcode_compare);
+	bug("Rank Opc  Ends Name\n");
+	for (int i = 0; i < PROFILE_TOP_OPCODES / 5; i++) {
+		uae_u16 opcode = opcodes[i];
+		if (!profile_block_ends[opcode])
+			break;
+		bug("%03d: %04x %6u %s\n", i, opcode, profile_block_ends[opcode], profile_opcode_name(opcode));
+	}
+	profile_sort_key = NULL;
+	free(compiled);
+	free(missed);
+	free(opcodes);
+
+	/* Blocks translated most often */
+	jit_profile_block **blocks = (jit_profile_block **)malloc(nblocks * sizeof(jit_profile_block *));
+	if (blocks) {
+		uae_u32 n = 0;
+		for (int h = 0; h < PROFILE_HASH_SIZE; h++) {
+			for (jit_profile_block *pb = profile_blocks[h]; pb; pb = pb->next)
+				blocks[n++] = pb;
+		}
+		qsort(blocks, nblocks, sizeof(jit_profile_block *), profile_block_compare);
+		bug("Rank PC        Compiles Checksum failures Length\n");
+		for (uae_u32 i = 0; i < nblocks && i < (uae_u32)PROFILE_TOP_BLOCKS; i++) {
+			jit_profile_block *pb = blocks[i];
+			if (pb->compiles < 2)
+				break;
+			bug("%03d: %08x %8u %17u %6u\n", i, (uae_u32)((uintptr)pb->pc_p - MEMBaseDiff),
+				pb->compiles, pb->checksum_failures, pb->nops);
+		}
+		free(blocks);
+	}
+	fflush(stdout);
+}
+
+/* Called from a signal handler, the report is printed from the emulation thread */
+void compiler_request_profile_dump(void)
+{
+	profile_dump_requested = 1;
+}
+#endif
+
 /********************************************************************
  * Support functions exposed to newcpu                              *
  ********************************************************************/
@@ -2939,6 +3370,12 @@ void compiler_init(void)
 	lazy_flush = PrefsFindBool("jitlazyflush");
 	jit_log("<JIT compiler> : lazy translation cache invalidation : %s", str_on_off(lazy_flush));
 	flush_icache = lazy_flush ? flush_icache_lazy : flush_icache_hard;
+#if USE_CODE_PAGE_PROTECTION
+	protect_code_pages = lazy_flush && PrefsFindBool("jitprotect") && init_code_pages();
+	jit_log("<JIT compiler> : write-protect translated code pages : %s", str_on_off(protect_code_pages));
+	if (protect_code_pages)
+		flush_icache = flush_icache_protect;
+#endif
 
 	// Compiler features
 	jit_log("<JIT compiler> : register aliasing : %s", str_on_off(1));
@@ -2948,11 +3385,28 @@ void compiler_init(void)
 	follow_const_jumps = PrefsFindBool("jitinline");
 #endif
 	jit_log("<JIT compiler> : block inlining : %s", str_on_off(follow_const_jumps));
+#ifndef UAE
+	trace_branches = PrefsFindBool("jittrace");
+#endif
+	jit_log("<JIT compiler> : translation through conditional branches : %s", str_on_off(trace_branches));
+	jit_profile = PrefsFindBool("jitprofile");
+	jit_log("<JIT compiler> : translation profiler : %s", str_on_off(jit_profile));
+	jit_perf_init(PrefsFindString("jitperf"));
+	jit_log("<JIT compiler> : translated code info for perf : %s", str_on_off(jit_perf_enabled));
 	jit_log("<JIT compiler> : separate blockinfo allocation : %s", str_on_off(USE_SEPARATE_BIA));
 
 	// Build compiler tables
 	init_table68k ();
 	build_comp();
+
+	// Block checksum kernel, needs target CPU features from build_comp()
+	const char *checksum_kernel = "generic";
+#if defined(CPU_i386) || defined(CPU_x86_64)
+	checksum_words = get_checksum_words_func(cpuinfo.x86_has_xmm2, cpuinfo.x86_has_avx2);
+	if (checksum_words != checksum_words_generic)
+		checksum_kernel = cpuinfo.x86_has_avx2 ? "AVX2" : "SSE2";
+#endif
+	jit_log("<JIT compiler> : block checksum kernel : %s", checksum_kernel);
 #endif
 
 	initialized = true;
@@ -2995,6 +3449,12 @@ void compiler_exit(void)
 		vm_release(popallspace, POPALLSPACE_SIZE);
 		popallspace = 0;
 	}
+
+#if USE_CODE_PAGE_PROTECTION
+	// Make guest RAM writable again
+	exit_code_pages();
+#endif
+	jit_perf_exit();
 #endif
 
 #ifdef PROFILE_COMPILE_TIME
@@ -3003,6 +3463,11 @@ void compiler_exit(void)
 	uae_u32 emul_time = emul_end_time - emul_start_time;
 	jit_log("Total emulation time   : %.1f sec", double(emul_time)/double(CLOCKS_PER_SEC));
 	jit_log("Total compilation time : %.1f sec (%.1f%%)", double(compile_time)/double(CLOCKS_PER_SEC), 100.0*double(compile_time)/double(emul_time));
+	jit_log("Block checksum checks  : %d (%d rejected on first word)", checksum_count, checksum_skip_count);
+#if USE_CODE_PAGE_PROTECTION
+	jit_log("Writes to code pages   : %d", code_page_faults);
+	jit_log("Blocks on lazy flushes : %d kept, %d checked", flush_blocks_kept, flush_blocks_checked);
+#endif
 #endif
 
 #ifdef PROFILE_UNTRANSLATED_INSNS
@@ -3027,6 +3492,11 @@ void compiler_exit(void)
 	}
 #endif
 
+#ifndef UAE
+	if (jit_profile)
+		compiler_dump_profile();
+#endif
+
 #ifdef RECORD_REGISTER_USAGE
 	int reg_count_ids[16];
 	uint64 tot_reg_count = 0;
@@ -3767,14 +4237,8 @@ static void calc_checksum(blockinfo* bi, uae_u32* c1, uae_u32* c2)
 		tmp &= ~((uintptr)3);
 		pos = (uae_u32 *)tmp;
 
-		if (len >= 0 && len <= MAX_CHECKSUM_LEN) {
-			while (len > 0) {
-				k1 += *pos;
-				k2 ^= *pos;
-				pos++;
-				len -= 4;
-			}
-		}
+		if (len >= 0 && len <= MAX_CHECKSUM_LEN)
+			checksum_words(pos, len, &k1, &k2);
 
 #if USE_CHECKSUM_INFO
 		csi = csi->next;
@@ -3785,6 +4249,23 @@ static void calc_checksum(blockinfo* bi, uae_u32* c1, uae_u32* c2)
 	*c2 = k2;
 }
 
+/* First aligned word of the block source */
+static inline uae_u32 block_first_word(blockinfo* bi)
+{
+#if USE_CHECKSUM_INFO
+	uintptr tmp = (uintptr)bi->csi->start_p;
+#else
+	uintptr tmp = (uintptr)bi->min_pcp;
+#endif
+	return *(uae_u32 *)(tmp & ~((uintptr)3));
+}
+
+static inline void set_checksum(blockinfo* bi)
+{
+	calc_checksum(bi,&(bi->c1),&(bi->c2));
+	bi->c0=block_first_word(bi);
+}
+
 #if 0
 static void show_checksum(CSI_TYPE* csi)
 {
@@ -3870,8 +4351,22 @@ static inline int block_check_checksum(blockinfo* bi)
 	if (bi->status!=BI_NEED_CHECK)
 		return 1;  /* This block is in a checked state */
 
-	if (bi->c1 || bi->c2)
-		calc_checksum(bi,&c1,&c2);
+	if (bi->c1 || bi->c2) {
+		/* Code that got overwritten seldom starts the same way, so
+		   check the first word before going through the whole block */
+		if (block_first_word(bi)==bi->c0)
+			calc_checksum(bi,&c1,&c2);
+		else {
+			c1=~bi->c1;
+			c2=~bi->c2;
+#ifdef PROFILE_COMPILE_TIME
+			checksum_skip_count++;
+#endif
+		}
+#ifdef PROFILE_COMPILE_TIME
+		checksum_count++;
+#endif
+	}
 	else {
 		c1=c2=1;  /* Make sure it doesn't match */
 	}
@@ -3897,6 +4392,10 @@ static inline int block_check_checksum(blockinfo* bi)
 		/* This block actually changed. We need to invalidate it,
 		   and set it up to be recompiled */
 		jit_log2("discard %p/%p (%x %x/%x %x)",bi,bi->pc_p, c1,c2,bi->c1,bi->c2);
+#ifndef UAE
+		if (jit_profile)
+			profile_checksum_failed(bi);
+#endif
 		invalidate_block(bi);
 		raise_in_cl_list(bi);
 	}
@@ -3908,7 +4407,7 @@ static int called_check_checksum(blockinfo* bi)
 	int isgood=1;
 	int i;
 
-	for (i=0;i<2 && isgood;i++) {
+	for (i=0;i<2+MAX_SIDE_EXITS && isgood;i++) {
 		if (bi->dep[i].jmp_off) {
 			isgood=block_check_checksum(bi->dep[i].target);
 		}
@@ -4122,10 +4621,12 @@ static void prepare_block(blockinfo* bi)
 	current_compile_p=get_target();
 
 	bi->deplist=NULL;
-	for (i=0;i<2;i++) {
+	for (i=0;i<2+MAX_SIDE_EXITS;i++) {
 		bi->dep[i].prev_p=NULL;
 		bi->dep[i].next=NULL;
 	}
+	bi->trace_exit_p=NULL;
+	bi->trace_bias=0;
 	bi->env=default_ss;
 	bi->status=BI_INVALID;
 	bi->havestate=0;
@@ -4518,7 +5019,8 @@ void build_comp(void)
 
 static void flush_icache_none(void)
 {
-	/* Nothing to do.  */
+	/* The JIT is off, only the interpreter may have cached code */
+	flush_predecoded_blocks();
 }
 
 void flush_icache_hard(void)
@@ -4528,6 +5030,7 @@ void flush_icache_hard(void)
 #ifndef UAE
 	jit_log("JIT: Flush Icache_hard(%d/%x/%p), %u KB",
 		n,regs.pc,regs.pc_p,current_cache_size/1024);
+	profile_hard_flushes++;
 #endif
 	bi=active;
 	while(bi) {
@@ -4545,6 +5048,10 @@ void flush_icache_hard(void)
 	}
 
 	reset_lists();
+#if USE_CODE_PAGE_PROTECTION
+	if (protect_code_pages)
+		reset_code_pages();
+#endif
 	if (!compiled_code)
 		return;
 
@@ -4565,6 +5072,26 @@ void flush_icache_hard(void)
    we simply mark everything as "needs to be checked".
 */
 
+static inline void flush_block_lazy(blockinfo* bi)
+{
+	uae_u32 cl=cacheline(bi->pc_p);
+	if (bi->status==BI_INVALID ||
+		bi->status==BI_NEED_RECOMP) { 
+		if (bi==cache_tags[cl+1].bi)
+			cache_tags[cl].handler=(cpuop_func*)popall_execute_normal;
+		bi->handler_to_use=(cpuop_func*)popall_execute_normal;
+		set_dhtu(bi,bi->direct_pen);
+		bi->status=BI_INVALID;
+	}
+	else {
+		if (bi==cache_tags[cl+1].bi)
+			cache_tags[cl].handler=(cpuop_func*)popall_check_checksum;
+		bi->handler_to_use=(cpuop_func*)popall_check_checksum;
+		set_dhtu(bi,bi->direct_pcc);
+		bi->status=BI_NEED_CHECK;
+	}
+}
+
 static inline void flush_icache_lazy(void)
 {
 	blockinfo* bi;
@@ -4572,25 +5099,13 @@ static inline void flush_icache_lazy(void)
 
 	if (!active)
 		return;
+#ifndef UAE
+	profile_lazy_flushes++;
+#endif
 
 	bi=active;
 	while (bi) {
-		uae_u32 cl=cacheline(bi->pc_p);
-		if (bi->status==BI_INVALID ||
-			bi->status==BI_NEED_RECOMP) { 
-			if (bi==cache_tags[cl+1].bi)
-				cache_tags[cl].handler=(cpuop_func*)popall_execute_normal;
-			bi->handler_to_use=(cpuop_func*)popall_execute_normal;
-			set_dhtu(bi,bi->direct_pen);
-			bi->status=BI_INVALID;
-		}
-		else {
-			if (bi==cache_tags[cl+1].bi)
-				cache_tags[cl].handler=(cpuop_func*)popall_check_checksum;
-			bi->handler_to_use=(cpuop_func*)popall_check_checksum;
-			set_dhtu(bi,bi->direct_pcc);
-			bi->status=BI_NEED_CHECK;
-		}
+		flush_block_lazy(bi);
 		bi2=bi;
 		bi=bi->next;
 	}
@@ -4604,6 +5119,34 @@ static inline void flush_icache_lazy(void)
 	active=NULL;
 }
 
+#if USE_CODE_PAGE_PROTECTION
+/* Same as flush_icache_lazy() but blocks whose code pages were not
+   written to since the last flush are kept active */
+static void flush_icache_protect(void)
+{
+	blockinfo* bi=active;
+	profile_lazy_flushes++;
+	while (bi) {
+		blockinfo* next=bi->next;
+		if (bi->status==BI_ACTIVE && block_pages_protected(bi)) {
+#ifdef PROFILE_COMPILE_TIME
+			flush_blocks_kept++;
+#endif
+		}
+		else {
+			flush_block_lazy(bi);
+			remove_from_list(bi);
+			add_to_dormant(bi);
+#ifdef PROFILE_COMPILE_TIME
+			flush_blocks_checked++;
+#endif
+		}
+		bi=next;
+	}
+	protect_dirty_code_pages();
+}
+#endif
+
 
 #if 0
 static void flush_icache_range(uae_u32 start, uae_u32 length)
@@ -4762,6 +5305,28 @@ static void print_inst(void)
 #endif
 
 
+#ifndef UAE
+/* Name a translated block after its 68k address, and the MacsBug
+   symbol of the routine it belongs to, if any */
+static void perf_add_block(cpu_history* pc_hist, uae_u8* code, uae_u32 size)
+{
+	uae_u8* p=(uae_u8*)pc_hist[0].location;
+	uaecptr pc=start_pc+(p-start_pc_p);
+	uae_u8* end=NULL;
+	if (p>=RAMBaseHost && p<RAMBaseHost+RAMSize)
+		end=RAMBaseHost+RAMSize;
+	else if (p>=ROMBaseHost && p<ROMBaseHost+ROMSize)
+		end=ROMBaseHost+ROMSize;
+
+	char sym[64], name[96];
+	if (end && jit_perf_macsbug_name(p,end,sym,sizeof(sym)))
+		snprintf(name,sizeof(name),"m68k_%08x %s",pc,sym);
+	else
+		snprintf(name,sizeof(name),"m68k_%08x",pc);
+	jit_perf_add_code(code,size,name);
+}
+#endif
+
 #ifdef UAE
 void compile_block(cpu_history *pc_hist, int blocklen, int totcycles)
 {
@@ -4783,6 +5348,7 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 		int i;
 		int r;
 		int was_comp=0;
+		int side_exits=0;
 		uae_u8 liveflags[MAXRUN+1];
 #if USE_CHECKSUM_INFO
 		bool trace_in_rom = isinrom((uintptr)pc_hist[0].location) != 0;
@@ -4797,6 +5363,9 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 		blockinfo* bi=NULL;
 		blockinfo* bi2;
 		int extra_len=0;
+#ifndef UAE
+		jit_profile_block* pb=NULL;
+#endif
 
 		redo_current_block=0;
 		if (current_compile_p >= MAX_COMPILE_PTR)
@@ -4831,6 +5400,10 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 		remove_deps(bi); /* We are about to create new code */
 		bi->optlevel=optlev;
 		bi->pc_p=(uae_u8*)pc_hist[0].location;
+#ifndef UAE
+		if (jit_profile)
+			pb=profile_block_compiled(pc_hist,blocklen);
+#endif
 #if USE_CHECKSUM_INFO
 		free_checksum_info_chain(bi->csi);
 		bi->csi = NULL;
@@ -4841,10 +5414,14 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 		while (i--) {
 			uae_u16* currpcp=pc_hist[i].location;
 			uae_u32 op=DO_GET_OPCODE(currpcp);
+			/* A branch inside the trace may leave it through a side exit,
+			   which needs all the flags */
+			bool side_exit=(i<blocklen-1 && end_block(op));
+			uae_u8 live_after=side_exit ? FLAG_ALL : liveflags[i+1];
 
 #if USE_CHECKSUM_INFO
 			trace_in_rom = trace_in_rom && isinrom((uintptr)currpcp);
-			if (follow_const_jumps && is_const_jump(op)) {
+			if ((follow_const_jumps && is_const_jump(op)) || side_exit) {
 				checksum_info *csi = alloc_checksum_info();
 				csi->start_p = (uae_u8 *)min_pcp;
 				csi->length = max_pcp - min_pcp + LONGEST_68K_INST;
@@ -4867,8 +5444,8 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 			else
 #endif
 			{
-				liveflags[i] = ((liveflags[i+1] & (~prop[op].set_flags))|prop[op].use_flags);
-				if (prop[op].is_addx && (liveflags[i+1]&FLAG_Z)==0)
+				liveflags[i] = ((live_after & (~prop[op].set_flags))|prop[op].use_flags);
+				if (prop[op].is_addx && (live_after&FLAG_Z)==0)
 					liveflags[i]&= ~FLAG_Z;
 			}
 		}
@@ -4923,6 +5500,10 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 			raw_inc_sp(STACK_SHADOW_SPACE);
 			*branchadd=get_target()-(branchadd+1);
 #endif
+#ifndef UAE
+			if (pb)
+				profile_emit_count(&pb->entries);
+#endif
 
 #ifdef JIT_DEBUG
 			if (JITDebug) {
@@ -4998,6 +5579,55 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 
 					comptbl[opcode](opcode);
 					freescratch();
+					if (!failure && next_pc_p && i<blocklen-1 && end_block(opcode)) {
+						/* The trace follows this branch. Stay on it when
+						   the branch goes where it was recorded to go, and
+						   leave through a side exit otherwise */
+						uintptr followed=(uintptr)pc_hist[i+1].location;
+						uintptr t=taken_pc_p;
+						int cc=branch_cc^1;
+						uae_u32* branchadd;
+						uae_u32* tba;
+						bigstate tmp;
+						blockinfo* tbi;
+
+						if (followed==taken_pc_p) {
+							t=next_pc_p;
+							cc=branch_cc;
+						}
+
+						tmp=live;
+#if defined(USE_DATA_BUFFER)
+						data_check_end(32, 128); // just a pessimistic guess...
+#endif
+						compemu_raw_jcc_l_oponly(cc);
+						branchadd=(uae_u32*)get_target();
+						skip_long();
+
+						tbi=get_blockinfo_addr_new((void*)t,1);
+						match_states(tbi);
+#ifdef UAE
+						raw_sub_l_mi(uae_p32(&countdown),scaled_cycles(totcycles));
+						raw_jcc_l_oponly(NATIVE_CC_PL);
+#else
+						compemu_raw_cmp_l_mi8((uintptr)specflags,0);
+						compemu_raw_jcc_l_oponly(NATIVE_CC_EQ);
+#endif
+						tba=(uae_u32*)get_target();
+						emit_jmp_target(get_handler(t));
+						compemu_raw_mov_l_mi((uintptr)&regs.pc_p,t);
+						flush_reg_count();
+						compemu_raw_jmp((uintptr)popall_do_nothing);
+						create_jmpdep(bi,2+side_exits,tba,t);
+						side_exits++;
+
+						write_jmp_target(branchadd, (cpuop_func *)get_target());
+						live=tmp;
+						comp_pc_p=(uae_u8*)followed;
+						mov_l_ri(PC_P,followed);
+						next_pc_p=0;
+						taken_pc_p=0;
+					}
 					if (!(liveflags[i+1] & FLAG_CZNV)) {
 						/* We can forget about flags */
 						dont_care_flags();
@@ -5077,6 +5707,10 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 					// raw_cputbl_count[] is indexed with plain opcode (in m68k order)
 					compemu_raw_add_l_mi((uintptr)&raw_cputbl_count[cft_map(opcode)],1);
 #endif
+#ifndef UAE
+					if (pb)
+						profile_emit_count(&profile_fallback_count[cft_map(opcode)]);
+#endif
 #if USE_NORMAL_CALLING_CONVENTION
 					raw_inc_sp(4);
 #endif
@@ -5100,6 +5734,22 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 						*branchadd = get_target() - (branchadd + 1);
 					}
 				}
+
+				if (i<blocklen-1 && end_block(opcode)) {
+					/* Make sure control really went along the trace */
+					uintptr followed=(uintptr)pc_hist[i+1].location;
+
+					next_pc_p=0;
+					taken_pc_p=0;
+					if (failure || !isconst(PC_P) || live.state[PC_P].val!=followed) {
+						if (was_comp) {
+							flush(1);
+							was_comp=0;
+						}
+						compemu_raw_cmp_l_mi((uintptr)&regs.pc_p,followed);
+						compemu_raw_jnz((uintptr)popall_do_nothing);
+					}
+				}
 			}
 #if 1 /* This isn't completely kosher yet; It really needs to be
 		 be integrated into a general inter-block-dependency scheme */
@@ -5273,8 +5923,12 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 			add_to_dormant(bi);
 		}
 		else {
-			calc_checksum(bi,&(bi->c1),&(bi->c2));
+			set_checksum(bi);
 			add_to_active(bi);
+#if USE_CODE_PAGE_PROTECTION
+			if (protect_code_pages)
+				protect_block_pages(bi);
+#endif
 		}
 #else
 		if (next_pc_p+extra_len>=max_pcp &&
@@ -5293,7 +5947,7 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 								   flight! */
 		}
 		else {
-			calc_checksum(bi,&(bi->c1),&(bi->c2));
+			set_checksum(bi);
 			add_to_active(bi);
 		}
 #endif
@@ -5343,6 +5997,10 @@ static void compile_block(cpu_history* pc_hist, int blocklen)
 
 		flush_cpu_icache((void *)current_block_start_target, (void *)target);
 		current_compile_p=get_target();
+#ifndef UAE
+		if (jit_perf_enabled)
+			perf_add_block(pc_hist,(uae_u8*)current_block_start_target,current_compile_p-(uae_u8*)current_block_start_target);
+#endif
 		raise_in_cl_list(bi);
 #ifdef UAE
 		bi->nexthandler=current_compile_p;
@@ -5383,16 +6041,35 @@ void do_nothing(void)
 #ifdef UAE
     /* Different implementation in newcpu.cpp */
 #else
+/* Remember where the conditional branch closing a block usually goes,
+   so that execute_normal() can carry on recording through it */
+static inline void update_trace_profile(blockinfo* bi, uae_u8* exit_p)
+{
+	if (bi->trace_exit_p==exit_p) {
+		if (bi->trace_bias<255)
+			bi->trace_bias++;
+	}
+	else if (bi->trace_bias>0)
+		bi->trace_bias--;
+	else
+		bi->trace_exit_p=exit_p;
+}
+
 void exec_nostats(void)
 {
+	blockinfo* bi=get_blockinfo_addr(regs.pc_p);
+
 	for (;;)  { 
 		uae_u32 opcode = GET_OPCODE;
 #if FLIGHT_RECORDER
 		m68k_record_step(m68k_getpc(), cft_map(opcode));
 #endif
 		(*cpufunctbl[opcode])(opcode);
+		profile_interpreted(opcode);
 		cpu_check_ticks();
 		if (end_block(opcode) || SPCFLAGS_TEST(SPCFLAG_ALL)) {
+			if (bi && trace_branches && is_cond_branch(opcode))
+				update_trace_profile(bi,regs.pc_p);
 			return; /* We will deal with the spcflags in the caller */
 		}
 	}
@@ -5402,11 +6079,33 @@ void exec_nostats(void)
 #ifdef UAE
 /* FIXME: check differences against UAE execute_normal (newcpu.cpp) */
 #else
+/* Should recording go on through the conditional branch that just closed
+   the segment starting at seg_p? Only if the blocks run so far have shown
+   that it almost always goes where it just went, and that doesn't loop
+   back into the trace. */
+static bool follow_trace(cpu_history* pc_hist, int blocklen, uae_u32 opcode, uae_u8* seg_p, int side_exits)
+{
+	if (!trace_branches || side_exits>=MAX_SIDE_EXITS || !is_cond_branch(opcode))
+		return false;
+
+	blockinfo* bi=get_blockinfo_addr(seg_p);
+	if (!bi || bi->trace_exit_p!=regs.pc_p || bi->trace_bias<TRACE_MIN_BIAS)
+		return false;
+
+	for (int i=0;i<blocklen;i++) {
+		if ((uae_u8*)pc_hist[i].location==regs.pc_p)
+			return false;
+	}
+	return true;
+}
+
 void execute_normal(void)
 {
 	if (!check_for_cache_miss()) {
 		cpu_history pc_hist[MAXRUN];
 		int blocklen = 0;
+		int side_exits = 0;
+		uae_u8* seg_p = regs.pc_p; /* Start of the current trace segment */
 #if 0 && FIXED_ADDRESSING
 		start_pc_p = regs.pc_p;
 		start_pc = get_virtual_address(regs.pc_p);
@@ -5421,8 +6120,16 @@ void execute_normal(void)
 			m68k_record_step(m68k_getpc(), cft_map(opcode));
 #endif
 			(*cpufunctbl[opcode])(opcode);
+			profile_interpreted(opcode);
 			cpu_check_ticks();
 			if (end_block(opcode) || SPCFLAGS_TEST(SPCFLAG_ALL) || blocklen>=MAXRUN) {
+				if (end_block(opcode) && !SPCFLAGS_TEST(SPCFLAG_ALL) && blocklen<MAXRUN &&
+					follow_trace(pc_hist, blocklen, opcode, seg_p, side_exits)) {
+					/* Keep going along the usual direction of that branch */
+					side_exits++;
+					seg_p = regs.pc_p;
+					continue;
+				}
 				compile_block(pc_hist, blocklen);
 				return; /* We will deal with the spcflags in the caller */
 			}
@@ -5442,6 +6149,11 @@ void m68k_do_compile_execute(void)
 {
 	for (;;) {
 		((compiled_handler)(pushall_call_handler))();
+		if (profile_dump_requested) {
+			profile_dump_requested = 0;
+			if (jit_profile)
+				compiler_dump_profile();
+		}
 		/* Whenever we return from that, we should check spcflags */
 		if (SPCFLAGS_TEST(SPCFLAG_ALL)) {
 			if (m68k_do_specialties ())
@@ -0,0 +1,172 @@
+/*
+ * compiler/test_checksum.cpp - Block checksum revalidation benchmark
+ *
+ * Basilisk II (C) 1997-2008 Christian Bauer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Times what a lazy flush costs once translated blocks get revalidated:
+ * each of N blocks has its checksum computed again and compared. Usage:
+ *
+ *   test-checksum [N_BLOCKS [N_ROUNDS]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sysdeps.h"
+
+#if !defined(CPU_i386) && !defined(CPU_x86_64)
+#if defined(__x86_64__) || defined(_M_X64)
+#define CPU_x86_64
+#elif defined(__i386__) || defined(_M_IX86)
+#define CPU_i386
+#endif
+#endif
+
+#include "compemu_checksum.h"
+
+const int MAX_BLOCK_LEN = 2048;		// Same as MAX_CHECKSUM_LEN
+
+struct bench_block {
+	const uae_u8 *start_p;
+	uae_s32 length;
+	uae_u32 c0, c1, c2;
+};
+
+static void calc_checksum(checksum_words_func func, const bench_block *b, uae_u32 *c1, uae_u32 *c2)
+{
+	uintptr tmp = (uintptr)b->start_p;
+	uae_s32 len = b->length + (tmp & 3);
+	*c1 = *c2 = 0;
+	func((const uae_u32 *)(tmp & ~((uintptr)3)), len, c1, c2);
+}
+
+static inline uae_u32 first_word(const bench_block *b)
+{
+	return *(const uae_u32 *)((uintptr)b->start_p & ~((uintptr)3));
+}
+
+// Revalidate all blocks, return the number of unchanged ones
+static int revalidate(checksum_words_func func, const bench_block *blocks, int n_blocks, bool first_pass)
+{
+	int n_good = 0;
+	for (int i = 0; i < n_blocks; i++) {
+		const bench_block *b = &blocks[i];
+		if (first_pass && first_word(b) != b->c0)
+			continue;
+		uae_u32 c1, c2;
+		calc_checksum(func, b, &c1, &c2);
+		if (c1 == b->c1 && c2 == b->c2)
+			n_good++;
+	}
+	return n_good;
+}
+
+static double bench(const char *name, checksum_words_func func, const bench_block *blocks,
+					int n_blocks, int n_rounds, bool first_pass, int expected)
+{
+	bool ok = true;
+	clock_t start = clock();
+	for (int r = 0; r < n_rounds; r++)
+		ok &= revalidate(func, blocks, n_blocks, first_pass) == expected;
+	double elapsed = double(clock() - start) / double(CLOCKS_PER_SEC);
+	double ns_per_block = 1e9 * elapsed / (double(n_blocks) * n_rounds);
+	printf("  %-8s %-12s %8.1f ns/block %s\n", name, first_pass ? "first word" : "full",
+		   ns_per_block, ok ? "" : "MISMATCH");
+	return ok ? ns_per_block : -1.0;
+}
+
+int main(int argc, char *argv[])
+{
+	const int n_blocks = argc > 1 ? atoi(argv[1]) : 16384;
+	const int n_rounds = argc > 2 ? atoi(argv[2]) : 50;
+
+	// Typical blocks are short, a few get long through inlining
+	srand(1);
+	bench_block *blocks = new bench_block[n_blocks];
+	size_t code_size = 0;
+	for (int i = 0; i < n_blocks; i++) {
+		int len = (rand() % 8) == 0 ? 256 + rand() % (MAX_BLOCK_LEN - 256) : 8 + rand() % 120;
+		blocks[i].length = len & ~1;
+		code_size += blocks[i].length + 8;
+	}
+	uae_u8 *code = new uae_u8[code_size];
+	for (size_t i = 0; i < code_size; i++)
+		code[i] = rand();
+	uae_u8 *p = code;
+	for (int i = 0; i < n_blocks; i++) {
+		p += 2 * (rand() % 2);		// 68k code is only 16-bit aligned
+		blocks[i].start_p = p;
+		p += blocks[i].length;
+	}
+
+	struct {
+		const char *name;
+		checksum_words_func func;
+	} kernels[3];
+	int n_kernels = 0;
+	kernels[n_kernels].name = "generic";
+	kernels[n_kernels++].func = checksum_words_generic;
+#if USE_CHECKSUM_SIMD && defined(__GNUC__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2")) {
+		kernels[n_kernels].name = "SSE2";
+		kernels[n_kernels++].func = get_checksum_words_func(true, false);
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		kernels[n_kernels].name = "AVX2";
+		kernels[n_kernels++].func = get_checksum_words_func(true, true);
+	}
+#endif
+
+	for (int i = 0; i < n_blocks; i++) {
+		calc_checksum(checksum_words_generic, &blocks[i], &blocks[i].c1, &blocks[i].c2);
+		blocks[i].c0 = first_word(&blocks[i]);
+	}
+
+	printf("%d blocks, %d KB of code, %d rounds\n", n_blocks, int(code_size / 1024), n_rounds);
+	printf("Unchanged code:\n");
+	bool ok = true;
+	for (int k = 0; k < n_kernels; k++)
+		ok &= bench(kernels[k].name, kernels[k].func, blocks, n_blocks, n_rounds, true, n_blocks) >= 0;
+
+	// Overwrite a quarter of the blocks with other code
+	int n_changed = 0;
+	for (int i = 0; i < n_blocks; i += 4) {
+		uae_u8 *start_p = (uae_u8 *)blocks[i].start_p;
+		for (int j = 0; j < blocks[i].length; j++)
+			start_p[j] ^= 0x5a;
+	}
+	for (int i = 0; i < n_blocks; i++) {
+		uae_u32 c1, c2;
+		calc_checksum(checksum_words_generic, &blocks[i], &c1, &c2);
+		if (c1 != blocks[i].c1 || c2 != blocks[i].c2)
+			n_changed++;
+	}
+	printf("Changed code (%d blocks differ):\n", n_changed);
+	for (int k = 0; k < n_kernels; k++) {
+		ok &= bench(kernels[k].name, kernels[k].func, blocks, n_blocks, n_rounds, false, n_blocks - n_changed) >= 0;
+		ok &= bench(kernels[k].name, kernels[k].func, blocks, n_blocks, n_rounds, true, n_blocks - n_changed) >= 0;
+	}
+
+	delete[] code;
+	delete[] blocks;
+	return ok ? 0 : 1;
+}
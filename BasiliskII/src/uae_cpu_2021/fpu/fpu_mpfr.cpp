@@ -59,10 +59,18 @@ static mpfr_t fpu_constant_rom[num_fpu_constants];
 // maintained by mpfr
 static uae_u32 cur_exceptions;
 static uaecptr cur_instruction_address;
+// Source operand of fpuop_general, kept around to avoid an allocation
+// for every instruction
+static fpu_register scratch;
+// Precision whose exponent range is currently set in mpfr
+static int cur_format;
 
 static void
 set_format (int prec)
 {
+  if (prec == cur_format)
+    return;
+  cur_format = prec;
   // MPFR represents numbers as 0.m*2^e
   switch (prec)
     {
@@ -143,6 +151,7 @@ fpu_init (bool integral_68040)
   for (int i = 0; i < 8; i++)
     mpfr_init (fpu.registers[i].f);
   mpfr_init (fpu.result.f);
+  mpfr_init (scratch.f);
 
   // Initialize constant ROM
   for (int i = 0; i < num_fpu_constants; i++)
@@ -188,6 +197,7 @@ fpu_exit ()
   for (int i = 0; i < 8; i++)
     mpfr_clear (fpu.registers[i].f);
   mpfr_clear (fpu.result.f);
+  mpfr_clear (scratch.f);
   for (int i = 0; i < num_fpu_constants; i++)
     mpfr_clear (fpu_constant_rom[i]);
 }
@@ -597,7 +607,11 @@ static void
 set_fp_register (int reg, mpfr_t value, uae_u64 nan_bits, int nan_sign,
 		 int t, mpfr_rnd_t rnd, bool do_flags)
 {
-  mpfr_subnormalize (value, t, rnd);
+  // Only values in the lowest binades of the format can be subnormal,
+  // don't pay for the call with the others
+  if (mpfr_regular_p (value)
+      && mpfr_get_exp (value) < mpfr_get_emin () + mpfr_get_prec (value) - 1)
+    mpfr_subnormalize (value, t, rnd);
   mpfr_set (fpu.registers[reg].f, value, rnd);
   fpu.registers[reg].nan_bits = nan_bits;
   fpu.registers[reg].nan_sign = nan_sign;
@@ -1511,10 +1525,10 @@ fpuop_general (uae_u32 opcode, uae_u32 extra)
   mpfr_rnd_t rnd = get_cur_rnd ();
   int reg = (extra >> 7) & 7;
   int t = 0;
-  fpu_register value;
+  fpu_register &value = scratch;
   bool ret;
 
-  mpfr_init2 (value.f, prec);
+  mpfr_set_prec (value.f, prec);
   value.nan_bits = DEFAULT_NAN_BITS;
   value.nan_sign = 0;
 
@@ -1873,7 +1887,6 @@ fpuop_general (uae_u32 opcode, uae_u32 extra)
   update_exceptions ();
   ret = true;
  out:
-  mpfr_clear (value.f);
   return ret;
 }
 
@@ -2460,7 +2460,12 @@ static void generate_includes (FILE * f)
 
     fprintf (f, "#define SET_CFLG_ALWAYS(x) SET_CFLG(x)\n");
     fprintf (f, "#define SET_NFLG_ALWAYS(x) SET_NFLG(x)\n");
+    fprintf (f, "#define CPUFUNC_PD(x) x##_pd\n");
+    fprintf (f, "#ifdef PREDECODE_OPERANDS\n");
+    fprintf (f, "#define CPUFUNC_FF(x) CPUFUNC_PD(x)\n");
+    fprintf (f, "#else\n");
     fprintf (f, "#define CPUFUNC_FF(x) x##_ff\n");
+    fprintf (f, "#endif\n");
     fprintf (f, "#define CPUFUNC_NF(x) x##_nf\n");
     fprintf (f, "#define CPUFUNC(x) CPUFUNC_FF(x)\n");
 	
@@ -2623,6 +2628,7 @@ static void generate_one_opcode (int rp)
 
     fprintf (headerfile, "extern cpuop_func op_%x_%d_nf;\n", opcode, postfix);
     fprintf (headerfile, "extern cpuop_func op_%x_%d_ff;\n", opcode, postfix);
+    fprintf (headerfile, "extern cpuop_func op_%x_%d_pd;\n", opcode, postfix);
     
     printf ("/* %s */\n", outopcode (name, opcode));
     printf ("void REGPARAM2 CPUFUNC(op_%x_%d)(uae_u32 opcode) /* %s */\n{\n", opcode, postfix, name);
@@ -2820,7 +2826,13 @@ static void generate_functbl (void)
 	}
 	
 	fprintf(functblfile, "\n");
+	fprintf(functblfile, "#ifdef NOFLAGS\n");
+	fprintf(functblfile, "cpuop_func *cpufunctbl_nf[65536] = {\n");
+	fprintf(functblfile, "#elif defined(PREDECODE_OPERANDS)\n");
+	fprintf(functblfile, "cpuop_func *cpufunctbl_pd[65536] = {\n");
+	fprintf(functblfile, "#else\n");
 	fprintf(functblfile, "cpuop_func *cpufunctbl[65536] = {\n");
+	fprintf(functblfile, "#endif\n");
 	fprintf(functblfile, "#if !defined(HAVE_GET_WORD_UNSWAPPED) || defined(FULLMMU)\n");
 	for (opcode = 0; opcode < 65536; opcode++)
 	{
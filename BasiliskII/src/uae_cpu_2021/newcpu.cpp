@@ -217,6 +217,374 @@ void REGPARAM2 op_illg_1 (uae_u32 opcode)
 }
 
 
+#if PREDECODE_CACHE
+/*
+ *  Predecoded interpreter
+ *
+ *  A block is recorded the first time it is interpreted, until control
+ *  does not fall through to the next instruction. It is later replayed
+ *  for as long as execution keeps falling through its instructions, so
+ *  conditional branches may exit a block early. Blocks are only dropped
+ *  by flush_icache(), so code must be flushed after it was modified, as
+ *  on a real 68040.
+ *
+ *  With PREDECODE_WORDS, the words of each block are also copied in host
+ *  byte order when it is recorded. All instructions of a block but the
+ *  last one then run the handlers of cpufunctbl_pd, which read their
+ *  immediates, displacements and addresses from that copy. The last
+ *  instruction may extend into the next page, it keeps its usual handler.
+ */
+
+bool UsePredecode = false;
+
+struct predecode_info {
+	cpuop_func *handler;
+	uae_u8 *pc_p;				// Host address of the instruction
+	uaecptr pc;					// Instruction address
+	uae_u16 opcode;				// Opcode as passed to the handler
+	bool flags_valid;			// All flags are up to date after this instruction
+};
+
+struct predecoded_block {
+	uaecptr pc;					// Block start address
+	predecoded_block *next;		// Next block in the hash chain
+	predecoded_block *succ[2];	// Last blocks executed after this one
+	predecode_info *di;			// Predecoded instructions
+	int size;					// Number of instructions
+#if PREDECODE_WORDS
+	uintptr words_offset;		// Offset from the block code to its words
+#endif
+};
+
+const int PREDECODE_MAX_ENTRIES = 65536;
+const int PREDECODE_MAX_BLOCKS = 16384;
+const int PREDECODE_MAX_BLOCK_LEN = 256;
+const int PREDECODE_HASH_SIZE = 16384;
+const uaecptr PREDECODE_PAGE_MASK = ~(uaecptr)0xfff;	// Blocks don't cross 4 KB pages
+
+static predecode_info *predecode_cache = NULL;
+static predecode_info *predecode_cache_p;
+static predecoded_block *predecode_blocks = NULL;
+static int predecode_block_count;
+static predecoded_block *predecode_hash[PREDECODE_HASH_SIZE];
+static const predecode_info *predecode_exec_end;	// End of the block being replayed
+static uae_u32 predecode_flush_count = 0;
+
+#if PREDECODE_WORDS
+const int PREDECODE_MAX_WORDS = 262144;
+const int PREDECODE_PAGE_WORDS = 2048;
+
+static uae_u16 *predecode_words = NULL;
+static uae_u16 *predecode_words_p;
+uintptr predecode_words_offset;		// Of the block being replayed
+#endif
+
+#if PREDECODE_NOFLAGS
+/*
+ *  Flag liveness
+ *
+ *  Within a block, an instruction whose flags are all set again by a
+ *  later instruction before being tested runs its flagless handler.
+ *  Flags are live when leaving the block, and before any instruction
+ *  that may branch, trap or look at the SR. Interrupts and other special
+ *  conditions are only handled where no flag is pending, so the SR is
+ *  always exact when it is pushed.
+ */
+
+const int PREDECODE_FLAGS_ALL = 0x1f;	// XNZVC, as in table68k
+
+struct predecode_flags {
+	uae_u8 set;					// Flags overwritten by the instruction
+	uae_u8 use;					// Flags read by the instruction
+};
+
+static predecode_flags *predecode_flag_info = NULL;
+
+static bool predecode_needs_flags(const struct instr *insn)
+{
+	if (insn->cflow != fl_normal || insn->plev != 0)
+		return true;
+	if (insn->flagdead == -1 || insn->flaglive == -1)
+		return true;
+	switch (insn->mnemo) {
+	case i_ILLG:
+	case i_ORSR: case i_ANDSR: case i_EORSR: case i_MVSR2: case i_MV2SR:
+	case i_DIVU: case i_DIVS: case i_DIVL: case i_CHK: case i_CHK2:
+	case i_TRAPV: case i_TRAPcc: case i_BKPT: case i_CAS: case i_CAS2:
+	case i_FPP: case i_FDBcc: case i_FScc: case i_FTRAPcc: case i_FBcc:
+	case i_FSAVE: case i_FRESTORE: case i_MMUOP:
+	case i_EMULOP_RETURN: case i_EMULOP: case i_NATFEAT_ID: case i_NATFEAT_CALL:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool init_predecode_flags(void)
+{
+	predecode_flag_info = (predecode_flags *)malloc(65536 * sizeof(predecode_flags));
+	if (predecode_flag_info == NULL)
+		return false;
+
+	const bool own_table68k = (table68k == NULL);
+	if (own_table68k)
+		init_table68k();
+	for (int opcode = 0; opcode < 65536; opcode++) {
+		const struct instr *insn = &table68k[cft_map(opcode)];
+		predecode_flags *fi = &predecode_flag_info[opcode];
+		if (predecode_needs_flags(insn)) {
+			fi->set = 0;
+			fi->use = PREDECODE_FLAGS_ALL;
+		} else {
+			fi->set = insn->flagdead & PREDECODE_FLAGS_ALL;
+			fi->use = insn->flaglive & PREDECODE_FLAGS_ALL;
+		}
+	}
+	if (own_table68k)
+		exit_table68k();
+	return true;
+}
+
+static void exit_predecode_flags(void)
+{
+	free(predecode_flag_info);
+	predecode_flag_info = NULL;
+}
+
+static void predecode_optimize_flags(predecode_info *start, predecode_info *end)
+{
+	int live = PREDECODE_FLAGS_ALL;
+	for (predecode_info *di = end; di-- != start; ) {
+		const predecode_flags *fi = &predecode_flag_info[di->opcode];
+		if (fi->set != 0 && (fi->set & live) == 0)
+			di->handler = cpufunctbl_nf[di->opcode];
+		live = (live & ~fi->set) | fi->use;
+	}
+
+	int pending = 0;
+	for (predecode_info *di = start; di != end; di++) {
+		const predecode_flags *fi = &predecode_flag_info[di->opcode];
+		if (fi->set != 0 && di->handler == cpufunctbl_nf[di->opcode])
+			pending |= fi->set;
+		else
+			pending &= ~fi->set;
+		di->flags_valid = (pending == 0);
+	}
+}
+#endif
+
+static void init_predecode(void)
+{
+	predecode_cache = (predecode_info *)malloc(PREDECODE_MAX_ENTRIES * sizeof(predecode_info));
+	predecode_blocks = (predecoded_block *)malloc(PREDECODE_MAX_BLOCKS * sizeof(predecoded_block));
+	if (predecode_cache == NULL || predecode_blocks == NULL) {
+		UsePredecode = false;
+		return;
+	}
+#if PREDECODE_WORDS
+	predecode_words = (uae_u16 *)malloc(PREDECODE_MAX_WORDS * sizeof(uae_u16));
+	if (predecode_words == NULL) {
+		UsePredecode = false;
+		return;
+	}
+#endif
+#if PREDECODE_NOFLAGS
+	if (!init_predecode_flags()) {
+		UsePredecode = false;
+		return;
+	}
+#endif
+	flush_predecoded_blocks();
+}
+
+static void exit_predecode(void)
+{
+#if PREDECODE_NOFLAGS
+	exit_predecode_flags();
+#endif
+	free(predecode_cache);
+	predecode_cache = NULL;
+	free(predecode_blocks);
+	predecode_blocks = NULL;
+#if PREDECODE_WORDS
+	free(predecode_words);
+	predecode_words = NULL;
+#endif
+}
+
+void flush_predecoded_blocks(void)
+{
+	if (predecode_cache == NULL)
+		return;
+
+	D(bug("Flushing %d predecoded blocks\n", predecode_block_count));
+	memset(predecode_hash, 0, sizeof(predecode_hash));
+	predecode_cache_p = predecode_cache;
+	predecode_block_count = 0;
+#if PREDECODE_WORDS
+	predecode_words_p = predecode_words;
+#endif
+	predecode_flush_count++;
+
+	// Stop replaying the current block, its code may have changed
+	predecode_exec_end = predecode_cache;
+}
+
+static inline int predecode_hash_index(uaecptr pc)
+{
+	return (pc >> 1) & (PREDECODE_HASH_SIZE - 1);
+}
+
+static inline predecoded_block *find_predecoded_block(uaecptr pc)
+{
+	for (predecoded_block *bi = predecode_hash[predecode_hash_index(pc)]; bi != NULL; bi = bi->next) {
+		if (bi->pc == pc)
+			return bi;
+	}
+	return NULL;
+}
+
+// Find the block at PC, trying the blocks that followed BI last time first
+static inline predecoded_block *find_next_predecoded_block(predecoded_block *bi, uaecptr pc)
+{
+	if (bi->succ[0] != NULL && bi->succ[0]->pc == pc)
+		return bi->succ[0];
+	if (bi->succ[1] != NULL && bi->succ[1]->pc == pc)
+		return bi->succ[1];
+	predecoded_block *next_bi = find_predecoded_block(pc);
+	if (next_bi != NULL) {
+		bi->succ[1] = bi->succ[0];
+		bi->succ[0] = next_bi;
+	}
+	return next_bi;
+}
+
+// Interpret a new block at the current PC, recording it into the cache
+static predecoded_block *predecode_block(void)
+{
+	if (predecode_block_count == PREDECODE_MAX_BLOCKS ||
+		predecode_cache_p + PREDECODE_MAX_BLOCK_LEN > predecode_cache + PREDECODE_MAX_ENTRIES)
+		flush_predecoded_blocks();
+#if PREDECODE_WORDS
+	else if (predecode_words_p + PREDECODE_PAGE_WORDS > predecode_words + PREDECODE_MAX_WORDS)
+		flush_predecoded_blocks();
+#endif
+
+	const uae_u32 flush_count = predecode_flush_count;
+	const uaecptr start_pc = m68k_getpc();
+	predecode_info *di = predecode_cache_p;
+	regs.fault_pc = start_pc;
+	for (;;) {
+		uae_u32 opcode = GET_OPCODE;
+		di->handler = cpufunctbl[opcode];
+		di->pc_p = regs.pc_p;
+		di->pc = regs.fault_pc;
+		di->opcode = opcode;
+		di->flags_valid = true;
+		di++;
+		(*cpufunctbl[opcode])(opcode);
+		cpu_check_ticks();
+		if (SPCFLAGS_TEST(SPCFLAG_ALL_BUT_EXEC_RETURN) || di - predecode_cache_p >= PREDECODE_MAX_BLOCK_LEN)
+			break;
+
+		// Anything but a fall through into the same page ends the block
+		const uaecptr pc = m68k_getpc();
+		if (pc <= regs.fault_pc || ((pc ^ start_pc) & PREDECODE_PAGE_MASK) != 0)
+			break;
+		regs.fault_pc = pc;
+	}
+
+	// Drop the block if the cache was flushed while it was recorded
+	if (predecode_flush_count != flush_count)
+		return NULL;
+
+	predecoded_block *bi = &predecode_blocks[predecode_block_count++];
+	bi->pc = start_pc;
+	bi->succ[0] = bi->succ[1] = NULL;
+	bi->di = predecode_cache_p;
+	bi->size = di - predecode_cache_p;
+#if PREDECODE_WORDS
+	// The block falls through all instructions but the last one, so they
+	// lie between its start and the last instruction, in a single page
+	const predecode_info *last = di - 1;
+	bi->words_offset = (uintptr)predecode_words_p - (uintptr)bi->di->pc_p;
+	for (const uae_u8 *p = bi->di->pc_p; p < last->pc_p; p += 2)
+		*predecode_words_p++ = do_get_mem_word((uae_u16 *)p);
+	for (predecode_info *dj = bi->di; dj != last; dj++)
+		dj->handler = cpufunctbl_pd[dj->opcode];
+#endif
+#if PREDECODE_NOFLAGS
+	predecode_optimize_flags(bi->di, di);
+#endif
+	predecoded_block ** const head = &predecode_hash[predecode_hash_index(start_pc)];
+	bi->next = *head;
+	*head = bi;
+	predecode_cache_p = di;
+	return bi;
+}
+
+// Replay a block while execution falls through its instructions
+static inline void execute_predecoded_block(const predecoded_block *bi)
+{
+	const predecode_info *di = bi->di;
+	predecode_exec_end = di + bi->size;
+#if PREDECODE_WORDS
+	predecode_words_offset = bi->words_offset;
+#endif
+	for (;;) {
+		regs.fault_pc = di->pc;
+		(*di->handler)(di->opcode);
+		cpu_check_ticks();
+		if (SPCFLAGS_TEST(SPCFLAG_ALL_BUT_EXEC_RETURN) && di->flags_valid)
+			break;
+		if (++di >= predecode_exec_end || regs.pc_p != di->pc_p)
+			break;
+	}
+}
+
+static void m68k_do_execute_predecoded(void)
+{
+	predecoded_block *bi = NULL;
+	uae_u32 flush_count = predecode_flush_count;
+	for (;;) {
+		// Blocks are reused after a flush, forget the previous one
+		if (predecode_flush_count != flush_count) {
+			flush_count = predecode_flush_count;
+			bi = NULL;
+		}
+
+		const uaecptr pc = m68k_getpc();
+#if PREDECODE_NOFLAGS
+		// Traced instructions must all leave exact flags
+		if (SPCFLAGS_TEST(SPCFLAG_TRACE | SPCFLAG_DOTRACE)) {
+			regs.fault_pc = pc;
+			uae_u32 opcode = GET_OPCODE;
+			(*cpufunctbl[opcode])(opcode);
+			cpu_check_ticks();
+			bi = NULL;
+		} else
+#endif
+		{
+			bi = (bi != NULL) ? find_next_predecoded_block(bi, pc) : find_predecoded_block(pc);
+			if (bi != NULL)
+				execute_predecoded_block(bi);
+			else
+				bi = predecode_block();
+		}
+		regs.fault_pc = m68k_getpc();
+
+		if (SPCFLAGS_TEST(SPCFLAG_ALL_BUT_EXEC_RETURN)) {
+			if (m68k_do_specialties())
+				return;
+		}
+	}
+}
+#else
+void flush_predecoded_blocks(void)
+{
+}
+#endif
+
 void init_m68k (void)
 {
     int i;
@@ -231,11 +599,18 @@ void init_m68k (void)
 	movem_next[i] = i & (~(1 << j));
     }
     fpu_init (CPUType == 4);
+#if PREDECODE_CACHE
+    if (UsePredecode)
+	init_predecode ();
+#endif
 }
 
 void exit_m68k (void)
 {
 	fpu_exit ();
+#if PREDECODE_CACHE
+	exit_predecode ();
+#endif
 }
 
 struct regstruct regs;
@@ -691,6 +1066,9 @@ int m68k_move2c (int regno, uae_u32 *regp)
 		 if (*regp & 0x08) {	/* Just to be on the safe side */
 			flush_icache();
 		 }
+#else
+		 if (*regp & 0x08)
+			flush_predecoded_blocks();
 #endif
 		 break;
 	 case 3: mmu_set_tc(*regp & 0xc000); break;
@@ -998,7 +1376,7 @@ void m68k_mull (uae_u32 /*opcode*/, uae_u32 src, uae_u16 extra)
 // If value is greater than zero, this means we are still processing an EmulOp
 // because the counter is incremented only in m68k_execute(), i.e. interpretive
 // execution only
-#ifdef USE_JIT
+#if defined(USE_JIT) || PREDECODE_CACHE
 static int m68k_execute_depth = 0;
 #endif
 
@@ -1492,6 +1870,9 @@ int m68k_do_specialties(void)
 	if (SPCFLAGS_TEST( SPCFLAG_INT )) {
 		SPCFLAGS_CLEAR( SPCFLAG_INT );
 		SPCFLAGS_SET( SPCFLAG_DOINT );
+#ifndef USE_CPU_EMUL_SERVICES
+		cpu_do_check_ticks();
+#endif
 	}
 
 	if (SPCFLAGS_TEST( SPCFLAG_BRK /*| SPCFLAG_MODE_CHANGE*/ )) {
@@ -1506,6 +1887,14 @@ void m68k_do_execute (void)
 {
     uae_u32 pc;
     uae_u32 opcode;
+#if PREDECODE_CACHE
+    // Nested executions from EmulOps run code pushed on the stack, which
+    // is not flushed when it changes. Only cache the toplevel execution.
+    if (UsePredecode && m68k_execute_depth == 1) {
+	m68k_do_execute_predecoded();
+	return;
+    }
+#endif
     for (;;) {
 	regs.fault_pc = pc = m68k_getpc();
 #ifdef FULL_HISTORY
@@ -1549,7 +1938,7 @@ void m68k_do_execute (void)
 
 void m68k_execute (void)
 {
-#ifdef USE_JIT
+#if defined(USE_JIT) || PREDECODE_CACHE
     m68k_execute_depth++;
 #endif
 #ifdef DEBUGGER
@@ -1584,7 +1973,7 @@ setjmpagain:
     	goto setjmpagain;
     }
 
-#ifdef USE_JIT
+#if defined(USE_JIT) || PREDECODE_CACHE
     m68k_execute_depth--;
 #endif
 }
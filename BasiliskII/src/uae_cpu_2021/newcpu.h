@@ -41,6 +41,48 @@
 
 # include <csetjmp>
 
+/* Predecoded interpreter: blocks are recorded once as arrays of
+   {handler, opcode} pairs, then replayed without fetching and decoding
+   each opcode again. */
+#ifndef PREDECODE_CACHE
+#if defined(FULLMMU) || defined(ARAM_PAGE_CHECK) || defined(FULL_HISTORY) || defined(FLIGHT_RECORDER)
+#define PREDECODE_CACHE 0
+#else
+#define PREDECODE_CACHE 1
+#endif
+#endif
+
+/* Predecoded blocks also keep a copy of their instruction words in host
+   byte order. The handlers of cpufunctbl_pd, compiled with
+   PREDECODE_OPERANDS, read their extension words from that copy. Builds
+   that link them in define PREDECODE_FUNCTBL. */
+#if PREDECODE_CACHE && defined(PREDECODE_FUNCTBL)
+#define PREDECODE_WORDS 1
+#else
+#define PREDECODE_WORDS 0
+#endif
+
+/* Predecoded blocks run the flagless handlers of cpufunctbl_nf where the
+   flags an instruction sets are overwritten before being used. The table
+   is compiled from cpufunctbl.cpp with NOFLAGS, builds that link it in
+   define NOFLAGS_FUNCTBL. */
+#if PREDECODE_CACHE && defined(NOFLAGS_FUNCTBL)
+#define PREDECODE_NOFLAGS 1
+#else
+#define PREDECODE_NOFLAGS 0
+#endif
+
+/* Flags are live at the end of a block, so its last instruction never
+   runs a flagless handler. Without the JIT, these handlers only serve
+   predecoded blocks and read the predecoded words as well. */
+#if defined(NOFLAGS) && !defined(USE_JIT) && PREDECODE_NOFLAGS && PREDECODE_WORDS
+#define PREDECODE_OPERANDS
+#endif
+
+#if defined(PREDECODE_OPERANDS) && !PREDECODE_CACHE
+#error "PREDECODE_OPERANDS handlers need the predecoded interpreter"
+#endif
+
 extern struct fixup {
     int flag;
     uae_u32 reg;
@@ -78,6 +120,12 @@ struct cputbl {
 };
 
 extern cpuop_func *cpufunctbl[65536];
+#if PREDECODE_WORDS
+extern cpuop_func *cpufunctbl_pd[65536];
+#endif
+#if PREDECODE_NOFLAGS
+extern cpuop_func *cpufunctbl_nf[65536];
+#endif
 
 #ifdef USE_JIT
 typedef void compop_func (uae_u32) REGPARAM;
@@ -118,6 +166,14 @@ static ALWAYS_INLINE uae_u32 get_ilong(uae_u32 o)
 	return mmu_get_long(addr, 0, sz_long);
 }
 
+#elif defined(PREDECODE_OPERANDS)
+/* Offset from the host address of an instruction to its predecoded words */
+extern uintptr predecode_words_offset;
+#define get_ipword(o) (*(uae_u16 *)((uintptr)regs.pc_p + predecode_words_offset + (o)))
+#define get_ibyte(o) ((uae_u8)get_ipword(o))
+#define get_iword(o) get_ipword(o)
+#define get_ilong(o) (((uae_u32)get_ipword(o) << 16) | get_ipword((o) + 2))
+
 #else
 #define get_ibyte(o) do_get_mem_byte((uae_u8 *)(get_real_address(m68k_getpc(), 0, sz_byte) + (o) + 1))
 #define get_iword(o) do_get_mem_word((uae_u16 *)(get_real_address(m68k_getpc(), 0, sz_word) + (o)))
@@ -312,6 +368,10 @@ extern void m68k_record_step(uaecptr, int);
 
 extern void m68k_do_execute(void);
 extern void m68k_execute(void);
+#if PREDECODE_CACHE
+extern bool UsePredecode;
+#endif
+extern void flush_predecoded_blocks(void);
 #ifdef USE_JIT
 extern void m68k_compile_execute(void);
 extern void m68k_do_compile_execute(void);
@@ -326,11 +386,9 @@ static inline void cpu_check_ticks(void)
 		cpu_do_check_ticks();
 }
 #else
-extern uint16 emulated_ticks;
+/* Ticks come from a host timer, which raises SPCFLAG_INT on its own */
 static inline void cpu_check_ticks(void)
 {
-	if (!++emulated_ticks)
-		cpu_do_check_ticks();
 }
 #endif
 
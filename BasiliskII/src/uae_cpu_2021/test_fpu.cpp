@@ -0,0 +1,267 @@
+/*
+ *  test_fpu.cpp - 68k FPU benchmark and regression check
+ *
+ *  Basilisk II (C) 1997-2008 Christian Bauer
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ *  Runs a fixed FPU workload (FADD, FSUB, FMUL, FDIV, FSQRT and FMOVE) in
+ *  all four rounding modes and in double precision, with the plain
+ *  interpreter, and prints the emulated MIPS. The registers and FPSR left
+ *  by a short run are then compared with reference results, when there
+ *  are some for the FPU core that was built in. Usage:
+ *
+ *    test-fpu [ITERATIONS]
+ */
+
+#include "sysdeps.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cpu_emulation.h"
+#include "main.h"
+#include "emul_op.h"
+#include "m68k.h"
+#include "memory.h"
+#include "readcpu.h"
+#include "newcpu.h"
+#include "fpu/fpu.h"
+
+// Glue normally provided by basilisk_glue.cpp and main_*.cpp
+uint32 RAMBaseMac = 0;
+uint8 *RAMBaseHost;
+uint32 RAMSize;
+uint32 ROMBaseMac;
+uint8 *ROMBaseHost;
+uint32 ROMSize;
+#if !REAL_ADDRESSING
+uint8 *MacFrameBaseHost;
+uint32 MacFrameSize;
+int MacFrameLayout;
+#endif
+#if DIRECT_ADDRESSING
+uintptr MEMBaseDiff;
+#endif
+int CPUType = 4;
+bool CPUIs68060 = false;
+int FPUType = 1;
+bool TwentyFourBitAddressing = false;
+B2_mutex *spcflags_lock = NULL;
+#if USE_JIT
+bool UseJIT = false;
+static void flush_nothing(void) { }
+void (*flush_icache)(void) = flush_nothing;
+void set_cache_state(int enabled) { }
+#endif
+
+struct B2_mutex { };
+void B2_lock_mutex(B2_mutex *mutex) { }
+void B2_unlock_mutex(B2_mutex *mutex) { }
+
+void EmulOp(uint16 opcode, M68kRegisters *r) { }
+int intlev(void) { return 0; }
+
+#ifdef USE_CPU_EMUL_SERVICES
+int32 emulated_ticks = 0x7fffffff;
+void cpu_do_check_ticks(void) { emulated_ticks = 0x7fffffff; }
+#else
+void cpu_do_check_ticks(void) { }
+#endif
+
+const uint32 CODE_ADDR = 0x1000;
+const uint32 DST_ADDR = 0x3000;
+const uint32 STACK_ADDR = 0x10000;
+const uint32 TEST_RAM_SIZE = 0x20000;
+
+static const uint16 workload[] = {
+	0xf23c, 0x9000, 0x0000, 0x0000,	// 00: fmove.l	#FPCR,fpcr
+	0xf23c, 0x4000, 0x0000, 0x0001,	// 08: fmove.l	#1,fp0
+	0xf23c, 0x4080, 0x0000, 0x0003,	// 10: fmove.l	#3,fp1
+	0xf23c, 0x4100, 0x0000, 0x0007,	// 18: fmove.l	#7,fp2
+	0xf200, 0x08a0,					// 20: fdiv.x	fp2,fp1
+	0x2e3c, 0x0000, 0x0000,			// 24: move.l	#ITERATIONS,d7
+									// loop:
+	0xf200, 0x0423,					// 2a: fmul.x	fp1,fp0
+	0xf200, 0x0822,					// 2e: fadd.x	fp2,fp0
+	0xf200, 0x0184,					// 32: fsqrt.x	fp0,fp3
+	0xf200, 0x0c20,					// 36: fdiv.x	fp3,fp0
+	0xf200, 0x0428,					// 3a: fsub.x	fp1,fp0
+	0xf200, 0x0200,					// 3e: fmove.x	fp0,fp4
+	0xf200, 0x0e22,					// 42: fadd.x	fp3,fp4
+	0x5387,							// 46: subq.l	#1,d7
+	0x66e0,							// 48: bne.s	loop
+	0x207c, 0x0000, 0x3000,			// 4a: movea.l	#DST_ADDR,a0
+	0xf210, 0xf0ff,					// 50: fmovem.x	fp0-fp7,(a0)
+	0x43e8, 0x0060,					// 54: lea		96(a0),a1
+	0xf211, 0xa800,					// 58: fmove.l	fpsr,(a1)
+	M68K_EXEC_RETURN,				// 5c:
+};
+
+const uint64 LOOP_INSNS = 9;
+const uint64 SETUP_INSNS = 11;
+
+// The workload runs once with each rounding mode, and once with double
+// rounding precision
+static const uint32 test_fpcr[] = { 0x00, 0x10, 0x20, 0x30, 0x80 };
+const int NUM_FPCR = sizeof(test_fpcr) / sizeof(test_fpcr[0]);
+
+// FP0-FP7 and FPSR as stored by the workload, in 68k byte order
+const int RESULT_WORDS = (8 * 12 + 4) / 4;
+
+// Iterations of the run compared with the reference results
+const uint32 CHECK_ITERATIONS = 1000;
+
+#ifdef FPU_MPFR
+// Results of the MPFR core, which rounds correctly and so does not depend
+// on the host. The other cores compute in the host's long double.
+static const uint32 reference[NUM_FPCR][RESULT_WORDS] = {
+	{	// fpcr 00
+		0x40000000, 0x99f07be3, 0x04df3e3b, 0x3ffd0000, 0xdb6db6db, 0x6db6db6e,
+		0x40010000, 0xe0000000, 0x00000000, 0x40000000, 0xb55e32be, 0x729619a8,
+		0x40010000, 0xa7a75750, 0xbbbaabf2, 0x7fff0000, 0xffffffff, 0xffffffff,
+		0x7fff0000, 0xffffffff, 0xffffffff, 0x7fff0000, 0xffffffff, 0xffffffff,
+		0x00000208
+	},
+	{	// fpcr 10
+		0x40000000, 0x99f07be3, 0x04df3e3a, 0x3ffd0000, 0xdb6db6db, 0x6db6db6d,
+		0x40010000, 0xe0000000, 0x00000000, 0x40000000, 0xb55e32be, 0x729619a7,
+		0x40010000, 0xa7a75750, 0xbbbaabf0, 0x7fff0000, 0xffffffff, 0xffffffff,
+		0x7fff0000, 0xffffffff, 0xffffffff, 0x7fff0000, 0xffffffff, 0xffffffff,
+		0x00000208
+	},
+	{	// fpcr 20
+		0x40000000, 0x99f07be3, 0x04df3e3a, 0x3ffd0000, 0xdb6db6db, 0x6db6db6d,
+		0x40010000, 0xe0000000, 0x00000000, 0x40000000, 0xb55e32be, 0x729619a7,
+		0x40010000, 0xa7a75750, 0xbbbaabf0, 0x7fff0000, 0xffffffff, 0xffffffff,
+		0x7fff0000, 0xffffffff, 0xffffffff, 0x7fff0000, 0xffffffff, 0xffffffff,
+		0x00000208
+	},
+	{	// fpcr 30
+		0x40000000, 0x99f07be3, 0x04df3e3c, 0x3ffd0000, 0xdb6db6db, 0x6db6db6e,
+		0x40010000, 0xe0000000, 0x00000000, 0x40000000, 0xb55e32be, 0x729619aa,
+		0x40010000, 0xa7a75750, 0xbbbaabf3, 0x7fff0000, 0xffffffff, 0xffffffff,
+		0x7fff0000, 0xffffffff, 0xffffffff, 0x7fff0000, 0xffffffff, 0xffffffff,
+		0x00000008
+	},
+	{	// fpcr 80
+		0x40000000, 0x99f07be3, 0x04df4000, 0x3ffd0000, 0xdb6db6db, 0x6db6d800,
+		0x40010000, 0xe0000000, 0x00000000, 0x40000000, 0xb55e32be, 0x72961800,
+		0x40010000, 0xa7a75750, 0xbbbab000, 0x7fff0000, 0xffffffff, 0xffffffff,
+		0x7fff0000, 0xffffffff, 0xffffffff, 0x7fff0000, 0xffffffff, 0xffffffff,
+		0x00000208
+	},
+};
+#define HAVE_REFERENCE 1
+#else
+#define HAVE_REFERENCE 0
+#endif
+
+static void run_workload(uint32 fpcr, uint32 iterations, uint32 *result, double *seconds)
+{
+	memset(RAMBaseHost, 0, TEST_RAM_SIZE);
+	for (size_t i = 0; i < sizeof(workload) / sizeof(workload[0]); i++)
+		WriteMacInt16(CODE_ADDR + 2 * i, workload[i]);
+	WriteMacInt32(CODE_ADDR + 4, fpcr);
+	WriteMacInt32(CODE_ADDR + 0x26, iterations);
+	fpu_reset();
+
+	for (int i = 0; i < 8; i++) {
+		m68k_dreg(regs, i) = 0;
+		m68k_areg(regs, i) = 0;
+	}
+	regs.sr = 0x2700;
+	MakeFromSR();
+	m68k_areg(regs, 7) = STACK_ADDR;
+	SPCFLAGS_INIT(0);
+	m68k_setpc(CODE_ADDR);
+	quit_program = 0;
+
+	clock_t start = clock();
+	m68k_execute();
+	quit_program = 0;
+	*seconds = double(clock() - start) / double(CLOCKS_PER_SEC);
+
+	for (int i = 0; i < RESULT_WORDS; i++)
+		result[i] = ReadMacInt32(DST_ADDR + 4 * i);
+}
+
+int main(int argc, char *argv[])
+{
+#if !DIRECT_ADDRESSING
+	printf("test-fpu requires direct addressing\n");
+	return 0;
+#else
+	const uint32 iterations = argc > 1 ? atoi(argv[1]) : 100000;
+
+	RAMBaseHost = (uint8 *)calloc(1, TEST_RAM_SIZE);
+	RAMSize = TEST_RAM_SIZE;
+	MEMBaseDiff = (uintptr)RAMBaseHost;
+	ROMBaseHost = RAMBaseHost;
+	ROMBaseMac = 0;
+	ROMSize = 0;
+
+	// The predecoded interpreter is left off, it has its own test-m68k
+	init_m68k();
+
+	// Keep the fastest of a few runs, the others were disturbed
+	uint32 result[NUM_FPCR][RESULT_WORDS];
+	double best = 0;
+	for (int i = 0; i < 3; i++) {
+		double total = 0;
+		for (int j = 0; j < NUM_FPCR; j++) {
+			double seconds;
+			run_workload(test_fpcr[j], iterations, result[j], &seconds);
+			total += seconds;
+		}
+		if (i == 0 || total < best)
+			best = total;
+	}
+
+	const uint64 insns = NUM_FPCR * (SETUP_INSNS + iterations * LOOP_INSNS);
+	printf("%u iterations, %llu instructions\n", iterations, (unsigned long long)insns);
+	printf("  interpreter  %8.2f MIPS\n", insns / best / 1e6);
+
+	bool ok = true;
+	for (int i = 0; i < NUM_FPCR; i++) {
+		double seconds;
+		run_workload(test_fpcr[i], CHECK_ITERATIONS, result[i], &seconds);
+#if HAVE_REFERENCE
+		for (int j = 0; j < RESULT_WORDS; j++) {
+			if (result[i][j] != reference[i][j]) {
+				printf("fpcr %08x: word %d is %08x, expected %08x\n", test_fpcr[i], j, result[i][j], reference[i][j]);
+				ok = false;
+			}
+		}
+#else
+		printf("fpcr %08x:", test_fpcr[i]);
+		for (int j = 0; j < RESULT_WORDS; j++)
+			printf("%s%08x", j % 6 ? " " : "\n  ", result[i][j]);
+		printf("\n");
+#endif
+	}
+#if !HAVE_REFERENCE
+	printf("No reference results for this FPU core, the results above were not checked\n");
+#endif
+
+	exit_m68k();
+	free(RAMBaseHost);
+	return ok ? 0 : 1;
+#endif
+}
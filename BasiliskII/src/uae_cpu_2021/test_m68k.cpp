@@ -0,0 +1,249 @@
+/*
+ *  test_m68k.cpp - 68k interpreter benchmark
+ *
+ *  Basilisk II (C) 1997-2008 Christian Bauer
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ *  Runs a fixed 68k workload (register arithmetic, memory copies,
+ *  instructions with extension words and subroutine calls) with the plain
+ *  and the predecoded interpreter, and prints the emulated MIPS of each.
+ *  Usage:
+ *
+ *    test-m68k [ITERATIONS]
+ */
+
+#include "sysdeps.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cpu_emulation.h"
+#include "main.h"
+#include "emul_op.h"
+#include "m68k.h"
+#include "memory.h"
+#include "readcpu.h"
+#include "newcpu.h"
+
+// Glue normally provided by basilisk_glue.cpp and main_*.cpp
+uint32 RAMBaseMac = 0;
+uint8 *RAMBaseHost;
+uint32 RAMSize;
+uint32 ROMBaseMac;
+uint8 *ROMBaseHost;
+uint32 ROMSize;
+#if !REAL_ADDRESSING
+uint8 *MacFrameBaseHost;
+uint32 MacFrameSize;
+int MacFrameLayout;
+#endif
+#if DIRECT_ADDRESSING
+uintptr MEMBaseDiff;
+#endif
+int CPUType = 4;
+bool CPUIs68060 = false;
+int FPUType = 1;
+bool TwentyFourBitAddressing = false;
+B2_mutex *spcflags_lock = NULL;
+#if USE_JIT
+bool UseJIT = false;
+void (*flush_icache)(void) = flush_predecoded_blocks;
+void set_cache_state(int enabled) { }
+#endif
+
+struct B2_mutex { };
+void B2_lock_mutex(B2_mutex *mutex) { }
+void B2_unlock_mutex(B2_mutex *mutex) { }
+
+void EmulOp(uint16 opcode, M68kRegisters *r) { }
+int intlev(void) { return 0; }
+
+#ifdef USE_CPU_EMUL_SERVICES
+int32 emulated_ticks = 0x7fffffff;
+void cpu_do_check_ticks(void) { emulated_ticks = 0x7fffffff; }
+#else
+void cpu_do_check_ticks(void) { }
+#endif
+
+const uint32 CODE_ADDR = 0x1000;
+const uint32 SRC_ADDR = 0x2000;
+const uint32 DST_ADDR = 0x3000;
+const uint32 STACK_ADDR = 0x10000;
+const uint32 TEST_RAM_SIZE = 0x20000;
+
+static const uint16 workload[] = {
+	0x2e3c, 0x0000, 0x0000,		// 00: move.l	#ITERATIONS,d7
+								// outer:
+	0x7000,						// 06: moveq	#0,d0
+	0x7263,						// 08: moveq	#99,d1
+								// loop:
+	0xd081,						// 0a: add.l	d1,d0
+	0xb182,						// 0c: eor.l	d0,d2
+	0xe79a,						// 0e: rol.l	#3,d2
+	0x0800, 0x0000,				// 10: btst		#0,d0
+	0x6702,						// 14: beq.s	skip
+	0x5286,						// 16: addq.l	#1,d6
+								// skip:
+	0x51c9, 0xfff0,				// 18: dbf		d1,loop
+	0x207c, 0x0000, 0x2000,		// 1c: movea.l	#SRC_ADDR,a0
+	0x227c, 0x0000, 0x3000,		// 22: movea.l	#DST_ADDR,a1
+	0x763f,						// 28: moveq	#63,d3
+								// copy:
+	0x22d8,						// 2a: move.l	(a0)+,(a1)+
+	0x51cb, 0xfffc,				// 2c: dbf		d3,copy
+	0x207c, 0x0000, 0x3000,		// 30: movea.l	#DST_ADDR,a0
+	0x763f,						// 36: moveq	#63,d3
+								// sum:
+	0xda98,						// 38: add.l	(a0)+,d5
+	0x51cb, 0xfffc,				// 3a: dbf		d3,sum
+	0x45f9, 0x0000, 0x2000,		// 3e: lea		SRC_ADDR,a2
+	0x761f,						// 44: moveq	#31,d3
+								// operands:
+	0x202a, 0x0008,				// 46: move.l	8(a2),d0
+	0x0680, 0x0123, 0x4567,		// 4a: addi.l	#$01234567,d0
+	0x2432, 0x3400,				// 50: move.l	0(a2,d3.w*4),d2
+	0xb580,						// 54: eor.l	d2,d0
+	0x0c40, 0x1234,				// 56: cmpi.w	#$1234,d0
+	0x0280, 0x00ff, 0x00ff,		// 5a: andi.l	#$00ff00ff,d0
+	0xda80,						// 60: add.l	d0,d5
+	0x3340, 0x0002,				// 62: move.w	d0,2(a1)
+	0x51cb, 0xffde,				// 66: dbf		d3,operands
+	0x720f,						// 6a: moveq	#15,d1
+								// call:
+	0x6100, 0x000e,				// 6c: bsr.w	func
+	0x51c9, 0xfffa,				// 70: dbf		d1,call
+	0x5387,						// 74: subq.l	#1,d7
+	0x6600, 0xff8e,				// 76: bne.w	outer
+	M68K_EXEC_RETURN,			// 7a:
+								// func:
+	0xc6c1,						// 7c: mulu.w	d1,d3
+	0xd883,						// 7e: add.l	d3,d4
+	0x4e75,						// 80: rts
+};
+
+// Instructions executed by one pass through the outer loop (the skip
+// branch is taken 50 times out of 100), and by the code around it
+const uint64 OUTER_LOOP_INSNS = 2 + 100 * 6 + 50 + 3 + 64 * 2 + 2 + 64 * 2 + 2 + 32 * 9 + 1 + 16 * 5 + 2;
+const uint64 SETUP_INSNS = 2;
+
+struct run_result {
+	uint32 d[8];
+	uint16 sr;
+	double seconds;
+};
+
+static void load_workload(const uint16 *code, size_t words)
+{
+	memset(RAMBaseHost, 0, TEST_RAM_SIZE);
+	for (int i = 0; i < 256; i++)
+		WriteMacInt8(SRC_ADDR + i, i * 37 + 11);
+	for (size_t i = 0; i < words; i++)
+		WriteMacInt16(CODE_ADDR + 2 * i, code[i]);
+	flush_predecoded_blocks();
+}
+
+static double execute_workload(bool predecode)
+{
+	for (int i = 0; i < 8; i++) {
+		m68k_dreg(regs, i) = 0;
+		m68k_areg(regs, i) = 0;
+	}
+	regs.sr = 0x2700;
+	MakeFromSR();
+	m68k_areg(regs, 7) = STACK_ADDR;
+	SPCFLAGS_INIT(0);
+	m68k_setpc(CODE_ADDR);
+	quit_program = 0;
+
+	UsePredecode = predecode;
+	clock_t start = clock();
+	m68k_execute();
+	quit_program = 0;
+	return double(clock() - start) / double(CLOCKS_PER_SEC);
+}
+
+static void run_workload(uint32 iterations, bool predecode, run_result *res)
+{
+	load_workload(workload, sizeof(workload) / sizeof(workload[0]));
+	WriteMacInt32(CODE_ADDR + 2, iterations);
+
+	res->seconds = execute_workload(predecode);
+	for (int i = 0; i < 8; i++)
+		res->d[i] = m68k_dreg(regs, i);
+	MakeSR();
+	res->sr = regs.sr;
+}
+
+int main(int argc, char *argv[])
+{
+#if !DIRECT_ADDRESSING
+	printf("test-m68k requires direct addressing\n");
+	return 0;
+#else
+	const uint32 iterations = argc > 1 ? atoi(argv[1]) : 100000;
+
+	RAMBaseHost = (uint8 *)calloc(1, TEST_RAM_SIZE);
+	RAMSize = TEST_RAM_SIZE;
+	MEMBaseDiff = (uintptr)RAMBaseHost;
+	ROMBaseHost = RAMBaseHost;
+	ROMBaseMac = 0;
+	ROMSize = 0;
+
+	UsePredecode = true;
+	init_m68k();
+	if (!UsePredecode) {
+		printf("Could not allocate the predecode cache\n");
+		return 1;
+	}
+
+	// Keep the fastest of a few runs, the others were disturbed
+	run_result plain, predecoded;
+	for (int i = 0; i < 3; i++) {
+		run_result res;
+		run_workload(iterations, false, &res);
+		if (i == 0 || res.seconds < plain.seconds)
+			plain = res;
+		run_workload(iterations, true, &res);
+		if (i == 0 || res.seconds < predecoded.seconds)
+			predecoded = res;
+	}
+
+	const uint64 insns = SETUP_INSNS + iterations * OUTER_LOOP_INSNS;
+	printf("%u iterations, %llu instructions\n", iterations, (unsigned long long)insns);
+	printf("  interpreter  %8.2f MIPS\n", insns / plain.seconds / 1e6);
+	printf("  predecoded   %8.2f MIPS\n", insns / predecoded.seconds / 1e6);
+
+	bool ok = true;
+	for (int i = 0; i < 8; i++) {
+		if (plain.d[i] != predecoded.d[i]) {
+			printf("d%d mismatch: %08x, expected %08x\n", i, predecoded.d[i], plain.d[i]);
+			ok = false;
+		}
+	}
+	if (plain.sr != predecoded.sr) {
+		printf("sr mismatch: %04x, expected %04x\n", predecoded.sr, plain.sr);
+		ok = false;
+	}
+
+	exit_m68k();
+	free(RAMBaseHost);
+	return ok ? 0 : 1;
+#endif
+}
@@ -0,0 +1 @@
+../../../BasiliskII/src/CrossPlatform/jit_perf.cpp
\ No newline at end of file
@@ -0,0 +1 @@
+../../../BasiliskII/src/CrossPlatform/jit_perf.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../BasiliskII/src/CrossPlatform/video_headless.cpp
\ No newline at end of file
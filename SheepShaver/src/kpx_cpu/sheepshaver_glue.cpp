@@ -28,6 +28,7 @@
 #include "macos_util.h"
 #include "block-alloc.hpp"
 #include "sigsegv.h"
+#include "jit_perf.h"
 #include "cpu/ppc/ppc-cpu.hpp"
 #include "cpu/ppc/ppc-operations.hpp"
 #include "cpu/ppc/ppc-instructions.hpp"
@@ -186,8 +187,32 @@ sheepshaver_cpu::sheepshaver_cpu()
 	init_decoder();
 
 #if PPC_ENABLE_JIT
-	if (PrefsFindBool("jit"))
+	if (PrefsFindBool("jit")) {
+#if PPC_PERSISTENT_JIT_CACHE
+		// Translate at the address a previous session saved code for
+		const char *jit_cache_file = PrefsFindString("jitcachefile");
+		enable_jit(0, jit_cache_file && jit_cache_file[0] ? jit_cache_file : NULL);
+#else
 		enable_jit();
+#endif
+		// Tell host profilers about translated code
+		if (jit_perf_init(PrefsFindString("jitperf"))) {
+			add_perf_code_area(ROMBase, ROM_AREA_SIZE);
+			add_perf_code_area(RAMBase, RAMSize);
+		}
+#if PPC_TIERED_JIT
+		// Interpret blocks until they get hot
+		const int32 threshold = PrefsFindInt32("jitthreshold");
+		if (threshold > 0) {
+			set_jit_threshold(threshold);
+#if PPC_BACKGROUND_JIT
+			// Translate hot blocks without stopping emulation
+			if (PrefsFindBool("jitthread"))
+				start_jit_thread();
+#endif
+		}
+#endif
+	}
 #endif
 }
 
@@ -852,6 +877,13 @@ void init_emul_ppc(void)
 	ppc_cpu->set_register(powerpc_registers::GPR(4), any_register(KernelDataAddr + 0x1000));
 	WriteMacInt32(XLM_RUN_MODE, MODE_68K);
 
+#if PPC_ENABLE_JIT && PPC_PERSISTENT_JIT_CACHE
+	// Reuse translated code from a previous session, keyed by ROM checksum
+	const char *jit_cache_file = PrefsFindString("jitcachefile");
+	if (jit_cache_file && jit_cache_file[0])
+		ppc_cpu->load_translation_cache(jit_cache_file, ReadMacInt32(ROMBase));
+#endif
+
 #if ENABLE_MON
 	// Install "regs" command in cxmon
 	mon_add_command("regs", dump_registers, "regs                     Dump PowerPC registers\n");
@@ -895,8 +927,17 @@ void exit_emul_ppc(void)
 	printf("\n");
 #endif
 
+#if PPC_ENABLE_JIT && PPC_PERSISTENT_JIT_CACHE
+	const char *jit_cache_file = PrefsFindString("jitcachefile");
+	if (jit_cache_file && jit_cache_file[0])
+		ppc_cpu->save_translation_cache(jit_cache_file);
+#endif
+
 	delete ppc_cpu;
 	ppc_cpu = NULL;
+#if PPC_ENABLE_JIT
+	jit_perf_exit();
+#endif
 }
 
 #if PPC_ENABLE_JIT && PPC_REENTRANT_JIT
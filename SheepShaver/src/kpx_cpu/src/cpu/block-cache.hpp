@@ -72,6 +72,9 @@ public:
 
 	void add_to_active_list(block_info *bi);
 	void add_to_dormant_list(block_info *bi);
+
+	template< class Functor >
+	void for_each(Functor & f);
 };
 
 template< class block_info, template<class T> class block_allocator >
@@ -274,4 +277,288 @@ inline void block_cache< block_info, block_allocator >::remove_from_lists(block_
 	remove_from_list(bi);
 }
 
+template< class block_info, template<class T> class block_allocator >
+template< class Functor >
+void block_cache< block_info, block_allocator >::for_each(Functor & f)
+{
+	for (entry *p = active; p != NULL; p = p->next)
+		f(p);
+	for (entry *p = dormant; p != NULL; p = p->next)
+		f(p);
+}
+
+/**
+ *	Guest page index
+ *
+ *		Files each block under every page it was decoded from, so
+ *		that a range invalidation only visits the blocks that live in
+ *		the affected pages. Blocks from read-only memory only (the
+ *		dormant list) need not be filed. BLOCK_INFO shall provide
+ *		pages[page_count] with an address in each page, and as many
+ *		block_page_link<> in page_links[].
+ *
+ *		The index is kept apart from block_cache since generated code
+ *		depends on the layout of the latter.
+ **/
+
+template< class block_info >
+struct block_page_link
+{
+	block_info *				next;
+	block_info **				prev_p;
+};
+
+template< class block_info >
+class block_page_index
+{
+	static const uint32 PAGE_BITS = block_info::PAGE_BITS;
+	static const uint32 HASH_BITS = 12;
+	static const uint32 HASH_SIZE = 1 << HASH_BITS;
+	static const uint32 HASH_MASK = HASH_SIZE - 1;
+
+	block_info *				page_tags[HASH_SIZE];
+
+	uint32 page_hash(uintptr addr) const {
+		return (addr >> PAGE_BITS) & HASH_MASK;
+	}
+
+	// Slot of BI that is chained into bucket H, the first page hashing to H
+	int link_slot(block_info *bi, uint32 h) const {
+		int s = 0;
+		while (page_hash(bi->pages[s].min_pc) != h)
+			s++;
+		return s;
+	}
+
+	void link(block_info *bi, int s, uint32 h);
+	void unlink(block_info *bi, int s, uint32 h);
+
+public:
+
+	block_page_index() { initialize(); }
+
+	void initialize();
+	void add(block_info *bi);
+	void remove(block_info *bi);
+
+	template< class Functor >
+	uint32 clear_range(uintptr start, uintptr end, Functor & discard);
+};
+
+template< class block_info >
+void block_page_index< block_info >::initialize()
+{
+	for (int i = 0; i < HASH_SIZE; i++)
+		page_tags[i] = NULL;
+}
+
+template< class block_info >
+inline void block_page_index< block_info >::link(block_info *bi, int s, uint32 h)
+{
+	block_info *head = page_tags[h];
+	if (head)
+		head->page_links[link_slot(head, h)].prev_p = &bi->page_links[s].next;
+	bi->page_links[s].next = head;
+	bi->page_links[s].prev_p = &page_tags[h];
+	page_tags[h] = bi;
+}
+
+template< class block_info >
+inline void block_page_index< block_info >::unlink(block_info *bi, int s, uint32 h)
+{
+	block_page_link< block_info > & l = bi->page_links[s];
+	if (l.prev_p)
+		*l.prev_p = l.next;
+	if (l.next)
+		l.next->page_links[link_slot(l.next, h)].prev_p = l.prev_p;
+	l.next = NULL;
+	l.prev_p = NULL;
+}
+
+template< class block_info >
+void block_page_index< block_info >::add(block_info *bi)
+{
+	// A block is chained at most once per bucket
+	for (int s = 0; s < bi->page_count; s++) {
+		const uint32 h = page_hash(bi->pages[s].min_pc);
+		if (link_slot(bi, h) == s)
+			link(bi, s, h);
+		else {
+			bi->page_links[s].next = NULL;
+			bi->page_links[s].prev_p = NULL;
+		}
+	}
+}
+
+template< class block_info >
+void block_page_index< block_info >::remove(block_info *bi)
+{
+	for (int s = 0; s < bi->page_count; s++)
+		unlink(bi, s, page_hash(bi->pages[s].min_pc));
+}
+
+// Remove blocks intersecting [START, END) from the index and hand them to DISCARD
+template< class block_info >
+template< class Functor >
+uint32 block_page_index< block_info >::clear_range(uintptr start, uintptr end, Functor & discard)
+{
+	if (end <= start)
+		return 0;
+
+	// Visit each bucket only once, even if the range wraps the table
+	const uintptr first_page = start >> PAGE_BITS;
+	const uintptr page_count = ((end - 1) >> PAGE_BITS) - first_page + 1;
+	const uint32 bucket_count = page_count < HASH_SIZE ? page_count : HASH_SIZE;
+
+	uint32 count = 0;
+	for (uint32 i = 0; i < bucket_count; i++) {
+		const uint32 h = (first_page + i) & HASH_MASK;
+		block_info *p = page_tags[h];
+		while (p) {
+			block_info *q = p;
+			p = q->page_links[link_slot(q, h)].next;
+			if (q->intersect(start, end)) {
+				remove(q);
+				discard(q);
+				count++;
+			}
+		}
+	}
+	return count;
+}
+
+/**
+ *	PC to block lookup table
+ *
+ *		Open-addressed hash table with linear probing that backs up
+ *		the direct-mapped cache_tags[] of block_cache, whose chains
+ *		get long once tens of thousands of blocks are live. Slots are
+ *		(pc, block) pairs so that a probe sequence stays within a few
+ *		cache lines. The table doubles when it gets half full and
+ *		entries are removed by backward shifting, so there are no
+ *		tombstones to clean up.
+ **/
+
+template< class block_info >
+class block_lookup_table
+{
+	static const uint32 MIN_HASH_BITS = 12;
+
+	struct slot
+	{
+		uintptr					pc;
+		block_info *			bi;
+	};
+
+	slot *						slots;
+	uint32						hash_bits;
+	uint32						hash_mask;
+	uint32						count;
+
+	uint32 hash(uintptr pc) const {
+		return ((uint32)(pc >> 2) * 0x9e3779b1) >> (32 - hash_bits);
+	}
+
+	void allocate(uint32 bits);
+	void grow();
+
+public:
+
+	block_lookup_table() : slots(NULL), count(0) { allocate(MIN_HASH_BITS); }
+	~block_lookup_table() { delete[] slots; }
+
+	void initialize();
+	block_info *find(uintptr pc) const;
+	void add(block_info *bi);
+	void remove(block_info *bi);
+	uint32 size() const { return count; }
+	uint32 capacity() const { return hash_mask + 1; }
+};
+
+template< class block_info >
+void block_lookup_table< block_info >::allocate(uint32 bits)
+{
+	delete[] slots;
+	hash_bits = bits;
+	hash_mask = (1 << bits) - 1;
+	slots = new slot[hash_mask + 1];
+	initialize();
+}
+
+template< class block_info >
+void block_lookup_table< block_info >::initialize()
+{
+	for (uint32 i = 0; i <= hash_mask; i++)
+		slots[i].bi = NULL;
+	count = 0;
+}
+
+template< class block_info >
+void block_lookup_table< block_info >::grow()
+{
+	slot * const old_slots = slots;
+	const uint32 old_size = hash_mask + 1;
+	slots = NULL;
+	allocate(hash_bits + 1);
+	for (uint32 i = 0; i < old_size; i++) {
+		if (old_slots[i].bi)
+			add(old_slots[i].bi);
+	}
+	delete[] old_slots;
+}
+
+template< class block_info >
+inline block_info *block_lookup_table< block_info >::find(uintptr pc) const
+{
+	for (uint32 i = hash(pc); slots[i].bi; i = (i + 1) & hash_mask) {
+		if (slots[i].pc == pc)
+			return slots[i].bi;
+	}
+	return NULL;
+}
+
+template< class block_info >
+void block_lookup_table< block_info >::add(block_info *bi)
+{
+	if (2 * (count + 1) > hash_mask + 1)
+		grow();
+
+	uint32 i = hash(bi->pc);
+	while (slots[i].bi)
+		i = (i + 1) & hash_mask;
+	slots[i].pc = bi->pc;
+	slots[i].bi = bi;
+	count++;
+}
+
+template< class block_info >
+void block_lookup_table< block_info >::remove(block_info *bi)
+{
+	uint32 i = hash(bi->pc);
+	while (slots[i].bi != bi) {
+		if (slots[i].bi == NULL)
+			return;
+		i = (i + 1) & hash_mask;
+	}
+	count--;
+
+	// Move back the following entries that would no longer be
+	// reachable from their home slot
+	for (;;) {
+		slots[i].bi = NULL;
+		uint32 j = i;
+		for (;;) {
+			j = (j + 1) & hash_mask;
+			if (slots[j].bi == NULL)
+				return;
+			const uint32 k = hash(slots[j].pc);
+			if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+				continue;
+			break;
+		}
+		slots[i] = slots[j];
+		i = j;
+	}
+}
+
 #endif /* BLOCK_CACHE_H */
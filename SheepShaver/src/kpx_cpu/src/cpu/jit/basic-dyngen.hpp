@@ -40,6 +40,19 @@ static inline void dg_set_jmp_target_noflush(uint8 *jmp_addr, uint8 *addr)
 #endif
 }
 
+// Get jump target address
+static inline uint8 *dg_get_jmp_target(uint8 *jmp_addr)
+{
+#if defined(__powerpc__) || defined(__ppc__)
+	// sign-extend the 24-bit branch displacement
+	int32 disp = ((int32)(*(uint32 *)jmp_addr << 6)) >> 6;
+	return jmp_addr + (disp & ~3);
+#endif
+#if defined(__i386__) || defined(__x86_64__)
+	return jmp_addr + 4 + *(int32 *)jmp_addr;
+#endif
+}
+
 static inline void dg_set_jmp_target(uint8 *jmp_addr, uint8 *addr)
 {
 	dg_set_jmp_target_noflush(jmp_addr, addr);
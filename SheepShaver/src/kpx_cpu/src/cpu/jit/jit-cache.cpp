@@ -38,8 +38,11 @@ const int JIT_CACHE_SIZE = 8 * 1024;
 #endif
 const int JIT_CACHE_SIZE_GUARD = 4096;
 
+// Split the translation cache into regions of at least 256 KB
+const int JIT_CACHE_REGION_MIN_SIZE = 256 * 1024;
+
 basic_jit_cache::basic_jit_cache()
-	: cache_size(0), tcode_start(NULL), code_start(NULL), code_p(NULL), code_end(NULL), data(NULL)
+	: cache_size(0), tcode_start(NULL), code_start(NULL), code_p(NULL), code_end(NULL), cache_hint(NULL), data(NULL)
 {
 }
 
@@ -67,7 +70,7 @@ basic_jit_cache::init_translation_cache(uint32 size)
 	cache_size = (size + JIT_CACHE_SIZE_GUARD + roundup - 1) & -roundup;
 	assert(cache_size > 0);
 
-	tcode_start = (uint8 *)vm_acquire(cache_size, VM_MAP_PRIVATE | VM_MAP_32BIT);
+	tcode_start = (uint8 *)vm_acquire_hint(cache_hint, cache_size, VM_MAP_PRIVATE | VM_MAP_32BIT);
 	if (tcode_start == VM_MAP_FAILED) {
 		tcode_start = NULL;
 		return false;
@@ -82,8 +85,7 @@ basic_jit_cache::init_translation_cache(uint32 size)
 	
 	D(bug("basic_jit_cache: Translation cache: %d KB at %p\n", cache_size / 1024, tcode_start));
 	code_start = tcode_start;
-	code_p = code_start;
-	code_end = code_p + size;
+	set_code_region(0);
 	return true;
 }
 
@@ -114,6 +116,63 @@ basic_jit_cache::set_cache_size(uint32 size)
 		init_translation_cache(size);
 }
 
+bool
+basic_jit_cache::restore_code(const uint8 *image, uint32 size)
+{
+	// Only restore code into an empty translation cache
+	if (code_p != code_start || size > (uint32)(code_limit_ptr() - code_start))
+		return false;
+
+	D(bug("basic_jit_cache: Restore %d KB of code at %p\n", size / 1024, code_start));
+	memcpy(code_start, image, size);
+	code_p = code_start + size;
+	code_end = code_region_end(code_region(code_p));
+	return true;
+}
+
+// End of usable translation cache, code may overflow it up to the guard size
+uint8 *
+basic_jit_cache::code_limit_ptr() const
+{
+	return tcode_start + cache_size - JIT_CACHE_SIZE_GUARD;
+}
+
+int
+basic_jit_cache::code_regions() const
+{
+	const uint32 n = (code_limit_ptr() - code_start) / JIT_CACHE_REGION_MIN_SIZE;
+	if (n < 1)
+		return 1;
+	if (n > MAX_CODE_REGIONS)
+		return MAX_CODE_REGIONS;
+	return n;
+}
+
+int
+basic_jit_cache::code_region(const uint8 *ptr) const
+{
+	const uint32 region_size = ((code_limit_ptr() - code_start) / code_regions()) & -16;
+	const int n = (ptr - code_start) / region_size;
+	return n < code_regions() ? n : code_regions() - 1;
+}
+
+uint8 *
+basic_jit_cache::code_region_start(int region) const
+{
+	const uint32 region_size = ((code_limit_ptr() - code_start) / code_regions()) & -16;
+	return code_start + region * region_size;
+}
+
+// Leave room for code emitted past full_translation_cache() checks, so
+// that it doesn't overwrite the next region
+uint8 *
+basic_jit_cache::code_region_end(int region) const
+{
+	if (region == code_regions() - 1)
+		return code_limit_ptr();
+	return code_region_start(region + 1) - JIT_CACHE_SIZE_GUARD;
+}
+
 uint8 *
 basic_jit_cache::copy_data(const uint8 *block, uint32 size)
 {
@@ -150,4 +209,20 @@ basic_jit_cache::copy_data(const uint8 *block, uint32 size)
 	return ptr;
 }
 
+bool
+basic_jit_cache::references_data(const uint8 *start, const uint8 *end) const
+{
+	// Data pool chunks are 32-bit addressable, look for their addresses
+	// as 32-bit immediates or displacements in host byte order
+	for (const uint8 *p = start; p + sizeof(uint32) <= end; p++) {
+		uint32 value;
+		memcpy(&value, p, sizeof(value));
+		for (const data_chunk_t *d = data; d; d = d->next) {
+			if (value >= (uintptr)d && value < (uintptr)d + d->size)
+				return true;
+		}
+	}
+	return false;
+}
+
 #endif //ENABLE_DYNGEN
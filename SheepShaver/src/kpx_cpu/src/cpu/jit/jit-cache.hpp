@@ -37,6 +37,9 @@ class basic_jit_cache
 	uint8 *code_p;
 	uint8 *code_end;
 
+	// Preferred translation cache address, or NULL for any
+	uint8 *cache_hint;
+
 	// Data pool (32-bit addressable)
 	struct data_chunk_t {
 		uint32 size;
@@ -68,12 +71,23 @@ public:
 
 	bool initialize(void);
 	void set_cache_size(uint32 size);
+	void set_cache_hint(uint8 *ptr)	{ cache_hint = ptr; }
 
 	// Invalidate translation cache
 	void invalidate_cache();
 	bool full_translation_cache() const
 		{ return code_p >= code_end; }
 
+	// Translation cache regions. Code is emitted into one region at a
+	// time, full_translation_cache() tells when it reached its end
+	static const int MAX_CODE_REGIONS = 8;
+	int code_regions() const;
+	int code_region(const uint8 *ptr) const;
+	uint8 *code_region_start(int region) const;
+	uint8 *code_region_end(int region) const;
+	void set_code_region(int region);
+	uint8 *code_limit_ptr() const;
+
 	// Emit code to translation cache
 	template< typename T >
 	void emit_generic(T v);
@@ -87,6 +101,18 @@ public:
 
 	// Emit data to constant pool
 	uint8 *copy_data(const uint8 *block, uint32 size);
+
+	// Current data pool position, changes whenever copy_data() is used
+	uintptr data_pool_ptr() const
+		{ return data ? (uintptr)data + data->offs : 0; }
+
+	// Check whether code in [start, end) embeds a data pool address
+	bool references_data(const uint8 *start, const uint8 *end) const;
+
+	// Translation cache layout, for persistent caches
+	uint8 *cache_base() const		{ return tcode_start; }
+	uint8 *code_start_ptr() const	{ return code_start; }
+	bool restore_code(const uint8 *image, uint32 size);
 };
 
 inline void
@@ -94,12 +120,20 @@ basic_jit_cache::set_code_start(uint8 *ptr)
 {
 	assert(ptr >= tcode_start && ptr < code_end);
 	code_start = ptr;
+	code_end = code_region_end(code_region(code_p));
 }
 
 inline void
 basic_jit_cache::invalidate_cache()
 {
-	code_p = code_start;
+	set_code_region(0);
+}
+
+inline void
+basic_jit_cache::set_code_region(int region)
+{
+	code_p = code_region_start(region);
+	code_end = code_region_end(region);
 }
 
 template< class T >
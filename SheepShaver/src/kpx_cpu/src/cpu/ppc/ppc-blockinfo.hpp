@@ -24,6 +24,7 @@
 #include "cpu/jit/jit-config.hpp"
 #include "nvmemfun.hpp"
 #include "basic-blockinfo.hpp"
+#include "cpu/block-cache.hpp"
 
 class powerpc_cpu;
 
@@ -54,8 +55,36 @@ struct powerpc_block_info
 #endif
 #endif
 	uintptr				min_pc, max_pc;
+#if PPC_ENABLE_JIT && PPC_PERSISTENT_JIT_CACHE
+	struct reloc_info {
+		uint32			offset;							// Offset of block_info pointer from entry_point
+		uint32			tag;							// Bits or'ed to the block_info pointer
+	};
+	static const int	MAX_RELOCS = 1 + MAX_TARGETS;	// Epilogue and backpatch trampolines
+	uint64				source_hash;					// Hash of source instructions in [min_pc, max_pc]
+	int					reloc_count;					// Number of relocs, -1 if the block can't be saved
+	reloc_info			reloc[MAX_RELOCS];
+#endif
+	// Guest pages the block was decoded from, a superblock may continue
+	// in another page than the one it falls through into
+	static const int	PAGE_BITS = 12;
+	static const int	MAX_PAGES = 4;
+	struct page_range {
+		uintptr			min_pc, max_pc;					// Lowest and highest instruction in the page
+	};
+	page_range			pages[MAX_PAGES];
+	int					page_count;
+	block_page_link< powerpc_block_info > page_links[MAX_PAGES];	// Chains of blocks in each page
+#if PPC_ENABLE_JIT && DYNGEN_DIRECT_BLOCK_CHAINING && PPC_TRACE_BLOCKS
+	static const int	MAX_TRACE_EXITS = 4;			// Side exits in a superblock
+	uint8 *				body_jmp_addr;					// Prologue jump to patch to redirect to a superblock
+	uint16				branch_count[MAX_TARGETS];		// Executions of each side of a two-way branch
+	int					trace_exits;					// Number of side exits
+#endif
 
 	void init(uintptr start_pc);
+	bool can_add_pc(uintptr pc) const;
+	bool add_pc(uintptr pc);
 	bool intersect(uintptr start, uintptr end);
 	void invalidate();
 };
@@ -72,13 +101,67 @@ powerpc_block_info::init(uintptr start_pc)
 	for (int i = 0; i < MAX_TARGETS; i++)
 		li[i].jmp_pc = INVALID_PC;
 #endif
+#if PPC_PERSISTENT_JIT_CACHE
+	source_hash = 0;
+	reloc_count = 0;
 #endif
+#endif
+	page_count = 0;
+	for (int i = 0; i < MAX_PAGES; i++) {
+		page_links[i].next = NULL;
+		page_links[i].prev_p = NULL;
+	}
+#if PPC_ENABLE_JIT && DYNGEN_DIRECT_BLOCK_CHAINING && PPC_TRACE_BLOCKS
+	body_jmp_addr = NULL;
+	for (int i = 0; i < MAX_TARGETS; i++)
+		branch_count[i] = 0;
+	trace_exits = 0;
+#endif
+}
+
+// Returns TRUE if an instruction at PC can be added to the block
+inline bool
+powerpc_block_info::can_add_pc(uintptr pc) const
+{
+	if (page_count < MAX_PAGES)
+		return true;
+	for (int i = 0; i < page_count; i++) {
+		if (((pages[i].min_pc ^ pc) >> PAGE_BITS) == 0)
+			return true;
+	}
+	return false;
+}
+
+// Record an instruction at PC, returns FALSE if it is in one page too many
+inline bool
+powerpc_block_info::add_pc(uintptr pc)
+{
+	for (int i = 0; i < page_count; i++) {
+		page_range & p = pages[i];
+		if (((p.min_pc ^ pc) >> PAGE_BITS) == 0) {
+			if (pc < p.min_pc)
+				p.min_pc = pc;
+			else if (pc > p.max_pc)
+				p.max_pc = pc;
+			return true;
+		}
+	}
+	if (page_count == MAX_PAGES)
+		return false;
+	pages[page_count].min_pc = pc;
+	pages[page_count].max_pc = pc;
+	page_count++;
+	return true;
 }
 
 inline bool
 powerpc_block_info::intersect(uintptr start, uintptr end)
 {
-	return (min_pc >= start && min_pc < end) || (max_pc >= start && max_pc < end);
+	for (int i = 0; i < page_count; i++) {
+		if (pages[i].min_pc < end && pages[i].max_pc + 3 >= start)
+			return true;
+	}
+	return false;
 }
 
 #endif /* PPC_BLOCKINFO_H */
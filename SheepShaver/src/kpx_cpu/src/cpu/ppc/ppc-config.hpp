@@ -88,6 +88,66 @@
 #endif
 
 
+/**
+ *	PPC_PERSISTENT_JIT_CACHE
+ *
+ *		Define to 1 to support saving the translation cache to disk
+ *		at exit and reloading it at startup. Reloaded blocks are
+ *		only used once the hash of their source instructions has
+ *		been verified against current guest memory.
+ **/
+
+#ifndef PPC_PERSISTENT_JIT_CACHE
+#define PPC_PERSISTENT_JIT_CACHE PPC_ENABLE_JIT
+#endif
+
+
+/**
+ *	PPC_TRACE_BLOCKS
+ *
+ *		Define to 1 to let the JIT form superblocks. The first
+ *		executions of each side of a two-way branch are counted
+ *		before the branch is linked. If one side dominates, the
+ *		block is translated again, following that side, and the
+ *		other side becomes a side exit. Followed targets are in the
+ *		page of the block entry, or in ROM.
+ **/
+
+#ifndef PPC_TRACE_BLOCKS
+#define PPC_TRACE_BLOCKS PPC_ENABLE_JIT
+#endif
+
+
+/**
+ *	PPC_TIERED_JIT
+ *
+ *		Define to 1 to support interpreting blocks from the decode
+ *		cache until they were executed a given number of times, see
+ *		set_jit_threshold(). Only hot blocks get translated then.
+ **/
+
+#ifndef PPC_TIERED_JIT
+#define PPC_TIERED_JIT (PPC_ENABLE_JIT && PPC_DECODE_CACHE)
+#endif
+
+
+/**
+ *	PPC_BACKGROUND_JIT
+ *
+ *		Define to 1 to support translating hot blocks in a separate
+ *		thread, see start_jit_thread(). Blocks keep being interpreted
+ *		from the decode cache until their translation is published.
+ **/
+
+#ifndef PPC_BACKGROUND_JIT
+#if PPC_TIERED_JIT && defined(HAVE_PTHREADS)
+#define PPC_BACKGROUND_JIT 1
+#else
+#define PPC_BACKGROUND_JIT 0
+#endif
+#endif
+
+
 /**
  *	PPC_EXECUTE_DUMP_STATE
  *
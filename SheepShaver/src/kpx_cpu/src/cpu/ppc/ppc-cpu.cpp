@@ -21,6 +21,7 @@
 #include "sysdeps.h"
 #include <stdlib.h>
 #include <assert.h>
+#include <algorithm>
 #include "vm_alloc.h"
 #include "cpu/vm.hpp"
 #include "cpu/ppc/ppc-cpu.hpp"
@@ -30,6 +31,11 @@
 
 #if PPC_ENABLE_JIT
 #include "cpu/jit/dyngen-exec.h"
+#include "jit_perf.h"
+#endif
+
+#ifdef SHEEPSHAVER
+#include "cpu_emulation.h"
 #endif
 
 #if ENABLE_MON
@@ -273,6 +279,8 @@ void powerpc_cpu::initialize()
 	// Initialize block lookup table
 #if PPC_DECODE_CACHE || PPC_ENABLE_JIT
 	my_block_cache.initialize();
+	my_page_index.initialize();
+	my_block_table.initialize();
 #endif
 
 	// Init cache range invalidate recorder
@@ -303,15 +311,29 @@ void powerpc_cpu::initialize()
 
 #if PPC_PROFILE_COMPILE_TIME
 	compile_count = 0;
+	invalidate_count = 0;
+	invalidate_range_count = 0;
+	invalidate_block_count = 0;
+	trace_count = 0;
+	interpreted_count = 0;
+	promoted_count = 0;
+	evict_count = 0;
+	evict_block_count = 0;
+	retranslate_count = 0;
 	compile_time = 0;
 	emul_start_time = clock();
 #endif
 }
 
 #if PPC_ENABLE_JIT
-void powerpc_cpu::enable_jit(uint32 cache_size)
+void powerpc_cpu::enable_jit(uint32 cache_size, const char *persistent_cache)
 {
 	use_jit = true;
+#if PPC_PERSISTENT_JIT_CACHE
+	// Saved code only runs at the address it was translated for
+	if (persistent_cache)
+		codegen.set_cache_hint(persistent_cache_base(persistent_cache));
+#endif
 	if (cache_size)
 		codegen.set_cache_size(cache_size);
 	codegen.initialize();
@@ -371,6 +393,28 @@ powerpc_cpu::powerpc_cpu(task_struct *parent_task)
 {
 #if PPC_ENABLE_JIT
 	use_jit = false;
+	for (int i = 0; i < basic_jit_cache::MAX_CODE_REGIONS; i++)
+		code_region_generation[i] = 0;
+#if PPC_TIERED_JIT
+	jit_threshold = 0;
+	jit_exit_stub_p = NULL;
+#endif
+#if PPC_BACKGROUND_JIT
+	pthread_mutex_init(&codegen_lock, NULL);
+	pthread_mutex_init(&jit_queue_lock, NULL);
+	pthread_cond_init(&jit_queue_cond, NULL);
+	jit_current_job.bi = NULL;
+	jit_finished_count = 0;
+	jit_thread_active = false;
+	jit_thread_cancel = false;
+#endif
+#if PPC_PERSISTENT_JIT_CACHE
+	use_persistent_cache = false;
+	persistent_identity = 0;
+	persistent_loaded_count = 0;
+	persistent_restored_count = 0;
+	persistent_rejected_count = 0;
+#endif
 #endif
 	spcflags().init();
 	++ppc_refcount;
@@ -380,6 +424,12 @@ powerpc_cpu::powerpc_cpu(task_struct *parent_task)
 powerpc_cpu::~powerpc_cpu()
 {
 	--ppc_refcount;
+#if PPC_BACKGROUND_JIT
+	stop_jit_thread();
+	pthread_cond_destroy(&jit_queue_cond);
+	pthread_mutex_destroy(&jit_queue_lock);
+	pthread_mutex_destroy(&codegen_lock);
+#endif
 #if PPC_PROFILE_COMPILE_TIME
 	clock_t emul_end_time = clock();
 
@@ -401,6 +451,39 @@ powerpc_cpu::~powerpc_cpu()
 		printf("Total %s time : %.1f sec (%.1f%%)\n", type,
 			   double(compile_time) / double(CLOCKS_PER_SEC),
 			   100.0 * double(compile_time) / double(emul_time));
+		printf("Total cache flush count : %d\n", invalidate_count);
+#if PPC_ENABLE_JIT
+		if (use_jit)
+			printf("Total cache region evictions : %d (%d blocks discarded, %d translated again)\n",
+				   evict_count, evict_block_count, retranslate_count);
+#endif
+		printf("Total range flush count : %d (%d blocks discarded)\n",
+			   invalidate_range_count, invalidate_block_count);
+#if PPC_ENABLE_JIT && DYNGEN_DIRECT_BLOCK_CHAINING && PPC_TRACE_BLOCKS
+		printf("Total superblock count : %d\n", trace_count);
+#endif
+#if PPC_ENABLE_JIT
+		if (use_jit) {
+			printf("Total GPR loads : %d (%d dropped, %d turned into moves)\n",
+				   codegen.gpr_load_count, codegen.gpr_load_dropped_count, codegen.gpr_load_moved_count);
+			printf("Total GPR stores : %d (%d dropped)\n",
+				   codegen.gpr_store_count, codegen.gpr_store_dropped_count);
+			printf("Total CR field stores : %d (%d moved to superblock exits)\n",
+				   codegen.crf_store_count, codegen.crf_store_deferred_count);
+		}
+#endif
+#if PPC_ENABLE_JIT && PPC_TIERED_JIT
+		if (use_jit && jit_threshold)
+			printf("Total interpreted block count : %d (%d promoted)\n",
+				   interpreted_count, promoted_count);
+#endif
+#if PPC_ENABLE_JIT && PPC_PERSISTENT_JIT_CACHE
+		if (use_persistent_cache) {
+			printf("Total persistent blocks loaded : %d\n", persistent_loaded_count);
+			printf("Total persistent blocks reused : %d\n", persistent_restored_count);
+			printf("Total persistent blocks stale  : %d\n", persistent_rejected_count);
+		}
+#endif
 		printf("\n");
 	}
 #endif
@@ -562,16 +645,354 @@ void * PF_CONVENTION powerpc_cpu::compile_chain_block(block_info *sbi)
 	sbi = (block_info *)(((uintptr)sbi) & ~3L);
 
 	const uint32 tpc = sbi->li[n].jmp_pc;
-	block_info *tbi = my_block_cache.find(tpc);
+
+	// Don't link from a block that may have been invalidated already
+	bool link = !spcflags().test(SPCFLAG_JIT_EXEC_RETURN);
+#if PPC_TRACE_BLOCKS
+	if (link && profile_trace_branch(sbi, n))
+		link = false;
+#endif
+
+	block_info *tbi = lookup_block(tpc);
+#if PPC_TIERED_JIT
+	// Let the dispatcher interpret the target until it gets hot
+	if (jit_threshold && (tbi == NULL || tbi->di != NULL)) {
+		pc() = tpc;
+		return jit_exit_stub();
+	}
+#endif
 	if (tbi == NULL)
 		tbi = compile_block(tpc);
 	assert(tbi && tbi->pc == tpc);
 
-	dg_set_jmp_target(sbi->li[n].jmp_addr, tbi->entry_point);
+	// Translation may have flushed the cache, including the source block
+	if (link && !spcflags().test(SPCFLAG_JIT_EXEC_RETURN))
+		dg_set_jmp_target(sbi->li[n].jmp_addr, tbi->entry_point);
 	return tbi->entry_point;
 }
 #endif
 
+#if PPC_DECODE_CACHE
+// Predecode a new block at ENTRY into the decode cache
+powerpc_cpu::block_info *powerpc_cpu::predecode_block(uint32 entry)
+{
+#if PPC_EXECUTE_DUMP_STATE
+	const bool dump_state = true;
+#endif
+#if PPC_PROFILE_COMPILE_TIME
+	compile_count++;
+	clock_t start_time;
+	start_time = clock();
+#endif
+#if PPC_TIERED_JIT
+	// Generating the stub may flush all caches, do it first
+	uint8 *entry_point = use_jit ? jit_exit_stub() : NULL;
+#endif
+	block_info *bi = my_block_cache.new_blockinfo();
+	bi->init(entry);
+
+	block_info::decode_info *di;
+	const instr_info_t *ii;
+	uint32 dpc;
+	di = bi->di = decode_cache_p;
+	dpc = entry - 4;
+	do {
+		uint32 opcode = vm_read_memory_4(dpc += 4);
+		bi->add_pc(dpc);
+		ii = decode(opcode);
+#if PPC_EXECUTE_DUMP_STATE
+		if (dump_state) {
+			di->opcode = opcode;
+			di->execute = nv_mem_fun(&powerpc_cpu::dump_instruction);
+			di++;
+		}
+#endif
+#if PPC_FLIGHT_RECORDER
+		if (is_logging()) {
+			di->opcode = opcode;
+			di->execute = nv_mem_fun(&powerpc_cpu::record_step);
+			di++;
+		}
+#endif
+		di->opcode = opcode;
+		di->execute = ii->execute;
+		di++;
+#if PPC_EXECUTE_DUMP_STATE
+		if (dump_state) {
+			di->opcode = 0;
+			di->execute = nv_mem_fun(&powerpc_cpu::fake_dump_registers);
+			di++;
+		}
+#endif
+		if (di >= decode_cache_end_p) {
+			// Invalidate cache and move current code to start
+#if PPC_TIERED_JIT
+			if (use_jit && jit_threshold)
+				flush_predecoded_blocks();
+			else
+#endif
+			invalidate_cache();
+			const int blocklen = di - bi->di;
+			memmove(decode_cache_p, bi->di, blocklen * sizeof(*di));
+			bi->di = decode_cache_p;
+			di = bi->di + blocklen;
+		}
+	} while ((ii->cflow & CFLOW_END_BLOCK) == 0 && bi->can_add_pc(dpc + 4));
+	bi->end_pc = dpc;
+	bi->min_pc = entry;
+	bi->max_pc = dpc;
+	bi->size = di - bi->di;
+	bi->count = 0;
+#if PPC_TIERED_JIT
+	bi->entry_point = entry_point;
+#endif
+	insert_block(bi);
+	decode_cache_p += bi->size;
+#if PPC_PROFILE_COMPILE_TIME
+	compile_time += (clock() - start_time);
+#endif
+	return bi;
+}
+
+inline void powerpc_cpu::execute_predecoded_block(block_info *bi)
+{
+	const int r = bi->size % 4;
+	block_info::decode_info *di = bi->di + r;
+	int n = (bi->size + 3) / 4;
+	switch (r) {
+	case 0: do {
+			di += 4;
+			di[-4].execute(this, di[-4].opcode);
+	case 3: di[-3].execute(this, di[-3].opcode);
+	case 2: di[-2].execute(this, di[-2].opcode);
+	case 1: di[-1].execute(this, di[-1].opcode);
+		} while (--n > 0);
+	}
+}
+#endif
+
+#if PPC_TIERED_JIT
+// Code returning to the dispatcher, entry point of predecoded blocks
+uint8 *powerpc_cpu::jit_exit_stub()
+{
+	while (jit_exit_stub_p == NULL) {
+		lock_codegen();
+		uint8 *entry_point = codegen.basic_dyngen::gen_start();
+		codegen.gen_exec_return();
+		const bool done = codegen.gen_end();
+		unlock_codegen();
+		if (done)
+			jit_exit_stub_p = entry_point;
+		else
+			evict_translation_cache();
+	}
+	return jit_exit_stub_p;
+}
+
+// Replace predecoded block BI with its translation
+powerpc_cpu::block_info *powerpc_cpu::promote_block(block_info *bi)
+{
+	const uint32 entry = bi->pc;
+	my_page_index.remove(bi);
+	discard_block(bi);
+#if PPC_PROFILE_COMPILE_TIME
+	promoted_count++;
+#endif
+	return compile_block(entry);
+}
+
+struct predecoded_block_collector {
+	std::vector< powerpc_cpu::block_info * > & blocks;
+
+	predecoded_block_collector(std::vector< powerpc_cpu::block_info * > & v) : blocks(v) { }
+	void operator()(powerpc_cpu::block_info *bi) {
+		if (bi->di != NULL)
+			blocks.push_back(bi);
+	}
+};
+
+// Discard all predecoded blocks, so that the decode cache can be
+// reused without flushing translated code. Nothing links to them
+void powerpc_cpu::flush_predecoded_blocks()
+{
+	std::vector< block_info * > blocks;
+	predecoded_block_collector collector(blocks);
+	my_block_cache.for_each(collector);
+	for (int i = 0; i < blocks.size(); i++) {
+		my_page_index.remove(blocks[i]);
+		discard_block(blocks[i]);
+	}
+	decode_cache_p = decode_cache;
+}
+#endif
+
+#if PPC_BACKGROUND_JIT
+// Start translating hot blocks in the background
+bool powerpc_cpu::start_jit_thread()
+{
+	if (!use_jit || jit_threshold == 0)
+		return false;
+	if (jit_thread_active)
+		return true;
+	jit_thread_cancel = false;
+	jit_thread_active = (pthread_create(&jit_thread, NULL, jit_thread_func, this) == 0);
+	return jit_thread_active;
+}
+
+// Wait for the worker to terminate, translations not published yet are lost
+void powerpc_cpu::stop_jit_thread()
+{
+	if (!jit_thread_active)
+		return;
+	pthread_mutex_lock(&jit_queue_lock);
+	jit_thread_cancel = true;
+	pthread_cond_signal(&jit_queue_cond);
+	pthread_mutex_unlock(&jit_queue_lock);
+	pthread_join(jit_thread, NULL);
+	jit_thread_active = false;
+	cancel_jit_jobs(0, ~(uintptr)0);
+	publish_jit_blocks();
+}
+
+void *powerpc_cpu::jit_thread_func(void *arg)
+{
+	((powerpc_cpu *)arg)->jit_thread_loop();
+	return NULL;
+}
+
+void powerpc_cpu::jit_thread_loop()
+{
+	pthread_mutex_lock(&jit_queue_lock);
+	for (;;) {
+		while (jit_pending_jobs.empty() && !jit_thread_cancel)
+			pthread_cond_wait(&jit_queue_cond, &jit_queue_lock);
+		if (jit_thread_cancel)
+			break;
+		jit_job job = jit_pending_jobs.front();
+		jit_pending_jobs.pop_front();
+		jit_current_job = job;
+		jit_current_ranges.clear();
+		pthread_mutex_unlock(&jit_queue_lock);
+
+		// Code is emitted past the current translation cache pointer,
+		// nothing can reach it before the block is published
+#if PPC_PROFILE_COMPILE_TIME
+		clock_t start_time = clock();
+#endif
+		lock_codegen();
+		job.status = compile_block(job.bi, job.pc) ? JIT_JOB_DONE : JIT_JOB_FAILED;
+		unlock_codegen();
+#if PPC_PROFILE_COMPILE_TIME
+		job.compile_time = clock() - start_time;
+#endif
+
+		// The pages the block spans are only known now
+		pthread_mutex_lock(&jit_queue_lock);
+		for (int i = 0; i < jit_current_ranges.size() && job.status == JIT_JOB_DONE; i++) {
+			if (job.bi->intersect(jit_current_ranges[i].first, jit_current_ranges[i].second))
+				job.status = JIT_JOB_CANCELLED;
+		}
+		jit_current_job.bi = NULL;
+		jit_finished_jobs.push_back(job);
+		jit_finished_count = jit_finished_jobs.size();
+	}
+	pthread_mutex_unlock(&jit_queue_lock);
+}
+
+// Hand predecoded block BI over to the worker thread. Returns false if
+// it shall be translated right away instead
+bool powerpc_cpu::queue_jit_block(block_info *bi)
+{
+#if PPC_PERSISTENT_JIT_CACHE
+	// Code from a previous session is restored synchronously
+	if (persistent_blocks.find(bi->pc) != persistent_blocks.end())
+		return false;
+#endif
+	jit_job job;
+	job.pc = bi->pc;
+	job.bi = my_block_cache.new_blockinfo();
+	job.status = JIT_JOB_DONE;
+#if PPC_PROFILE_COMPILE_TIME
+	job.compile_time = 0;
+#endif
+	pthread_mutex_lock(&jit_queue_lock);
+	jit_pending_jobs.push_back(job);
+	pthread_cond_signal(&jit_queue_cond);
+	pthread_mutex_unlock(&jit_queue_lock);
+	return true;
+}
+
+// Drop translations of blocks in [START, END), even those in progress.
+// Predecoded blocks that remain get a chance to be queued again
+void powerpc_cpu::cancel_jit_jobs(uintptr start, uintptr end)
+{
+	pthread_mutex_lock(&jit_queue_lock);
+
+	// Pending jobs have not read any code yet, only drop those whose
+	// predecoded block is discarded
+	std::deque< jit_job >::iterator it = jit_pending_jobs.begin();
+	while (it != jit_pending_jobs.end()) {
+		if (it->pc >= start && it->pc < end) {
+			block_info *obi = my_block_table.find(it->pc);
+			if (obi && obi->di != NULL)
+				obi->count = 0;
+			my_block_cache.delete_blockinfo(it->bi);
+			it = jit_pending_jobs.erase(it);
+		}
+		else
+			++it;
+	}
+	// The job in progress is checked once the worker has decoded it
+	if (jit_current_job.bi != NULL)
+		jit_current_ranges.push_back(std::make_pair(start, end));
+
+	// Finished blocks are released on publication
+	for (int i = 0; i < jit_finished_jobs.size(); i++) {
+		jit_job & job = jit_finished_jobs[i];
+		if (job.status == JIT_JOB_DONE && job.bi->intersect(start, end)) {
+			block_info *obi = my_block_table.find(job.pc);
+			if (obi && obi->di != NULL)
+				obi->count = 0;
+			job.status = JIT_JOB_CANCELLED;
+		}
+	}
+
+	pthread_mutex_unlock(&jit_queue_lock);
+}
+
+// Drop unpublished translations whose code lives in REGION
+void powerpc_cpu::cancel_jit_code(int region)
+{
+	pthread_mutex_lock(&jit_queue_lock);
+	for (int i = 0; i < jit_finished_jobs.size(); i++) {
+		jit_job & job = jit_finished_jobs[i];
+		if (job.status == JIT_JOB_DONE && codegen.code_region(job.bi->entry_point) == region) {
+			block_info *obi = my_block_table.find(job.pc);
+			if (obi && obi->di != NULL)
+				obi->count = 0;
+			job.status = JIT_JOB_CANCELLED;
+		}
+	}
+	pthread_mutex_unlock(&jit_queue_lock);
+}
+#endif
+
+#if PPC_ENABLE_JIT
+// Get a new block at ENTRY, predecoded first if it has to get hot
+inline powerpc_cpu::block_info *powerpc_cpu::translate_block(uint32 entry)
+{
+#if PPC_TIERED_JIT
+	if (jit_threshold) {
+#if PPC_PROFILE_COMPILE_TIME
+		interpreted_count++;
+#endif
+		return predecode_block(entry);
+	}
+#endif
+	return compile_block(entry);
+}
+#endif
+
 void powerpc_cpu::execute(uint32 entry)
 {
 	bool invalidated_cache = false;
@@ -584,12 +1005,27 @@ void powerpc_cpu::execute(uint32 entry)
 	if (execute_depth == 1 || (PPC_ENABLE_JIT && PPC_REENTRANT_JIT)) {
 #if PPC_ENABLE_JIT
 		if (use_jit) {
-			block_info *bi = my_block_cache.find(pc());
+			block_info *bi = lookup_block(pc());
 			if (bi == NULL)
-				bi = compile_block(pc());
+				bi = translate_block(pc());
 			for (;;) {
 				// Execute all cached blocks
 				for (;;) {
+#if PPC_TIERED_JIT
+					if (bi->di != NULL) {
+						// Interpret cold blocks, translate them once hot
+						if (++bi->count < jit_threshold)
+							execute_predecoded_block(bi);
+#if PPC_BACKGROUND_JIT
+						// Keep interpreting while the worker translates it
+						else if (jit_thread_active && (bi->count > jit_threshold || queue_jit_block(bi)))
+							execute_predecoded_block(bi);
+#endif
+						else
+							codegen.execute(promote_block(bi)->entry_point);
+					}
+					else
+#endif
 					codegen.execute(bi->entry_point);
 
 					if (!spcflags().empty()) {
@@ -607,96 +1043,28 @@ void powerpc_cpu::execute(uint32 entry)
 					// Don't check for backward branches here as this
 					// is now done by generated code. Besides, we will
 					// get here if the fast cache lookup failed too.
-					if ((bi = my_block_cache.find(pc())) == NULL)
+#if PPC_BACKGROUND_JIT
+					if (jit_finished_count)
+						publish_jit_blocks();
+#endif
+					if ((bi = lookup_block(pc())) == NULL)
 						break;
 				}
 
-				// Compile new block
-				bi = compile_block(pc());
+				// Compile new block, unless it survived a cache eviction
+				if ((bi = lookup_block(pc())) == NULL)
+					bi = translate_block(pc());
 			}
 		}
 #endif
 #if PPC_DECODE_CACHE
-		block_info *bi = my_block_cache.find(pc());
-		if (bi != NULL)
-			goto pdi_execute;
+		block_info *bi = lookup_block(pc());
+		if (bi == NULL)
+			bi = predecode_block(pc());
 		for (;;) {
-#if PPC_PROFILE_COMPILE_TIME
-			compile_count++;
-			clock_t start_time;
-			start_time = clock();
-#endif
-			bi = my_block_cache.new_blockinfo();
-			bi->init(pc());
-
-			// Predecode a new block
-			block_info::decode_info *di;
-			const instr_info_t *ii;
-			uint32 dpc;
-			di = bi->di = decode_cache_p;
-			dpc = pc() - 4;
-			do {
-				uint32 opcode = vm_read_memory_4(dpc += 4);
-				ii = decode(opcode);
-#if PPC_EXECUTE_DUMP_STATE
-				if (dump_state) {
-					di->opcode = opcode;
-					di->execute = nv_mem_fun(&powerpc_cpu::dump_instruction);
-					di++;
-				}
-#endif
-#if PPC_FLIGHT_RECORDER
-				if (is_logging()) {
-					di->opcode = opcode;
-					di->execute = nv_mem_fun(&powerpc_cpu::record_step);
-					di++;
-				}
-#endif
-				di->opcode = opcode;
-				di->execute = ii->execute;
-				di++;
-#if PPC_EXECUTE_DUMP_STATE
-				if (dump_state) {
-					di->opcode = 0;
-					di->execute = nv_mem_fun(&powerpc_cpu::fake_dump_registers);
-					di++;
-				}
-#endif
-				if (di >= decode_cache_end_p) {
-					// Invalidate cache and move current code to start
-					invalidate_cache();
-					const int blocklen = di - bi->di;
-					memmove(decode_cache_p, bi->di, blocklen * sizeof(*di));
-					bi->di = decode_cache_p;
-					di = bi->di + blocklen;
-				}
-			} while ((ii->cflow & CFLOW_END_BLOCK) == 0);
-			bi->end_pc = dpc;
-			bi->min_pc = dpc;
-			bi->max_pc = entry;
-			bi->size = di - bi->di;
-			my_block_cache.add_to_cl_list(bi);
-			my_block_cache.add_to_active_list(bi);
-			decode_cache_p += bi->size;
-#if PPC_PROFILE_COMPILE_TIME
-			compile_time += (clock() - start_time);
-#endif
-
 			// Execute all cached blocks
-		  pdi_execute:
 			for (;;) {
-				const int r = bi->size % 4;
-				di = bi->di + r;
-				int n = (bi->size + 3) / 4;
-				switch (r) {
-				case 0: do {
-						di += 4;
-						di[-4].execute(this, di[-4].opcode);
-				case 3: di[-3].execute(this, di[-3].opcode);
-				case 2: di[-2].execute(this, di[-2].opcode);
-				case 1: di[-1].execute(this, di[-1].opcode);
-					} while (--n > 0);
-				}
+				execute_predecoded_block(bi);
 
 				if (!spcflags().empty()) {
 					if (!check_spcflags())
@@ -710,9 +1078,12 @@ void powerpc_cpu::execute(uint32 entry)
 					}
 				}
 
-				if ((bi->pc != pc()) && ((bi = my_block_cache.find(pc())) == NULL))
+				if ((bi->pc != pc()) && ((bi = lookup_block(pc())) == NULL))
 					break;
 			}
+
+			// Predecode new block
+			bi = predecode_block(pc());
 		}
 #else
 		goto do_interpret;
@@ -789,19 +1160,209 @@ void powerpc_cpu::kill_decode_cache()
 void powerpc_cpu::invalidate_cache()
 {
 	D(bug("Invalidate all cache blocks\n"));
+#if PPC_PROFILE_COMPILE_TIME
+	invalidate_count++;
+#endif
 #if PPC_DECODE_CACHE || PPC_ENABLE_JIT
 	my_block_cache.clear();
 	my_block_cache.initialize();
+	my_page_index.initialize();
+	my_block_table.initialize();
 	spcflags().set(SPCFLAG_JIT_EXEC_RETURN);
 #endif
 #if PPC_ENABLE_JIT
+#if PPC_BACKGROUND_JIT
+	cancel_jit_jobs(0, ~(uintptr)0);
+#endif
+	lock_codegen();
 	codegen.invalidate_cache();
+#if DYNGEN_DIRECT_BLOCK_CHAINING && PPC_TRACE_BLOCKS
+	trace_hints.clear();
+#endif
+	unlock_codegen();
+	for (int i = 0; i < basic_jit_cache::MAX_CODE_REGIONS; i++)
+		code_region_generation[i]++;
+#if PPC_PROFILE_COMPILE_TIME
+	evicted_blocks.clear();
+#endif
+#if PPC_TIERED_JIT
+	jit_exit_stub_p = NULL;
+#endif
+#if PPC_PERSISTENT_JIT_CACHE
+	// Code from a previous session is overwritten from now on
+	persistent_blocks.clear();
+#endif
 #endif
 #if PPC_DECODE_CACHE
 	decode_cache_p = decode_cache;
 #endif
 }
 
+#if PPC_ENABLE_JIT
+struct evicted_block_collector {
+	basic_jit_cache & codegen;
+	int region;
+	std::vector< powerpc_cpu::block_info * > evicted;
+	std::vector< powerpc_cpu::block_info * > kept;
+
+	evicted_block_collector(basic_jit_cache & cg, int r) : codegen(cg), region(r) { }
+	void operator()(powerpc_cpu::block_info *bi) {
+#if PPC_DECODE_CACHE
+		// Predecoded blocks only use the exit stub
+		if (bi->di != NULL)
+			return;
+#endif
+		if (codegen.code_region(bi->entry_point) == region)
+			evicted.push_back(bi);
+		else
+			kept.push_back(bi);
+	}
+};
+
+// Make room in the translation cache, discarding the blocks of the
+// region that follows the current one, i.e. the oldest one
+void powerpc_cpu::evict_translation_cache()
+{
+	const int region_count = codegen.code_regions();
+	if (region_count < 2) {
+		invalidate_cache();
+		return;
+	}
+	const int region = (codegen.code_region(codegen.code_ptr()) + 1) % region_count;
+	D(bug("Evict translation cache region %d [%p - %p]\n", region,
+		  codegen.code_region_start(region), codegen.code_region_end(region)));
+
+	evicted_block_collector collector(codegen, region);
+	my_block_cache.for_each(collector);
+	for (int i = 0; i < collector.evicted.size(); i++) {
+		block_info *bi = collector.evicted[i];
+#if PPC_PROFILE_COMPILE_TIME
+		evicted_blocks.insert(bi->pc);
+#endif
+		my_page_index.remove(bi);
+		discard_block(bi);
+	}
+
+#if DYNGEN_DIRECT_BLOCK_CHAINING
+	// Unlink remaining blocks from any code in the evicted region, be
+	// it a block still in the cache or not (e.g. replaced by a
+	// superblock), they will be resolved again on next use
+	for (int i = 0; i < collector.kept.size(); i++) {
+		block_info *bi = collector.kept[i];
+		for (int j = 0; j < block_info::MAX_TARGETS; j++) {
+			block_info::link_info * const tli = &bi->li[j];
+			if (tli->jmp_pc != block_info::INVALID_PC &&
+				codegen.code_region(dg_get_jmp_target(tli->jmp_addr)) == region)
+				dg_set_jmp_target(tli->jmp_addr, tli->jmp_resolve_addr);
+		}
+	}
+#endif
+
+#if PPC_PERSISTENT_JIT_CACHE
+	// Code from a previous session in that region is overwritten too
+	persistent_block_map::iterator it = persistent_blocks.begin();
+	while (it != persistent_blocks.end()) {
+		const uint8 *entry_point = codegen.code_start_ptr() + it->second.code_offset;
+		if (codegen.code_region(entry_point) == region)
+			persistent_blocks.erase(it++);
+		else
+			++it;
+	}
+#endif
+
+#if PPC_TIERED_JIT
+	// Predecoded blocks enter generated code through the exit stub
+	if (jit_exit_stub_p && codegen.code_region(jit_exit_stub_p) == region) {
+		flush_predecoded_blocks();
+		jit_exit_stub_p = NULL;
+	}
+#endif
+#if PPC_BACKGROUND_JIT
+	cancel_jit_code(region);
+#endif
+
+	lock_codegen();
+	codegen.set_code_region(region);
+	unlock_codegen();
+	code_region_generation[region]++;
+
+	// Generated code may return to an evicted block
+	spcflags().set(SPCFLAG_JIT_EXEC_RETURN);
+#if PPC_PROFILE_COMPILE_TIME
+	if (!collector.evicted.empty())
+		evict_count++;
+	evict_block_count += collector.evicted.size();
+#endif
+}
+#endif
+
+#if PPC_ENABLE_JIT
+void powerpc_cpu::add_perf_code_area(uint32 start, uint32 size)
+{
+	code_area area;
+	area.start = start;
+	area.size = size;
+	perf_code_areas.push_back(area);
+}
+
+// Tell host profilers about a translated block, named after its PowerPC
+// address and the traceback table of the routine it belongs to, if any
+void powerpc_cpu::perf_add_block(powerpc_block_info *bi)
+{
+	char name[96];
+	const int n = snprintf(name, sizeof(name), "ppc_%08x", (uint32)bi->pc);
+	for (int i = 0; i < perf_code_areas.size(); i++) {
+		const code_area & area = perf_code_areas[i];
+		if (bi->pc - area.start >= area.size)
+			continue;
+		char sym[64];
+		uint32 offset;
+		const uint32 end = area.start + area.size;
+		if (jit_perf_traceback_name(vm_do_get_real_address(bi->pc), vm_do_get_real_address(end), sym, sizeof(sym), &offset))
+			snprintf(name + n, sizeof(name) - n, " %s+0x%x", sym, offset);
+		break;
+	}
+	jit_perf_add_code(bi->entry_point, bi->size, name);
+}
+#endif
+
+void powerpc_cpu::insert_block(block_info *bi, bool dormant)
+{
+#if PPC_ENABLE_JIT
+#if PPC_DECODE_CACHE
+	if (jit_perf_enabled && use_jit && bi->di == NULL)
+#else
+	if (jit_perf_enabled && use_jit)
+#endif
+		perf_add_block(bi);
+#endif
+	my_block_cache.add_to_cl_list(bi);
+	my_block_table.add(bi);
+	if (dormant)
+		my_block_cache.add_to_dormant_list(bi);
+	else {
+		my_block_cache.add_to_active_list(bi);
+		my_page_index.add(bi);
+	}
+}
+
+void powerpc_cpu::discard_block(block_info *bi)
+{
+	bi->invalidate();
+	my_block_table.remove(bi);
+	my_block_cache.remove_from_lists(bi);
+	my_block_cache.delete_blockinfo(bi);
+}
+
+struct powerpc_block_discarder {
+	powerpc_cpu *cpu;
+
+	powerpc_block_discarder(powerpc_cpu *the_cpu) : cpu(the_cpu) { }
+	void operator()(powerpc_cpu::block_info *bi) {
+		cpu->discard_block(bi);
+	}
+};
+
 void powerpc_block_info::invalidate()
 {
 #if PPC_DECODE_CACHE
@@ -834,6 +1395,15 @@ void powerpc_cpu::invalidate_cache_range(uintptr start, uintptr end)
 	}
 #endif
 	spcflags().set(SPCFLAG_JIT_EXEC_RETURN);
-	my_block_cache.clear_range(start, end);
+	powerpc_block_discarder discarder(this);
+#if PPC_PROFILE_COMPILE_TIME
+	invalidate_range_count++;
+	invalidate_block_count += my_page_index.clear_range(start, end, discarder);
+#else
+	my_page_index.clear_range(start, end, discarder);
+#endif
+#if PPC_BACKGROUND_JIT
+	cancel_jit_jobs(start, end);
+#endif
 #endif
 }
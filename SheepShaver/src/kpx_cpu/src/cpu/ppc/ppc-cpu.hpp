@@ -34,6 +34,15 @@
 #endif
 #include "cpu/ppc/ppc-instructions.hpp"
 #include <vector>
+#if PPC_PERSISTENT_JIT_CACHE
+#include <map>
+#endif
+#if PPC_BACKGROUND_JIT
+#include <deque>
+#endif
+#if PPC_ENABLE_JIT && PPC_PROFILE_COMPILE_TIME
+#include <set>
+#endif
 
 class powerpc_cpu
 #ifndef SHEEPSHAVER
@@ -203,6 +212,18 @@ private:
 	// Compile time statistics
 #if PPC_PROFILE_COMPILE_TIME
 	uint32 compile_count;
+	uint32 invalidate_count;			// Calls to invalidate_cache()
+	uint32 invalidate_range_count;		// Calls to invalidate_cache_range()
+	uint32 invalidate_block_count;		// Blocks discarded by range invalidations
+	uint32 trace_count;					// Blocks translated again as superblocks
+	uint32 interpreted_count;			// Blocks predecoded until they get hot
+	uint32 promoted_count;				// Predecoded blocks translated afterwards
+	uint32 evict_count;					// Translation cache regions evicted
+	uint32 evict_block_count;			// Blocks discarded by evictions
+	uint32 retranslate_count;			// Evicted blocks translated again
+#if PPC_ENABLE_JIT
+	std::set< uint32 > evicted_blocks;
+#endif
 	clock_t compile_time;
 	clock_t emul_start_time;
 #endif
@@ -333,8 +354,18 @@ protected:
 	virtual int compile1(codegen_context_t & cg_context) { return COMPILE_FAILURE; }
 
 	bool use_jit;
+
+	// Guest areas whose routines end with traceback tables, used to
+	// name translated blocks for host profilers
+	struct code_area {
+		uint32 start;
+		uint32 size;
+	};
+	std::vector< code_area > perf_code_areas;
+	void perf_add_block(powerpc_block_info *bi);
 public:
-	void enable_jit(uint32 cache_size = 0);
+	void enable_jit(uint32 cache_size = 0, const char *persistent_cache = NULL);
+	void add_perf_code_area(uint32 start, uint32 size);
 #endif
 
 private:
@@ -354,6 +385,10 @@ private:
 	// Block lookup table
 	typedef powerpc_block_info block_info;
 	block_cache< block_info, lazy_allocator > my_block_cache;
+	block_info *lookup_block(uint32 pc);
+	void insert_block(block_info *bi, bool dormant = false);
+	void discard_block(block_info *bi);
+	friend struct powerpc_block_discarder;
 
 #if PPC_DECODE_CACHE
 	// Decode Cache
@@ -362,6 +397,8 @@ private:
 	block_info::decode_info * decode_cache;
 	block_info::decode_info * decode_cache_p;
 	block_info::decode_info * decode_cache_end_p;
+	block_info *predecode_block(uint32 entry);
+	void execute_predecoded_block(block_info *bi);
 #endif
 
 #if PPC_ENABLE_JIT
@@ -371,11 +408,127 @@ private:
 	friend class powerpc_jit;
 	powerpc_jit codegen;
 	block_info *compile_block(uint32 entry);
+	bool compile_block(block_info *bi, uint32 entry);
+#if PPC_BACKGROUND_JIT
+	pthread_mutex_t codegen_lock;
+	void lock_codegen()		{ pthread_mutex_lock(&codegen_lock); }
+	void unlock_codegen()	{ pthread_mutex_unlock(&codegen_lock); }
+#else
+	void lock_codegen()		{ }
+	void unlock_codegen()	{ }
+#endif
+	block_info *translate_block(uint32 entry);
+#if PPC_TIERED_JIT
+	// Blocks are interpreted from the decode cache until they get hot.
+	// Their entry point returns to the dispatcher
+	uint32 jit_threshold;
+	uint8 *jit_exit_stub_p;
+	uint8 *jit_exit_stub();
+	block_info *promote_block(block_info *bi);
+	void flush_predecoded_blocks();
+	friend struct predecoded_block_collector;
+public:
+	void set_jit_threshold(uint32 count) { jit_threshold = count; }
+private:
+#if PPC_BACKGROUND_JIT
+	// Hot blocks are translated by a worker thread, the dispatcher
+	// publishes them. Jobs own their block_info until then
+	enum { JIT_JOB_DONE, JIT_JOB_FAILED, JIT_JOB_CANCELLED };
+	struct jit_job {
+		uint32 pc;
+		block_info *bi;
+		int status;
+#if PPC_PROFILE_COMPILE_TIME
+		clock_t compile_time;			// Accounted for on publication
+#endif
+	};
+	std::deque< jit_job > jit_pending_jobs;
+	std::vector< jit_job > jit_finished_jobs;
+	jit_job jit_current_job;
+	std::vector< std::pair< uintptr, uintptr > > jit_current_ranges;	// Invalidated during its translation
+	volatile uint32 jit_finished_count;
+	bool jit_thread_active;
+	bool jit_thread_cancel;
+	pthread_t jit_thread;
+	pthread_mutex_t jit_queue_lock;
+	pthread_cond_t jit_queue_cond;
+	static void *jit_thread_func(void *arg);
+	void jit_thread_loop();
+	bool queue_jit_block(block_info *bi);
+	void publish_jit_blocks();
+	void cancel_jit_jobs(uintptr start, uintptr end);
+	void cancel_jit_code(int region);
+public:
+	bool start_jit_thread();
+	void stop_jit_thread();
+private:
+#endif
+#endif
 	static void call_do_record_step(powerpc_cpu * cpu, uint32 pc, uint32 opcode);
 #if DYNGEN_DIRECT_BLOCK_CHAINING
 	void *compile_chain_block(block_info *sbi);
 	static void * call_compile_chain_block(powerpc_cpu * the_cpu, block_info *sbi);
+#if PPC_TRACE_BLOCKS
+	// Likely side of profiled conditional branches, true if taken
+	static const int TRACE_PROFILE_COUNT = 32;
+	typedef std::map< uint32, bool > trace_hint_map;
+	trace_hint_map trace_hints;
+	bool profile_trace_branch(block_info *sbi, int n);
+	bool trace_overwrites_crf(block_info *bi, uint32 dpc, int crf);
+	friend struct chained_block_relinker;
+#endif
 #endif
+#if PPC_PERSISTENT_JIT_CACHE
+	// Persistent translation cache, blocks are restored on first use
+	struct persistent_block {
+		uint32 pc, end_pc;
+		uint32 min_pc, max_pc;
+		int32 page_count;
+		block_info::page_range pages[block_info::MAX_PAGES];
+		uint64 source_hash;
+		uint32 code_offset;				// Offset of entry point from code start
+		uint32 code_size;
+		int32 reloc_count;
+		block_info::reloc_info reloc[block_info::MAX_RELOCS];
+		uint32 jmp_pc[block_info::MAX_TARGETS];
+		uint32 jmp_offset[block_info::MAX_TARGETS];
+		uint32 jmp_resolve_offset[block_info::MAX_TARGETS];
+	};
+	typedef std::map< uint32, persistent_block > persistent_block_map;
+	persistent_block_map persistent_blocks;
+	bool use_persistent_cache;
+	uint32 persistent_identity;
+	uint32 persistent_loaded_count;
+	uint32 persistent_restored_count;
+	uint32 persistent_rejected_count;
+	block_info *restore_persistent_block(uint32 entry_point);
+	void add_persistent_reloc(block_info *bi, const uint8 *start, uint32 tag);
+	void finish_persistent_block(block_info *bi, uintptr data_pool_p);
+	bool make_persistent_block(const block_info *bi, persistent_block & pb);
+	static uint8 *persistent_cache_base(const char *filename);
+	friend struct persistent_block_collector;
+public:
+	bool load_translation_cache(const char *filename, uint32 identity);
+	bool save_translation_cache(const char *filename);
+private:
+#endif
+#endif
+
+#if PPC_DECODE_CACHE || PPC_ENABLE_JIT
+	// Guest page to blocks index and PC to block table, kept out of
+	// my_block_cache so that the layout seen by generated code doesn't
+	// change
+	block_page_index< block_info > my_page_index;
+	block_lookup_table< block_info > my_block_table;
+#endif
+
+#if PPC_ENABLE_JIT
+	// The translation cache is split into regions, the oldest one is
+	// evicted when it fills up. Generations count region evictions
+	uint32 code_region_generation[basic_jit_cache::MAX_CODE_REGIONS];
+	void evict_translation_cache();
+	void count_retranslation(uint32 entry);
+	friend struct evicted_block_collector;
 #endif
 
 	// Semantic action templates
@@ -500,6 +653,37 @@ private:
 };
 
 
+/**
+ *	Block lookup
+ **/
+
+#if PPC_DECODE_CACHE || PPC_ENABLE_JIT
+inline powerpc_cpu::block_info *powerpc_cpu::lookup_block(uint32 pc)
+{
+	// Hit in the direct-mapped cache, also probed by generated code
+	block_info *bi = my_block_cache.fast_find(pc);
+	if (bi)
+		return bi;
+
+	// Miss: make the block the next one fast_find() will return
+	if ((bi = my_block_table.find(pc)) != NULL)
+		my_block_cache.raise_in_cl_list(bi);
+	return bi;
+}
+#endif
+
+
+#if PPC_ENABLE_JIT
+inline void powerpc_cpu::count_retranslation(uint32 entry)
+{
+#if PPC_PROFILE_COMPILE_TIME
+	if (evicted_blocks.erase(entry))
+		retranslate_count++;
+#endif
+}
+#endif
+
+
 /**
  *	Interrupts handling
  **/
@@ -37,6 +37,18 @@
 powerpc_dyngen::powerpc_dyngen(dyngen_cpu_base cpu)
 	: basic_dyngen(cpu)
 {
+	gpr_cache_reset();
+	crf_cache_end = NULL;
+	crf_store_deferred = false;
+#if PPC_PROFILE_COMPILE_TIME
+	gpr_load_count = 0;
+	gpr_load_dropped_count = 0;
+	gpr_load_moved_count = 0;
+	gpr_store_count = 0;
+	gpr_store_dropped_count = 0;
+	crf_store_count = 0;
+	crf_store_deferred_count = 0;
+#endif
 #ifdef SHEEPSHAVER
 	printf("Detected CPU features:");
 	if (cpuinfo_check_mmx())
@@ -59,18 +71,46 @@ uint8 *powerpc_dyngen::gen_start(uint32 pc)
 {
 	// Generate exit if there are pending spcflags
 	uint8 *p = basic_dyngen::gen_start();
+	gpr_cache_reset();
+	crf_cache_end = NULL;
+	crf_store_deferred = false;
 	gen_op_spcflags_check();
 	gen_op_set_PC_im(pc);
 	gen_exec_return();
 	dg_set_jmp_target_noflush(jmp_addr[0], gen_align());
+	last_body_jmp_addr = jmp_addr[0];
 	jmp_addr[0] = NULL;
 	return p;
 }
 
+// The CR field is committed right away as the next block may need it,
+// but T0 still holds it for a conditional branch that follows
+void powerpc_dyngen::gen_store_T0_crf_cached(int crf)
+{
+#if PPC_PROFILE_COMPILE_TIME
+	crf_store_count++;
+	if (crf_store_deferred)
+		crf_store_deferred_count++;
+#endif
+	if (crf_store_deferred)
+		gen_mov_32_T2_T0();
+	else
+		gen_store_T0_crf(crf);
+	crf_cache = crf;
+	crf_cache_end = code_ptr();
+}
+
+// Same as a compare to zero, so that a branch on cr0 can test T0
+void powerpc_dyngen::gen_record_cr0_T0()
+{
+	gen_op_compare_T0_0();
+	gen_store_T0_crf_cached(0);
+}
+
 void powerpc_dyngen::gen_compare_T0_T1(int crf)
 {
 	gen_op_compare_T0_T1();
-	gen_store_T0_crf(crf);
+	gen_store_T0_crf_cached(crf);
 }
 
 void powerpc_dyngen::gen_compare_T0_im(int crf, int32 value)
@@ -79,13 +119,13 @@ void powerpc_dyngen::gen_compare_T0_im(int crf, int32 value)
 		gen_op_compare_T0_0();
 	else
 		gen_op_compare_T0_im(value);
-	gen_store_T0_crf(crf);
+	gen_store_T0_crf_cached(crf);
 }
 
 void powerpc_dyngen::gen_compare_logical_T0_T1(int crf)
 {
 	gen_op_compare_logical_T0_T1();
-	gen_store_T0_crf(crf);
+	gen_store_T0_crf_cached(crf);
 }
 
 void powerpc_dyngen::gen_compare_logical_T0_im(int crf, int32 value)
@@ -94,7 +134,7 @@ void powerpc_dyngen::gen_compare_logical_T0_im(int crf, int32 value)
 		gen_op_compare_logical_T0_0();
 	else
 		gen_op_compare_logical_T0_im(value);
-	gen_store_T0_crf(crf);
+	gen_store_T0_crf_cached(crf);
 }
 
 void powerpc_dyngen::gen_mtcrf_T0_im(uint32 mask)
@@ -131,8 +171,8 @@ DEFINE_INSN(stmw);
  *		Load/store registers
  **/
 
-#define DEFINE_INSN(OP, REG, REGT)						\
-void powerpc_dyngen::gen_##OP##_##REG##_##REGT(int i)	\
+#define DEFINE_INSN_RAW(NAME, OP, REG, REGT)			\
+void powerpc_dyngen::NAME(int i)						\
 {														\
 	switch (i) {										\
 	case 0: gen_op_##OP##_##REG##_##REGT##0(); break;	\
@@ -171,13 +211,16 @@ void powerpc_dyngen::gen_##OP##_##REG##_##REGT(int i)	\
 	}													\
 }
 
-// General purpose registers
-DEFINE_INSN(load, T0, GPR);
-DEFINE_INSN(load, T1, GPR);
-DEFINE_INSN(load, T2, GPR);
-DEFINE_INSN(store, T0, GPR);
-DEFINE_INSN(store, T1, GPR);
-DEFINE_INSN(store, T2, GPR);
+#define DEFINE_INSN(OP, REG, REGT) \
+	DEFINE_INSN_RAW(gen_##OP##_##REG##_##REGT, OP, REG, REGT)
+
+// General purpose registers, see GPR cache below
+DEFINE_INSN_RAW(do_gen_load_T0_GPR, load, T0, GPR);
+DEFINE_INSN_RAW(do_gen_load_T1_GPR, load, T1, GPR);
+DEFINE_INSN_RAW(do_gen_load_T2_GPR, load, T2, GPR);
+DEFINE_INSN_RAW(do_gen_store_T0_GPR, store, T0, GPR);
+DEFINE_INSN_RAW(do_gen_store_T1_GPR, store, T1, GPR);
+DEFINE_INSN_RAW(do_gen_store_T2_GPR, store, T2, GPR);
 DEFINE_INSN(load, F0, FPR);
 DEFINE_INSN(load, F1, FPR);
 DEFINE_INSN(load, F2, FPR);
@@ -197,6 +240,102 @@ DEFINE_INSN(store, T0, crb);
 DEFINE_INSN(store, T1, crb);
 
 #undef DEFINE_INSN
+#undef DEFINE_INSN_RAW
+
+
+/**
+ *		GPR cache
+ *
+ *		A GPR that was just loaded into or stored from a T register is
+ *		still available there if no other code was generated since.
+ *		This is typically the case when an instruction uses the result
+ *		of the previous one, so the next load of that GPR is either
+ *		omitted or turned into a register move. Stores are never
+ *		deferred, the CPU state is always up-to-date in memory at block
+ *		exits, helper calls and faults.
+ **/
+
+void powerpc_dyngen::gpr_cache_reset()
+{
+	for (int t = 0; t < GPR_CACHE_SIZE; t++)
+		gpr_cache[t] = -1;
+	gpr_cache_end = NULL;
+}
+
+void powerpc_dyngen::gpr_cache_load(int t, int i)
+{
+#if PPC_PROFILE_COMPILE_TIME
+	gpr_load_count++;
+#endif
+	if (gpr_cache_end != code_ptr())
+		gpr_cache_reset();
+	else if (gpr_cache[t] == i) {
+#if PPC_PROFILE_COMPILE_TIME
+		gpr_load_dropped_count++;
+#endif
+		return;
+	}
+
+	int s = 0;
+	while (s < GPR_CACHE_SIZE && gpr_cache[s] != i)
+		s++;
+#if PPC_PROFILE_COMPILE_TIME
+	if (s < GPR_CACHE_SIZE)
+		gpr_load_moved_count++;
+#endif
+
+	switch ((t << 2) | (s < GPR_CACHE_SIZE ? s : 3)) {
+	case (0 << 2) | 1: gen_mov_32_T0_T1(); break;
+	case (0 << 2) | 2: gen_mov_32_T0_T2(); break;
+	case (1 << 2) | 0: gen_mov_32_T1_T0(); break;
+	case (1 << 2) | 2: gen_mov_32_T1_T2(); break;
+	case (2 << 2) | 0: gen_mov_32_T2_T0(); break;
+	case (2 << 2) | 1: gen_mov_32_T2_T1(); break;
+	case (0 << 2) | 3: do_gen_load_T0_GPR(i); break;
+	case (1 << 2) | 3: do_gen_load_T1_GPR(i); break;
+	case (2 << 2) | 3: do_gen_load_T2_GPR(i); break;
+	default: abort();
+	}
+	gpr_cache[t] = i;
+	gpr_cache_end = code_ptr();
+}
+
+void powerpc_dyngen::gpr_cache_store(int t, int i)
+{
+#if PPC_PROFILE_COMPILE_TIME
+	gpr_store_count++;
+#endif
+	if (gpr_cache_end != code_ptr())
+		gpr_cache_reset();
+	else if (gpr_cache[t] == i) {
+#if PPC_PROFILE_COMPILE_TIME
+		gpr_store_dropped_count++;
+#endif
+		return;
+	}
+
+	switch (t) {
+	case 0: do_gen_store_T0_GPR(i); break;
+	case 1: do_gen_store_T1_GPR(i); break;
+	case 2: do_gen_store_T2_GPR(i); break;
+	default: abort();
+	}
+
+	// Other copies of the GPR are stale now
+	for (int s = 0; s < GPR_CACHE_SIZE; s++) {
+		if (gpr_cache[s] == i)
+			gpr_cache[s] = -1;
+	}
+	gpr_cache[t] = i;
+	gpr_cache_end = code_ptr();
+}
+
+void powerpc_dyngen::gen_load_T0_GPR(int i)		{ gpr_cache_load(0, i); }
+void powerpc_dyngen::gen_load_T1_GPR(int i)		{ gpr_cache_load(1, i); }
+void powerpc_dyngen::gen_load_T2_GPR(int i)		{ gpr_cache_load(2, i); }
+void powerpc_dyngen::gen_store_T0_GPR(int i)	{ gpr_cache_store(0, i); }
+void powerpc_dyngen::gen_store_T1_GPR(int i)	{ gpr_cache_store(1, i); }
+void powerpc_dyngen::gen_store_T2_GPR(int i)	{ gpr_cache_store(2, i); }
 
 // Floating point load store
 #define DEFINE_OP(NAME, REG, TYPE)										\
@@ -238,8 +377,17 @@ DEFINE_INSN(store, T0);
 
 void powerpc_dyngen::gen_bc(int bo, int bi, uint32 tpc, uint32 npc, bool direct_chaining)
 {
-	if (BO_CONDITIONAL_BRANCH(bo))
-		gen_load_T1_crb(bi);
+	if (BO_CONDITIONAL_BRANCH(bo)) {
+		// Test the CR bit from T0 if the compare was generated just before
+		if (crf_cache_end == code_ptr() && crf_cache == (bi >> 2)) {
+			gen_and_32_T0_im(8 >> (bi & 3));
+			gen_mov_32_T1_T0();
+			crf_store_deferred = false;
+		}
+		else
+			gen_load_T1_crb(bi);
+	}
+	assert(!crf_store_deferred);
 
 	switch (bo >> 1) {
 #define _(A,B,C,D) (((A) << 3)| ((B) << 2) | ((C) << 1) | (D))
@@ -315,4 +463,81 @@ void powerpc_dyngen::gen_store_vect_VS_T0(int vS)
 	gen_op_store_vect_VD_T0();
 }
 
+
+/**
+ *		Code templates hash
+ **/
+
+// Run every code generator against a scratch buffer, hashing the code
+// templates and constants instead of emitting them
+class powerpc_dyngen_hasher {
+	uint64 hash;
+	uint8 scratch[4096];
+	uint8 *jmp_addr[basic_dyngen::MAX_JUMPS];
+
+	void hash_bytes(const uint8 *p, uint32 size) {
+		while (size-- > 0) {
+			hash ^= *p++;
+			hash *= UVAL64(0x100000001b3);
+		}
+	}
+	void hash_value(unsigned long value) {
+		hash_bytes((const uint8 *)&value, sizeof(value));
+	}
+	uint8 *code_ptr() { return scratch; }
+	void inc_code_ptr(int offset) { }
+	void copy_block(const uint8 *block, uint32 size) {
+		hash_value(size);
+		hash_bytes(block, size);
+	}
+	uint8 *copy_data(const uint8 *block, uint32 size) {
+		copy_block(block, size);
+		return scratch;
+	}
+
+	void call(void (powerpc_dyngen_hasher::*gen)(void))
+		{ (this->*gen)(); }
+	void call(void (powerpc_dyngen_hasher::*gen)(long))
+		{ (this->*gen)(0); }
+	void call(void (powerpc_dyngen_hasher::*gen)(long, long))
+		{ (this->*gen)(0, 0); }
+	void call(void (powerpc_dyngen_hasher::*gen)(long, long, long))
+		{ (this->*gen)(0, 0, 0); }
+	void call(uint8 *(powerpc_dyngen_hasher::*gen)(void))
+		{ (this->*gen)(); }
+
+	// Code generators, defined inline
+#	define DEFINE_GEN(NAME,RET,ARGS) RET NAME ARGS
+#	include "basic-dyngen-ops.hpp"
+#	define DEFINE_GEN(NAME,RET,ARGS) RET NAME ARGS
+#	include "ppc-dyngen-ops.hpp"
+
+public:
+	powerpc_dyngen_hasher() : hash(UVAL64(0xcbf29ce484222325)) { }
+	uint64 run();
+};
+
+uint64 powerpc_dyngen_hasher::run()
+{
+#undef DYNGEN_IMPL
+#define DEFINE_CST(NAME,VALUE) hash_value(VALUE);
+#define DEFINE_GEN(NAME,RET,ARGS) call(&powerpc_dyngen_hasher::NAME);
+#include "basic-dyngen-ops.hpp"
+#define DEFINE_CST(NAME,VALUE) hash_value(VALUE);
+#define DEFINE_GEN(NAME,RET,ARGS) call(&powerpc_dyngen_hasher::NAME);
+#include "ppc-dyngen-ops.hpp"
+#define DYNGEN_IMPL 1
+	return hash;
+}
+
+uint64 powerpc_dyngen::ops_hash()
+{
+	static uint64 hash = 0;
+	if (hash == 0) {
+		powerpc_dyngen_hasher hasher;
+		hash = hasher.run();
+	}
+	return hash;
+}
+
 #endif //ENABLE_DYNGEN
@@ -41,6 +41,30 @@ class powerpc_dyngen
 	powerpc_fpr reg_F3;
 //#endif
 
+	// GPR numbers currently held by T0-T2, only valid while no other
+	// code was generated since the last GPR load or store
+	static const int GPR_CACHE_SIZE = 3;
+	int gpr_cache[GPR_CACHE_SIZE];
+	uint8 *gpr_cache_end;
+	void gpr_cache_reset();
+	void gpr_cache_load(int t, int i);
+	void gpr_cache_store(int t, int i);
+	void do_gen_load_T0_GPR(int i);
+	void do_gen_load_T1_GPR(int i);
+	void do_gen_load_T2_GPR(int i);
+	void do_gen_store_T0_GPR(int i);
+	void do_gen_store_T1_GPR(int i);
+	void do_gen_store_T2_GPR(int i);
+
+	// CR field held by T0 right after a compare, for compare and branch fusion
+	int crf_cache;
+	uint8 *crf_cache_end;
+	bool crf_store_deferred;
+	void gen_store_T0_crf_cached(int crf);
+
+	// Prologue jump to the block body, taken if no spcflags are pending
+	uint8 *last_body_jmp_addr;
+
 	// Code generators for PowerPC synthetic instructions
 #ifndef NO_DEFINE_ALIAS
 #	define DEFINE_GEN(NAME,RET,ARGS) RET NAME ARGS;
@@ -57,8 +81,24 @@ public:
 	// Default constructor
 	powerpc_dyngen(dyngen_cpu_base cpu);
 
+#if PPC_PROFILE_COMPILE_TIME
+	// GPR loads and stores requested, and how many the cache saved
+	uint32 gpr_load_count;
+	uint32 gpr_load_dropped_count;
+	uint32 gpr_load_moved_count;
+	uint32 gpr_store_count;
+	uint32 gpr_store_dropped_count;
+	// CR field stores by compares, and how many were left to side exits
+	uint32 crf_store_count;
+	uint32 crf_store_deferred_count;
+#endif
+
+	// Hash of the code templates, identifies the code generated from them
+	static uint64 ops_hash();
+
 	// Generate prologue
 	uint8 *gen_start(uint32 pc);
+	uint8 *body_jmp_addr() const { return last_body_jmp_addr; }
 
 	// Load/store registers
 	void gen_load_T0_GPR(int i);
@@ -139,13 +179,17 @@ public:
 	DEFINE_ALIAS(jump_next_A0,0);
 
 	// Compare & Record instructions
-	DEFINE_ALIAS(record_cr0_T0,0);
+	void gen_record_cr0_T0();
 	DEFINE_ALIAS(record_cr1,0);
 	void gen_compare_T0_T1(int crf);
 	void gen_compare_T0_im(int crf, int32 value);
 	void gen_compare_logical_T0_T1(int crf);
 	void gen_compare_logical_T0_im(int crf, int32 value);
 
+	// The next compare only copies its CR field to T2, the caller stores
+	// it where the field is still live, i.e. on superblock side exits
+	void defer_crf_store() { crf_store_deferred = true; }
+
 	// Multiply/Divide instructions
 	DEFINE_ALIAS(mulhw_T0_T1,0);
 	DEFINE_ALIAS(mulhwu_T0_T1,0);
@@ -44,6 +44,13 @@
 // Define to enable const branches optimization
 #define FOLLOW_CONST_JUMPS 1
 
+// Define to enable superblocks following the likely side of conditional branches
+#if FOLLOW_CONST_JUMPS && DYNGEN_DIRECT_BLOCK_CHAINING && PPC_TRACE_BLOCKS
+#define FOLLOW_LIKELY_BRANCHES 1
+#else
+#define FOLLOW_LIKELY_BRANCHES 0
+#endif
+
 #if PPC_ENABLE_JIT
 // FIXME: define ROM areas
 static inline bool is_read_only_memory(uintptr addr)
@@ -54,6 +61,16 @@ static inline bool is_read_only_memory(uintptr addr)
 #endif
 	return false;
 }
+
+// Blocks decoded from read-only memory only are never invalidated
+static inline bool is_read_only_block(const powerpc_block_info *bi)
+{
+	for (int i = 0; i < bi->page_count; i++) {
+		if (!is_read_only_memory(bi->pages[i].min_pc))
+			return false;
+	}
+	return true;
+}
 #endif
 
 #if DYNGEN_DIRECT_BLOCK_CHAINING
@@ -147,28 +164,129 @@ powerpc_cpu::call_execute_illegal(powerpc_cpu * cpu, uint32 param1) {
 powerpc_cpu::block_info *
 powerpc_cpu::compile_block(uint32 entry_point)
 {
+#if PPC_PERSISTENT_JIT_CACHE
+	// Reuse code from a previous session if source didn't change
+	if (!persistent_blocks.empty()) {
+		block_info *bi = restore_persistent_block(entry_point);
+		if (bi)
+			return bi;
+	}
+#endif
+
+	for (;;) {
+		block_info *bi = my_block_cache.new_blockinfo();
+#if PPC_PROFILE_COMPILE_TIME
+		compile_count++;
+		clock_t start_time = clock();
+#endif
+		lock_codegen();
+		const bool done = compile_block(bi, entry_point);
+		unlock_codegen();
+#if PPC_PROFILE_COMPILE_TIME
+		compile_time += (clock() - start_time);
+#endif
+		if (done) {
+			insert_block(bi, is_read_only_block(bi));
+			count_retranslation(entry_point);
+			return bi;
+		}
+
+		// Make room and start again
+		my_block_cache.delete_blockinfo(bi);
+		evict_translation_cache();
+	}
+}
+
+#if PPC_BACKGROUND_JIT
+// Replace predecoded blocks with their translation from the worker thread
+void
+powerpc_cpu::publish_jit_blocks()
+{
+	std::vector< jit_job > jobs;
+	pthread_mutex_lock(&jit_queue_lock);
+	jobs.swap(jit_finished_jobs);
+	jit_finished_count = 0;
+	pthread_mutex_unlock(&jit_queue_lock);
+
+	bool full = false;
+	for (int i = 0; i < jobs.size(); i++) {
+		block_info *bi = jobs[i].bi;
+#if PPC_PROFILE_COMPILE_TIME
+		// Compile statistics are only updated by the dispatcher
+		compile_count++;
+		compile_time += jobs[i].compile_time;
+#endif
+		if (jobs[i].status != JIT_JOB_DONE) {
+			// Let the predecoded block get hot again
+			block_info *obi = my_block_table.find(jobs[i].pc);
+			if (obi && obi->di != NULL)
+				obi->count = 0;
+			if (jobs[i].status == JIT_JOB_FAILED)
+				full = true;
+			my_block_cache.delete_blockinfo(bi);
+			continue;
+		}
+
+		// The block may have been translated already, e.g. if the
+		// decode cache was flushed and the block got hot again
+		block_info *obi = my_block_table.find(bi->pc);
+		if (obi && obi->di == NULL) {
+			my_block_cache.delete_blockinfo(bi);
+			continue;
+		}
+		if (obi) {
+			my_page_index.remove(obi);
+			discard_block(obi);
+		}
+		insert_block(bi, is_read_only_block(bi));
+		count_retranslation(bi->pc);
+#if PPC_PROFILE_COMPILE_TIME
+		promoted_count++;
+#endif
+	}
+
+	// The worker ran out of translation cache
+	if (full)
+		evict_translation_cache();
+}
+#endif
+
+// Translate the block at ENTRY_POINT into BI, without registering it.
+// Returns false if the translation cache is full. This only uses the
+// code generator, which may run in the background JIT thread
+bool
+powerpc_cpu::compile_block(block_info *bi, uint32 entry_point)
+{
 #if DEBUG
 	bool disasm = false;
 #else
 	const bool disasm = false;
 #endif
 
-#if PPC_PROFILE_COMPILE_TIME
-	compile_count++;
-	clock_t start_time = clock();
-#endif
-
 	powerpc_jit & dg = codegen;
 	codegen_context_t cg_context(dg);
 	cg_context.entry_point = entry_point;
-  again:
-	block_info *bi = my_block_cache.new_blockinfo();
 	bi->init(entry_point);
 	bi->entry_point = dg.gen_start(entry_point);
+#if PPC_PERSISTENT_JIT_CACHE
+	const uintptr data_pool_p = dg.data_pool_ptr();
+#endif
 
 	// Direct block chaining support variables
 	bool use_direct_block_chaining = false;
 
+#if FOLLOW_LIKELY_BRANCHES
+	// Superblock side exits, i.e. the unlikely side of followed branches
+	bi->body_jmp_addr = dg.body_jmp_addr();
+	struct {
+		uint8 *jmp_addr;
+		uint32 pc;
+		int crf;						// CR field to store from T2, if any
+	} trace_exits[block_info::MAX_TRACE_EXITS];
+	int n_trace_exits = 0;
+	int trace_crf = -1;
+#endif
+
 	int compile_status;
 	uint32 dpc = entry_point - 4;
 	uint32 min_pc, max_pc;
@@ -177,6 +295,22 @@ powerpc_cpu::compile_block(uint32 entry_point)
 	uint32 sync_pc_offset = 0;
 	bool done_compile = false;
 	while (!done_compile) {
+		// End the block with a jump if the next instruction is in a
+		// page too many for the page index to find it
+		if (!bi->add_pc(dpc + 4)) {
+			const uint32 npc = dpc + 4;
+#if DYNGEN_DIRECT_BLOCK_CHAINING
+			if (direct_chaining_possible(bi->pc, npc)) {
+				use_direct_block_chaining = true;
+				bi->li[0].jmp_pc = npc;
+			}
+#endif
+			dg.gen_bc(BO_MAKE(0,0,0,0), 0, npc, 0, use_direct_block_chaining);
+			compile_status = COMPILE_CODE_OK;
+			if (dg.full_translation_cache())
+				return false;
+			break;
+		}
 		uint32 opcode = vm_read_memory_4(dpc += 4);
 		const instr_info_t *ii = decode(opcode);
 		if (ii->cflow & CFLOW_END_BLOCK)
@@ -527,6 +661,30 @@ powerpc_cpu::compile_block(uint32 entry_point)
 #endif
 			const uint32 tpc = ((AA_field::test(opcode) ? 0 : dpc) + operand_BD::get(this, opcode)) & -4;
 			const uint32 npc = dpc + 4;
+#if FOLLOW_LIKELY_BRANCHES
+			// Continue with the likely side, if known, the other side
+			// jumps to a stub that leaves the superblock
+			trace_hint_map::const_iterator th;
+			if (n_trace_exits < block_info::MAX_TRACE_EXITS &&
+				(th = trace_hints.find(dpc)) != trace_hints.end()) {
+				const bool taken = th->second;
+				const uint32 hpc = taken ? tpc : npc;
+				if (hpc != entry_point && direct_chaining_possible(bi->pc, hpc) && bi->can_add_pc(hpc)) {
+					if (LK_field::test(opcode))
+						dg.gen_store_im_LR(npc);
+					dg.gen_bc(bo, BI_field::extract(opcode), tpc, npc, true);
+					trace_exits[n_trace_exits].jmp_addr = dg.jmp_addr[taken ? 1 : 0];
+					trace_exits[n_trace_exits].pc = taken ? npc : tpc;
+					trace_exits[n_trace_exits].crf = trace_crf;
+					trace_crf = -1;
+					n_trace_exits++;
+					dg_set_jmp_target_noflush(dg.jmp_addr[taken ? 0 : 1], dg.code_ptr());
+					op.jmp.target = hpc;
+					goto do_const_jump;
+				}
+			}
+			assert(trace_crf < 0);
+#endif
 #if DYNGEN_DIRECT_BLOCK_CHAINING
 			// Use direct block chaining for in-page jumps or jumps to ROM area
 			if (direct_chaining_possible(bi->pc, tpc)) {
@@ -567,6 +725,10 @@ powerpc_cpu::compile_block(uint32 entry_point)
 		{
 #if FOLLOW_CONST_JUMPS
 		  do_const_jump:
+			if (dpc < min_pc)
+				min_pc = dpc;
+			else if (dpc > max_pc)
+				max_pc = dpc;
 			sync_pc = dpc = op.jmp.target - 4;
 			sync_pc_offset = 0;
 			if (dpc < min_pc)
@@ -603,29 +765,37 @@ powerpc_cpu::compile_block(uint32 entry_point)
 			break;
 		}
 		case PPC_I(CMP):		// Compare
-		{
-			dg.gen_load_T0_GPR(rA_field::extract(opcode));
-			dg.gen_load_T1_GPR(rB_field::extract(opcode));
-			dg.gen_compare_T0_T1(crfD_field::extract(opcode));
-			break;
-		}
 		case PPC_I(CMPI):		// Compare Immediate
-		{
-			dg.gen_load_T0_GPR(rA_field::extract(opcode));
-			dg.gen_compare_T0_im(crfD_field::extract(opcode), operand_SIMM::get(this, opcode));
-			break;
-		}
 		case PPC_I(CMPL):		// Compare Logical
-		{
-			dg.gen_load_T0_GPR(rA_field::extract(opcode));
-			dg.gen_load_T1_GPR(rB_field::extract(opcode));
-			dg.gen_compare_logical_T0_T1(crfD_field::extract(opcode));
-			break;
-		}
 		case PPC_I(CMPLI):		// Compare Logical Immediate
 		{
+			const int crf = crfD_field::extract(opcode);
+#if FOLLOW_LIKELY_BRANCHES
+			// The CR field only needs to be stored on the way out of
+			// the superblock if the likely side overwrites it at once
+			if (n_trace_exits < block_info::MAX_TRACE_EXITS &&
+				trace_overwrites_crf(bi, dpc, crf)) {
+				dg.defer_crf_store();
+				trace_crf = crf;
+			}
+#endif
 			dg.gen_load_T0_GPR(rA_field::extract(opcode));
-			dg.gen_compare_logical_T0_im(crfD_field::extract(opcode), operand_UIMM::get(this, opcode));
+			switch (ii->mnemo) {
+			case PPC_I(CMP):
+				dg.gen_load_T1_GPR(rB_field::extract(opcode));
+				dg.gen_compare_T0_T1(crf);
+				break;
+			case PPC_I(CMPI):
+				dg.gen_compare_T0_im(crf, operand_SIMM::get(this, opcode));
+				break;
+			case PPC_I(CMPL):
+				dg.gen_load_T1_GPR(rB_field::extract(opcode));
+				dg.gen_compare_logical_T0_T1(crf);
+				break;
+			case PPC_I(CMPLI):
+				dg.gen_compare_logical_T0_im(crf, operand_UIMM::get(this, opcode));
+				break;
+			}
 			break;
 		}
 		case PPC_I(CRAND):		// Condition Register AND
@@ -768,9 +938,9 @@ powerpc_cpu::compile_block(uint32 entry_point)
 				dg.gen_nego_T0();
 			else
 				dg.gen_neg_32_T0();
+			dg.gen_store_T0_GPR(rD_field::extract(opcode));
 			if (Rc_field::test(opcode))
 				dg.gen_record_cr0_T0();
-			dg.gen_store_T0_GPR(rD_field::extract(opcode));
 			break;
 		}
 		case PPC_I(MFCR):		// Move from Condition Register
@@ -877,9 +1047,9 @@ powerpc_cpu::compile_block(uint32 entry_point)
 				default: abort();
 				}
 			}
+			dg.gen_store_T0_GPR(rD_field::extract(opcode));
 			if (Rc_field::test(opcode))
 				dg.gen_record_cr0_T0();
-			dg.gen_store_T0_GPR(rD_field::extract(opcode));
 			break;
 		}
 		case PPC_I(ADDIC):		// Add Immediate Carrying
@@ -894,7 +1064,6 @@ powerpc_cpu::compile_block(uint32 entry_point)
 				break;
 			case PPC_I(ADDIC_):
 				dg.gen_addc_T0_im(val);
-				dg.gen_record_cr0_T0();
 				break;
 			case PPC_I(SUBFIC):
 				dg.gen_subfc_T0_im(val);
@@ -902,6 +1071,8 @@ powerpc_cpu::compile_block(uint32 entry_point)
 			default: abort();
 			}
 			dg.gen_store_T0_GPR(rD_field::extract(opcode));
+			if (ii->mnemo == PPC_I(ADDIC_))
+				dg.gen_record_cr0_T0();
 			break;
 		}
 		case PPC_I(ADDME):		// Add to Minus One Extended
@@ -928,9 +1099,9 @@ powerpc_cpu::compile_block(uint32 entry_point)
 				default: abort();
 				}
 			}
+			dg.gen_store_T0_GPR(rD_field::extract(opcode));
 			if (Rc_field::test(opcode))
 				dg.gen_record_cr0_T0();
-			dg.gen_store_T0_GPR(rD_field::extract(opcode));
 			break;
 		}
 		case PPC_I(ADDI):		// Add Immediate
@@ -1536,6 +1707,11 @@ powerpc_cpu::compile_block(uint32 entry_point)
 			cg_context.instr_info = ii;
 			cg_context.done_compile = done_compile;
 			compile_status = compile1(cg_context);
+#if PPC_PERSISTENT_JIT_CACHE
+			// Target specific code may depend on more than the source instructions
+			if (compile_status != COMPILE_FAILURE)
+				bi->reloc_count = -1;
+#endif
 			switch (compile_status) {
 			case COMPILE_FAILURE:
 			case COMPILE_EPILOGUE_OK:
@@ -1554,11 +1730,8 @@ powerpc_cpu::compile_block(uint32 entry_point)
 			done_compile = cg_context.done_compile;
 		}
 		}
-		if (dg.full_translation_cache()) {
-			// Invalidate cache and start again
-			invalidate_cache();
-			goto again;
-		}
+		if (dg.full_translation_cache())
+			return false;
 	}
 	// Do nothing if block has special epilogue code generated already
 	assert(compile_status != COMPILE_FAILURE);
@@ -1567,7 +1740,13 @@ powerpc_cpu::compile_block(uint32 entry_point)
 		// there are pending spcflags, i.e. get out of this block
 		if (!use_direct_block_chaining) {
 			// TODO: optimize this to a direct jump to pregenerated code?
+#if PPC_PERSISTENT_JIT_CACHE
+			const uint8 *reloc_p = dg.code_ptr();
+#endif
 			dg.gen_mov_ad_A0_im((uintptr)bi);
+#if PPC_PERSISTENT_JIT_CACHE
+			add_persistent_reloc(bi, reloc_p, 0);
+#endif
 			dg.gen_jump_next_A0();
 		}
 		dg.gen_exec_return();
@@ -1589,6 +1768,9 @@ powerpc_cpu::compile_block(uint32 entry_point)
 			if (bi->li[i].jmp_pc != block_info::INVALID_PC) {
 				uint8 *p = dg.gen_align(16);
 				dg.gen_mov_ad_A0_im(((uintptr)bi) | i);
+#if PPC_PERSISTENT_JIT_CACHE
+				add_persistent_reloc(bi, p, i);
+#endif
 				dg.gen_invoke_CPU_A0_ret_A0(func);
 				dg.gen_jmp_A0();
 				assert(dg.jmp_addr[i] != NULL);
@@ -1600,19 +1782,510 @@ powerpc_cpu::compile_block(uint32 entry_point)
 	}
 #endif
 
+#if FOLLOW_LIKELY_BRANCHES
+	// Generate side exits, they look up the next block like any
+	// block without direct chaining would do
+	for (int i = 0; i < n_trace_exits; i++) {
+		uint8 *p = dg.gen_align(16);
+		if (trace_exits[i].crf >= 0) {
+			dg.gen_mov_32_T0_T2();
+			dg.gen_store_T0_crf(trace_exits[i].crf);
+		}
+		dg.gen_set_PC_im(trace_exits[i].pc);
+		dg.gen_mov_ad_A0_im((uintptr)bi);
+#if PPC_PERSISTENT_JIT_CACHE
+		add_persistent_reloc(bi, p, 0);
+#endif
+		dg.gen_jump_next_A0();
+		dg.gen_exec_return();
+		dg_set_jmp_target_noflush(trace_exits[i].jmp_addr, p);
+	}
+	bi->trace_exits = n_trace_exits;
+#endif
+
 	bi->size = dg.code_ptr() - bi->entry_point;
+#if PPC_PERSISTENT_JIT_CACHE
+	finish_persistent_block(bi, data_pool_p);
+#endif
 	if (disasm)
 		disasm_translation(entry_point, dpc - entry_point + 4, bi->entry_point, bi->size);
 
 	dg.gen_end();
-	my_block_cache.add_to_cl_list(bi);
-	if (is_read_only_memory(bi->pc))
-		my_block_cache.add_to_dormant_list(bi);
+	return true;
+}
+
+#if FOLLOW_LIKELY_BRANCHES
+// Returns TRUE if the CR field CRF set at DPC is only tested by the
+// next instruction, a branch that superblock BI follows to a compare
+// into the same CR field
+bool powerpc_cpu::trace_overwrites_crf(block_info *bi, uint32 dpc, int crf)
+{
+#if PPC_FLIGHT_RECORDER
+	// Recorded steps would see the stale CR field
+	if (is_logging())
+		return false;
+#endif
+	// The branch and its likely side must be in pages the block has room for
+	if (((dpc ^ (dpc + 4)) >> 12) != 0)
+		return false;
+	const uint32 bc_opcode = vm_read_memory_4(dpc + 4);
+	if (decode(bc_opcode)->mnemo != PPC_I(BC) || LK_field::test(bc_opcode))
+		return false;
+	const int bo = BO_field::extract(bc_opcode);
+	if (!BO_CONDITIONAL_BRANCH(bo) || (BI_field::extract(bc_opcode) >> 2) != crf)
+		return false;
+	trace_hint_map::const_iterator th = trace_hints.find(dpc + 4);
+	if (th == trace_hints.end())
+		return false;
+	const uint32 tpc = ((AA_field::test(bc_opcode) ? 0 : dpc + 4) + operand_BD::get(this, bc_opcode)) & -4;
+	const uint32 hpc = th->second ? tpc : dpc + 8;
+	if (hpc == bi->pc || !direct_chaining_possible(bi->pc, hpc) || !bi->can_add_pc(hpc))
+		return false;
+	const uint32 opcode = vm_read_memory_4(hpc);
+	switch (decode(opcode)->mnemo) {
+	case PPC_I(CMP):
+	case PPC_I(CMPI):
+	case PPC_I(CMPL):
+	case PPC_I(CMPLI):
+		return crfD_field::extract(opcode) == crf;
+	}
+	return false;
+}
+
+// Repoint blocks chained to the code of a replaced block
+struct chained_block_relinker {
+	uint8 *old_entry;
+	uint8 *new_entry;
+
+	chained_block_relinker(uint8 *o, uint8 *n) : old_entry(o), new_entry(n) { }
+	void operator()(powerpc_cpu::block_info *bi) {
+#if PPC_DECODE_CACHE
+		if (bi->di != NULL)
+			return;
+#endif
+		for (int i = 0; i < powerpc_cpu::block_info::MAX_TARGETS; i++) {
+			powerpc_cpu::block_info::link_info * const tli = &bi->li[i];
+			if (tli->jmp_pc != powerpc_cpu::block_info::INVALID_PC &&
+				dg_get_jmp_target(tli->jmp_addr) == old_entry)
+				dg_set_jmp_target(tli->jmp_addr, new_entry);
+		}
+	}
+};
+
+// Count executions of side N of the two-way branch ending SBI. Returns
+// true if the branch shall not be linked yet, or if SBI was replaced
+bool powerpc_cpu::profile_trace_branch(block_info *sbi, int n)
+{
+	if (sbi->li[1].jmp_pc == block_info::INVALID_PC ||
+		sbi->body_jmp_addr == NULL || sbi->trace_exits >= block_info::MAX_TRACE_EXITS)
+		return false;
+
+	sbi->branch_count[n]++;
+	const int count = sbi->branch_count[0] + sbi->branch_count[1];
+	if (count < TRACE_PROFILE_COUNT)
+		return true;
+	if (count > TRACE_PROFILE_COUNT)
+		return false;
+
+	// Side 0 is the branch target, side 1 the next instruction
+	int hot;
+	if (sbi->branch_count[0] * 8 >= count * 7)
+		hot = 0;
+	else if (sbi->branch_count[1] * 8 >= count * 7)
+		hot = 1;
 	else
-		my_block_cache.add_to_active_list(bi);
+		return false;
+	const uint32 hpc = sbi->li[hot].jmp_pc;
+	if (hpc == sbi->pc || !direct_chaining_possible(sbi->pc, hpc))
+		return false;
+	lock_codegen();
+	const bool new_hint = trace_hints.insert(trace_hint_map::value_type(sbi->end_pc, hot == 0)).second;
+	unlock_codegen();
+	if (!new_hint)
+		return false;
+
+	// Translate again, then redirect the old block and the blocks
+	// chained to it to the superblock, unless its code was evicted in
+	// the meantime
+	const int region = codegen.code_region(sbi->entry_point);
+	const uint32 generation = code_region_generation[region];
+	block_info *nbi = compile_block(sbi->pc);
+	if (code_region_generation[region] != generation)
+		return true;
+	dg_set_jmp_target(sbi->body_jmp_addr, nbi->entry_point);
+	chained_block_relinker relinker(sbi->entry_point, nbi->entry_point);
+	my_block_cache.for_each(relinker);
+	my_page_index.remove(sbi);
+	my_block_table.remove(sbi);
+	my_block_cache.remove_from_lists(sbi);
+	my_block_cache.delete_blockinfo(sbi);
 #if PPC_PROFILE_COMPILE_TIME
-	compile_time += (clock() - start_time);
+	trace_count++;
+#endif
+	return true;
+}
+#endif
+#endif
+
+
+/**
+ *		Persistent translation cache
+ **/
+
+#if PPC_ENABLE_JIT && PPC_PERSISTENT_JIT_CACHE
+
+// Don't save blocks spanning more than this number of source bytes
+static const uint32 PERSISTENT_MAX_SOURCE_SIZE = 65536;
+
+static const char persistent_cache_magic[8] = { 'K', 'P', 'X', 'J', 'I', 'T', 'C', '\n' };
+static const uint32 PERSISTENT_CACHE_VERSION = 3;
+
+struct persistent_cache_header {
+	char	magic[8];
+	uint32	version;
+	uint32	identity;					// Guest identity, e.g. ROM checksum
+	uint64	build_id;					// Host executable identity
+	uint64	mem_base;					// Host address of guest address 0
+	uint64	cache_base;					// Translation cache base address
+	uint32	prologue_size;				// Size of code generated before user code start
+	uint32	code_size;					// Size of translated code
+	uint32	block_count;
+	uint32	block_size;					// sizeof(powerpc_cpu::persistent_block)
+};
+
+// 64-bit FNV-1a hash
+static inline uint64 persistent_hash(uint64 h, const uint8 *p, uint32 size)
+{
+	while (size-- > 0) {
+		h ^= *p++;
+		h *= UVAL64(0x100000001b3);
+	}
+	return h;
+}
+
+static const uint64 PERSISTENT_HASH_INIT = UVAL64(0xcbf29ce484222325);
+
+// Hash source instructions in [min_pc, max_pc], 0 if too large
+static uint64 persistent_source_hash(uint32 min_pc, uint32 max_pc)
+{
+	if (max_pc < min_pc || max_pc - min_pc >= PERSISTENT_MAX_SOURCE_SIZE)
+		return 0;
+	uint64 h = persistent_hash(PERSISTENT_HASH_INIT, vm_do_get_real_address(min_pc), max_pc - min_pc + 4);
+	return h ? h : 1;
+}
+
+// Translated code embeds absolute and relative host addresses, only
+// reuse it with the very same executable, code templates and host ABI
+static uint64 persistent_build_id(void)
+{
+	static const char build_date[] = __DATE__ " " __TIME__;
+	uint64 h = persistent_hash(PERSISTENT_HASH_INIT, (const uint8 *)build_date, sizeof(build_date));
+#ifdef __VERSION__
+	static const char compiler[] = __VERSION__;
+	h = persistent_hash(h, (const uint8 *)compiler, sizeof(compiler));
+#endif
+	const uint64 layout[] = {
+		(uintptr)&persistent_build_id,
+		(uintptr)persistent_cache_magic,
+		powerpc_dyngen::ops_hash(),
+		sizeof(void *),
+		sizeof(long),
+#ifdef WORDS_BIGENDIAN
+		1,
+#else
+		0,
+#endif
+		sizeof(powerpc_cpu),
+		sizeof(powerpc_block_info)
+	};
+	return persistent_hash(h, (const uint8 *)layout, sizeof(layout));
+}
+
+// Translation cache base a persistent cache was saved with, NULL if none
+uint8 *powerpc_cpu::persistent_cache_base(const char *filename)
+{
+	FILE *fp = fopen(filename, "rb");
+	if (fp == NULL)
+		return NULL;
+
+	persistent_cache_header header;
+	const bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+		memcmp(header.magic, persistent_cache_magic, sizeof(header.magic)) == 0 &&
+		header.version == PERSISTENT_CACHE_VERSION;
+	fclose(fp);
+	return ok ? (uint8 *)(uintptr)header.cache_base : NULL;
+}
+
+void powerpc_cpu::add_persistent_reloc(block_info *bi, const uint8 *start, uint32 tag)
+{
+	if (!use_persistent_cache || bi->reloc_count < 0)
+		return;
+
+	// Locate the block_info pointer that was just emitted
+	const uintptr value = ((uintptr)bi) | tag;
+	const uint8 *end = codegen.code_ptr();
+	const uint8 *found = NULL;
+	for (const uint8 *p = start; p + sizeof(value) <= end; p++) {
+		if (memcmp(p, &value, sizeof(value)) == 0) {
+			if (found) {
+				found = NULL;
+				break;
+			}
+			found = p;
+		}
+	}
+
+	// Give up if the host encodes the immediate in pieces
+	if (found == NULL || bi->reloc_count >= block_info::MAX_RELOCS) {
+		bi->reloc_count = -1;
+		return;
+	}
+	bi->reloc[bi->reloc_count].offset = found - bi->entry_point;
+	bi->reloc[bi->reloc_count].tag = tag;
+	bi->reloc_count++;
+}
+
+void powerpc_cpu::finish_persistent_block(block_info *bi, uintptr data_pool_p)
+{
+	if (!use_persistent_cache)
+		return;
+
+	// Constant pool data lives outside of the translation cache and
+	// is not saved, it can also be shared with earlier blocks
+	if (codegen.data_pool_ptr() != data_pool_p ||
+		codegen.references_data(bi->entry_point, codegen.code_ptr()))
+		bi->reloc_count = -1;
+
+	if (bi->reloc_count >= 0)
+		bi->source_hash = persistent_source_hash(bi->min_pc, bi->max_pc);
+	if (bi->source_hash == 0)
+		bi->reloc_count = -1;
+}
+
+bool powerpc_cpu::make_persistent_block(const block_info *bi, persistent_block & pb)
+{
+	uint8 * const code_start = codegen.code_start_ptr();
+#if PPC_TIERED_JIT
+	if (bi->di != NULL)
+		return false;
+#endif
+	if (bi->reloc_count < 0 || bi->entry_point < code_start || bi->entry_point + bi->size > codegen.code_limit_ptr())
+		return false;
+
+	memset(&pb, 0, sizeof(pb));
+	pb.pc = bi->pc;
+	pb.end_pc = bi->end_pc;
+	pb.min_pc = bi->min_pc;
+	pb.max_pc = bi->max_pc;
+	pb.page_count = bi->page_count;
+	for (int i = 0; i < bi->page_count; i++)
+		pb.pages[i] = bi->pages[i];
+	pb.source_hash = bi->source_hash;
+	pb.code_offset = bi->entry_point - code_start;
+	pb.code_size = bi->size;
+	pb.reloc_count = bi->reloc_count;
+	for (int i = 0; i < bi->reloc_count; i++)
+		pb.reloc[i] = bi->reloc[i];
+	for (int i = 0; i < block_info::MAX_TARGETS; i++) {
+#if DYNGEN_DIRECT_BLOCK_CHAINING
+		pb.jmp_pc[i] = bi->li[i].jmp_pc;
+		if (pb.jmp_pc[i] != block_info::INVALID_PC) {
+			pb.jmp_offset[i] = bi->li[i].jmp_addr - bi->entry_point;
+			pb.jmp_resolve_offset[i] = bi->li[i].jmp_resolve_addr - bi->entry_point;
+		}
+#else
+		pb.jmp_pc[i] = 0xffffffff;
 #endif
+	}
+	return true;
+}
+
+powerpc_cpu::block_info *
+powerpc_cpu::restore_persistent_block(uint32 entry_point)
+{
+	persistent_block_map::iterator it = persistent_blocks.find(entry_point);
+	if (it == persistent_blocks.end())
+		return NULL;
+
+	// Source instructions changed since the block was translated
+	const persistent_block pb = it->second;
+	persistent_blocks.erase(it);
+	if (persistent_source_hash(pb.min_pc, pb.max_pc) != pb.source_hash) {
+		persistent_rejected_count++;
+		return NULL;
+	}
+
+	block_info *bi = my_block_cache.new_blockinfo();
+	bi->init(pb.pc);
+	bi->end_pc = pb.end_pc;
+	bi->min_pc = pb.min_pc;
+	bi->max_pc = pb.max_pc;
+	bi->page_count = pb.page_count;
+	for (int i = 0; i < pb.page_count; i++)
+		bi->pages[i] = pb.pages[i];
+	bi->size = pb.code_size;
+	bi->entry_point = codegen.code_start_ptr() + pb.code_offset;
+	bi->source_hash = pb.source_hash;
+	bi->reloc_count = pb.reloc_count;
+	for (int i = 0; i < pb.reloc_count; i++) {
+		bi->reloc[i] = pb.reloc[i];
+		const uintptr value = ((uintptr)bi) | pb.reloc[i].tag;
+		memcpy(bi->entry_point + pb.reloc[i].offset, &value, sizeof(value));
+	}
+#if DYNGEN_DIRECT_BLOCK_CHAINING
+	// Chained targets will be resolved again on first use
+	for (int i = 0; i < block_info::MAX_TARGETS; i++) {
+		bi->li[i].jmp_pc = pb.jmp_pc[i];
+		if (pb.jmp_pc[i] != block_info::INVALID_PC) {
+			bi->li[i].jmp_addr = bi->entry_point + pb.jmp_offset[i];
+			bi->li[i].jmp_resolve_addr = bi->entry_point + pb.jmp_resolve_offset[i];
+			dg_set_jmp_target_noflush(bi->li[i].jmp_addr, bi->li[i].jmp_resolve_addr);
+		}
+	}
+#endif
+	flush_icache_range((unsigned long)bi->entry_point, (unsigned long)(bi->entry_point + bi->size));
+
+	insert_block(bi, is_read_only_block(bi));
+	persistent_restored_count++;
 	return bi;
 }
+
+bool powerpc_cpu::load_translation_cache(const char *filename, uint32 identity)
+{
+	use_persistent_cache = use_jit;
+	persistent_identity = identity;
+	if (!use_persistent_cache)
+		return false;
+
+	FILE *fp = fopen(filename, "rb");
+	if (fp == NULL)
+		return false;
+
+	uint8 * const cache_base = codegen.cache_base();
+	uint8 * const code_start = codegen.code_start_ptr();
+	const uint32 prologue_size = code_start - cache_base;
+
+	bool ok = false;
+	std::vector<uint8> prologue, image;
+	std::vector<persistent_block> blocks;
+	persistent_cache_header header;
+	if (fread(&header, sizeof(header), 1, fp) != 1)
+		goto out;
+	if (memcmp(header.magic, persistent_cache_magic, sizeof(header.magic)) != 0 ||
+		header.version != PERSISTENT_CACHE_VERSION ||
+		header.block_size != sizeof(persistent_block)) {
+		D(bug("Persistent cache %s: invalid format\n", filename));
+		goto out;
+	}
+	if (header.identity != identity || header.build_id != persistent_build_id()) {
+		D(bug("Persistent cache %s: created by another build or guest\n", filename));
+		goto out;
+	}
+	if (header.mem_base != (uintptr)vm_do_get_real_address(0)) {
+		D(bug("Persistent cache %s: guest memory moved to %p\n", filename, vm_do_get_real_address(0)));
+		goto out;
+	}
+	if (header.cache_base != (uintptr)cache_base || header.prologue_size != prologue_size) {
+		D(bug("Persistent cache %s: translation cache moved to %p\n", filename, cache_base));
+		goto out;
+	}
+
+	// Code generated at initialization time must be the same
+	prologue.resize(prologue_size);
+	if (prologue_size && fread(&prologue[0], prologue_size, 1, fp) != 1)
+		goto out;
+	if (prologue_size && memcmp(&prologue[0], cache_base, prologue_size) != 0)
+		goto out;
+
+	image.resize(header.code_size);
+	if (header.code_size && fread(&image[0], header.code_size, 1, fp) != 1)
+		goto out;
+	blocks.resize(header.block_count);
+	if (header.block_count && fread(&blocks[0], sizeof(persistent_block), header.block_count, fp) != header.block_count)
+		goto out;
+	if (header.code_size && !codegen.restore_code(&image[0], header.code_size))
+		goto out;
+
+	for (uint32 i = 0; i < header.block_count; i++) {
+		const persistent_block & pb = blocks[i];
+		if (pb.code_offset + pb.code_size > header.code_size || pb.reloc_count < 0 || pb.reloc_count > block_info::MAX_RELOCS)
+			continue;
+		persistent_blocks[pb.pc] = pb;
+	}
+	persistent_loaded_count = persistent_blocks.size();
+	D(bug("Persistent cache %s: loaded %d blocks, %d KB of code\n", filename, persistent_loaded_count, header.code_size / 1024));
+	ok = true;
+
+  out:
+	fclose(fp);
+	return ok;
+}
+
+struct persistent_block_collector {
+	powerpc_cpu *cpu;
+	std::vector<powerpc_cpu::persistent_block> blocks;
+
+	persistent_block_collector(powerpc_cpu *the_cpu) : cpu(the_cpu) { }
+	void operator()(const powerpc_cpu::block_info *bi) {
+		powerpc_cpu::persistent_block pb;
+		if (cpu->make_persistent_block(bi, pb))
+			blocks.push_back(pb);
+	}
+};
+
+bool powerpc_cpu::save_translation_cache(const char *filename)
+{
+	if (!use_persistent_cache)
+		return false;
+#if PPC_BACKGROUND_JIT
+	stop_jit_thread();
+#endif
+
+	// Keep blocks from the previous session that were not used yet
+	persistent_block_collector collector(this);
+	my_block_cache.for_each(collector);
+	for (persistent_block_map::const_iterator it = persistent_blocks.begin(); it != persistent_blocks.end(); ++it)
+		collector.blocks.push_back(it->second);
+
+	FILE *fp = fopen(filename, "wb");
+	if (fp == NULL)
+		return false;
+
+	uint8 * const cache_base = codegen.cache_base();
+	uint8 * const code_start = codegen.code_start_ptr();
+	persistent_cache_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, persistent_cache_magic, sizeof(header.magic));
+	header.version = PERSISTENT_CACHE_VERSION;
+	header.identity = persistent_identity;
+	header.build_id = persistent_build_id();
+	header.mem_base = (uintptr)vm_do_get_real_address(0);
+	header.cache_base = (uintptr)cache_base;
+	header.prologue_size = code_start - cache_base;
+	header.code_size = codegen.code_ptr() - code_start;
+	for (int i = 0; i < collector.blocks.size(); i++) {
+		// Blocks may live in regions past the current one
+		const uint32 code_end = collector.blocks[i].code_offset + collector.blocks[i].code_size;
+		if (code_end > header.code_size)
+			header.code_size = code_end;
+	}
+	header.block_count = collector.blocks.size();
+	header.block_size = sizeof(persistent_block);
+
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	if (ok && header.prologue_size)
+		ok = fwrite(cache_base, header.prologue_size, 1, fp) == 1;
+	if (ok && header.code_size)
+		ok = fwrite(code_start, header.code_size, 1, fp) == 1;
+	if (ok && header.block_count)
+		ok = fwrite(&collector.blocks[0], sizeof(persistent_block), header.block_count, fp) == header.block_count;
+	if (fclose(fp) != 0)
+		ok = false;
+	if (!ok)
+		remove(filename);
+
+	D(bug("Persistent cache %s: saved %d blocks, %d KB of code\n", filename, header.block_count, header.code_size / 1024));
+	return ok;
+}
+
 #endif
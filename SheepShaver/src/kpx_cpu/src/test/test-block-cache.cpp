@@ -0,0 +1,113 @@
+/*
+ *  test-block-cache.cpp - Block cache lookup benchmark
+ *
+ *  Kheperix (C) 2003-2005 Gwenole Beauchesne
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "sysdeps.h"
+#include "cpu/block-cache.hpp"
+
+// Minimal block info, only what the lookup structures need
+struct bench_block_info
+{
+	uintptr				pc;
+	uintptr				min_pc, max_pc;
+	block_page_link< bench_block_info > page_links[2];
+
+	bool intersect(uintptr start, uintptr end) {
+		return (min_pc >= start && min_pc < end) || (max_pc >= start && max_pc < end);
+	}
+	void invalidate() { }
+};
+
+typedef block_cache< bench_block_info, lazy_allocator > bench_block_cache;
+typedef block_lookup_table< bench_block_info > bench_block_table;
+
+static const int LOOKUP_COUNT = 10000000;
+
+// Simple LCG so that results are reproducible across hosts
+static uint32 rand_state = 1;
+static inline uint32 next_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return rand_state >> 8;
+}
+
+static double elapsed_ns(clock_t start_time, int count)
+{
+	return 1e9 * double(clock() - start_time) / double(CLOCKS_PER_SEC) / double(count);
+}
+
+static void bench(int block_count)
+{
+	bench_block_cache *cache = new bench_block_cache;
+	bench_block_table *table = new bench_block_table;
+
+	// Blocks are spread over 64 MB of guest code, 4-byte aligned
+	uintptr *pcs = new uintptr[block_count];
+	for (int i = 0; i < block_count; i++) {
+		bench_block_info *bi = cache->new_blockinfo();
+		bi->pc = bi->min_pc = 0x10000000 + (i * 16 + (next_rand() & 3) * 4) % 0x4000000;
+		bi->max_pc = bi->min_pc + 60;
+		cache->add_to_cl_list(bi);
+		cache->add_to_active_list(bi);
+		table->add(bi);
+		pcs[i] = bi->pc;
+	}
+
+	// Random transitions between live blocks
+	uintptr *trace = new uintptr[LOOKUP_COUNT];
+	for (int i = 0; i < LOOKUP_COUNT; i++)
+		trace[i] = pcs[next_rand() % block_count];
+
+	uintptr sum = 0;
+	clock_t start_time = clock();
+	for (int i = 0; i < LOOKUP_COUNT; i++) {
+		bench_block_info *bi = cache->find(trace[i]);
+		sum += bi->pc;
+	}
+	double chained_ns = elapsed_ns(start_time, LOOKUP_COUNT);
+
+	start_time = clock();
+	for (int i = 0; i < LOOKUP_COUNT; i++) {
+		bench_block_info *bi = cache->fast_find(trace[i]);
+		if (bi == NULL && (bi = table->find(trace[i])) != NULL)
+			cache->raise_in_cl_list(bi);
+		sum += bi->pc;
+	}
+	double table_ns = elapsed_ns(start_time, LOOKUP_COUNT);
+
+	printf("%7d blocks: chained %6.1f ns/lookup, table %6.1f ns/lookup (%d slots) [%lx]\n",
+		   block_count, chained_ns, table_ns, table->capacity(), (unsigned long)(sum & 0xf));
+
+	delete[] trace;
+	delete[] pcs;
+	delete table;
+	delete cache;
+}
+
+int main(void)
+{
+	static const int block_counts[] = { 10000, 50000, 100000, 250000, 500000 };
+	for (int i = 0; i < sizeof(block_counts) / sizeof(block_counts[0]); i++)
+		bench(block_counts[i]);
+	return 0;
+}
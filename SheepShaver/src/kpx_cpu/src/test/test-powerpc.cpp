@@ -22,6 +22,7 @@
 
 #include <vector>
 #include <limits>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -30,6 +31,8 @@
 #include <signal.h>
 #include <ctype.h>
 #include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #if defined(__powerpc__) || defined(__ppc__)
 #define NATIVE_POWERPC
@@ -152,6 +155,11 @@ typedef uintptr_t uintptr;
 
 // PowerPC opcodes
 static inline uint32 POWERPC_LI(int RD, uint32 v) { return _D(14,RD,00,(v&0xffff)); }
+static inline uint32 POWERPC_ADDI(int RD, int RA, uint32 v) { return _D(14,RD,RA,(v&0xffff)); }
+static inline uint32 POWERPC_CMPWI(int crfD, int RA, uint32 v) { return _D(11,(crfD<<2),RA,(v&0xffff)); }
+static inline uint32 POWERPC_BEQ(int32 disp) { return _I((16<<26)|(12<<21)|(2<<16)|(disp&0xfffc)); }
+static inline uint32 POWERPC_ADDIC_(int RD, int RA, uint32 v) { return _D(13,RD,RA,(v&0xffff)); }
+static inline uint32 POWERPC_B(int32 disp) { return _I((18<<26)|(disp&0x03fffffc)); }
 static inline uint32 POWERPC_MR(int RD, int RA) { return _X(31,RA,RD,RA,444,0); }
 static inline uint32 POWERPC_MFCR(int RD) { return _X(31,RD,00,00,19,0); }
 static inline uint32 POWERPC_LVX(int vD, int rA, int rB) { return _X(31,vD,rA,rB,103,0); }
@@ -709,6 +717,15 @@ public:
 	~powerpc_test_cpu();
 
 	bool test(void);
+#if EMU_KHEPERIX && PPC_ENABLE_JIT
+	bool test_jit_stress(void);
+	bool test_jit_evict(void);
+	bool test_jit_crf(void);
+	bool test_jit_pages(void);
+#if PPC_PERSISTENT_JIT_CACHE
+	bool test_jit_persist(const char *self, const char *filename, uintptr code_hint);
+#endif
+#endif
 
 	void set_results_file(FILE *fp)
 		{ results_file = fp; }
@@ -2178,6 +2195,361 @@ bool powerpc_test_cpu::test(void)
 	return errors == 0;
 }
 
+#if EMU_KHEPERIX && PPC_ENABLE_JIT
+// Translation cache stress test, the working set is larger than the cache
+bool powerpc_test_cpu::test_jit_stress(void)
+{
+	const int n_funcs = 8192;
+	const int n_hot_funcs = 64;
+	const int n_func_words = 64;
+	const int n_passes = 8;
+
+	// Each function adds its index to r3, they are called through BLRL
+	const uint32 code_size = (2 + n_funcs * n_func_words) * 4;
+	uint32 *code = (uint32 *)vm_acquire(code_size, VM_MAP_DEFAULT | VM_MAP_32BIT);
+	if (code == VM_MAP_FAILED) {
+		fprintf(stderr, "ERROR: could not allocate %d KB of guest code\n", code_size / 1024);
+		return false;
+	}
+	code[0] = htonl(POWERPC_BLRL);
+	code[1] = htonl(POWERPC_EMUL_OP);
+	uint32 *funcs = &code[2];
+	for (int i = 0; i < n_funcs; i++) {
+		uint32 *func = &funcs[i * n_func_words];
+		for (int j = 0; j < n_func_words - 1; j++)
+			func[j] = htonl(POWERPC_ADDI(3, 3, i));
+		func[n_func_words - 1] = htonl(POWERPC_BLR);
+	}
+	assert((uintptr)code + code_size <= UINT_MAX);
+
+	// Stream through cold functions, hot ones are called in between
+	uint32 expected = 0;
+	set_gpr(3, 0);
+	clock_t start_time = clock();
+	for (int pass = 0; pass < n_passes; pass++) {
+		for (int i = n_hot_funcs; i < n_funcs; i++) {
+			const int n_calls = (i % n_hot_funcs) == 0 ? n_hot_funcs + 1 : 1;
+			for (int k = 0; k < n_calls; k++) {
+				const int f = (k < n_calls - 1) ? k : i;
+				set_lr((uintptr)&funcs[f * n_func_words]);
+				powerpc_cpu_base::execute((uintptr)code);
+				expected += f * (n_func_words - 1);
+			}
+		}
+	}
+	clock_t end_time = clock();
+
+	const bool ok = get_gpr(3) == expected;
+	printf("JIT stress: %d KB of guest code, %.2f sec, %s\n", code_size / 1024,
+		   double(end_time - start_time) / double(CLOCKS_PER_SEC), ok ? "ok" : "FAILED");
+	vm_release(code, code_size);
+	return ok;
+}
+
+// Eviction test, blocks chained to code in an evicted region
+bool powerpc_test_cpu::test_jit_evict(void)
+{
+	const int n_funcs = 4096;
+	const int n_func_words = 64;
+	const int n_chunk_funcs = 64;
+	const int n_steps = 24;
+	const int n_pages = 16;
+	const int n_calls = 40;
+	const int n_passes = 2;
+
+	// Cold functions add their index to r3, each page holds a block E
+	// branching to a block S, or to the next instruction depending on
+	// r4. S branches to X if r5 is zero, so it forms a superblock
+	const uint32 page_words = 4096 / 4;
+	const uint32 code_size = (page_words + n_pages * page_words + n_funcs * n_func_words) * 4;
+	uint32 *code = (uint32 *)vm_acquire(code_size, VM_MAP_DEFAULT | VM_MAP_32BIT);
+	if (code == VM_MAP_FAILED) {
+		fprintf(stderr, "ERROR: could not allocate %d KB of guest code\n", code_size / 1024);
+		return false;
+	}
+	code[0] = htonl(POWERPC_BLRL);
+	code[1] = htonl(POWERPC_EMUL_OP);
+	uint32 *pages = &code[page_words];
+	for (int i = 0; i < n_pages; i++) {
+		uint32 *page = &pages[i * page_words];
+		page[0] = htonl(POWERPC_CMPWI(0, 4, 0));		// E
+		page[1] = htonl(POWERPC_BEQ(12));
+		page[2] = htonl(POWERPC_ADDI(3, 3, 2));
+		page[3] = htonl(POWERPC_BLR);
+		page[4] = htonl(POWERPC_CMPWI(0, 5, 0));		// S
+		page[5] = htonl(POWERPC_BEQ(12));
+		page[6] = htonl(POWERPC_ADDI(3, 3, 3));
+		page[7] = htonl(POWERPC_BLR);
+		page[8] = htonl(POWERPC_ADDI(3, 3, 5));			// X
+		page[9] = htonl(POWERPC_BLR);
+	}
+	uint32 *funcs = &pages[n_pages * page_words];
+	for (int i = 0; i < n_funcs; i++) {
+		uint32 *func = &funcs[i * n_func_words];
+		for (int j = 0; j < n_func_words - 1; j++)
+			func[j] = htonl(POWERPC_ADDI(3, 3, i));
+		func[n_func_words - 1] = htonl(POWERPC_BLR);
+	}
+	assert((uintptr)code + code_size <= UINT_MAX);
+
+	// S is translated first, then E is linked to it, and S replaced
+	// by a superblock. The cold functions in between move on to other
+	// cache regions, until the region holding the code of S is evicted
+	// while E is still linked to it
+	uint32 expected = 0;
+	int f = 0;
+	set_gpr(3, 0);
+	set_gpr(5, 1);
+	for (int pass = 0; pass < n_passes; pass++) {
+		for (int i = 0; i < n_pages; i++) {
+			uint32 *page = &pages[i * page_words];
+			set_lr((uintptr)&page[4]);
+			powerpc_cpu_base::execute((uintptr)code);
+			expected += 3;
+			for (int step = 0; step < n_steps; step++) {
+				// Vary the distance between S and E across pages
+				const int n = (step == 0 ? 1 + i % 8 : 1) * n_chunk_funcs;
+				for (int k = 0; k < n; k++) {
+					set_lr((uintptr)&funcs[f * n_func_words]);
+					powerpc_cpu_base::execute((uintptr)code);
+					expected += f * (n_func_words - 1);
+					f = (f + 1) % n_funcs;
+				}
+				for (int k = 0; k < n_calls; k++) {
+					set_gpr(4, k & 1);
+					set_lr((uintptr)&page[0]);
+					powerpc_cpu_base::execute((uintptr)code);
+					expected += (k & 1) ? 2 : 3;
+				}
+			}
+		}
+	}
+
+	const bool ok = get_gpr(3) == expected;
+	printf("JIT eviction: %s\n", ok ? "ok" : "FAILED");
+	vm_release(code, code_size);
+	return ok;
+}
+
+// CR fields of a compare chain in a superblock, on the likely side
+// and on side exits
+bool powerpc_test_cpu::test_jit_crf(void)
+{
+	const int n_calls = 4096;
+
+	// Compare r4 with 0, 1 and 2 and branch to code adding 1, 2 or 3 to
+	// r3. Otherwise, r7 = r4 - 3 and record the result into cr0
+	const uint32 code_size = 4096;
+	uint32 *code = (uint32 *)vm_acquire(code_size, VM_MAP_DEFAULT | VM_MAP_32BIT);
+	if (code == VM_MAP_FAILED) {
+		fprintf(stderr, "ERROR: could not allocate %d KB of guest code\n", code_size / 1024);
+		return false;
+	}
+	code[0] = htonl(POWERPC_BLRL);
+	code[1] = htonl(POWERPC_EMUL_OP);
+	uint32 *func = &code[2];
+	for (int i = 0; i < 3; i++) {
+		func[2 * i] = htonl(POWERPC_CMPWI(0, 4, i));
+		func[2 * i + 1] = htonl(POWERPC_BEQ(28));
+	}
+	func[6] = htonl(POWERPC_ADDIC_(7, 4, -3));
+	func[7] = htonl(POWERPC_BLR);
+	for (int i = 0; i < 3; i++) {
+		func[8 + 2 * i] = htonl(POWERPC_ADDI(3, 3, i + 1));
+		func[8 + 2 * i + 1] = htonl(POWERPC_BLR);
+	}
+	assert((uintptr)code + code_size <= UINT_MAX);
+
+	// The branches are mostly not taken, so that the chain is turned
+	// into a superblock. Every 16th call leaves it through a side exit
+	bool ok = true;
+	uint32 expected = 0;
+	set_gpr(3, 0);
+	emul_set_xer(0);
+	for (int i = 0; i < n_calls && ok; i++) {
+		const int32 v = (i % 16) == 15 ? (i / 16) % 3 : ((i & 1) ? 3 + i % 8 : -1 - i % 8);
+		set_gpr(4, v);
+		set_gpr(7, 0xdead);
+		set_lr((uintptr)func);
+		powerpc_cpu_base::execute((uintptr)code);
+		const uint32 cr0 = emul_get_cr() >> 28;
+		if (v >= 0 && v < 3) {
+			expected += v + 1;
+			ok = cr0 == 2 && get_gpr(7) == 0xdead;
+		}
+		else
+			ok = cr0 == (v < 3 ? 8 : v > 3 ? 4 : 2) && get_gpr(7) == (uint32)(v - 3);
+	}
+	ok = ok && get_gpr(3) == expected;
+
+	printf("JIT CR fields: %s\n", ok ? "ok" : "FAILED");
+	vm_release(code, code_size);
+	return ok;
+}
+
+// Range invalidation of a superblock in a page other than the ones
+// of its lowest and highest instructions
+bool powerpc_test_cpu::test_jit_pages(void)
+{
+	const int n_calls = 256;
+
+	// Block E at the end of page 0 falls through into page 1, where a
+	// branch mostly goes back to T in page 0. T jumps to C in page 3,
+	// then through D in page 4 to G in page 5, one page too many
+	const uint32 page_words = 4096 / 4;
+	const uint32 code_size = 7 * page_words * 4;
+	uint32 *code = (uint32 *)vm_acquire(code_size, VM_MAP_DEFAULT | VM_MAP_32BIT);
+	if (code == VM_MAP_FAILED) {
+		fprintf(stderr, "ERROR: could not allocate %d KB of guest code\n", code_size / 1024);
+		return false;
+	}
+	code[0] = htonl(POWERPC_BLRL);
+	code[1] = htonl(POWERPC_EMUL_OP);
+	uint32 *pages = &code[page_words];
+	uint32 *E = &pages[page_words - 2];
+	uint32 *F = &pages[page_words];
+	uint32 *T = &pages[64];
+	uint32 *C = &pages[3 * page_words];
+	uint32 *D = &pages[4 * page_words];
+	uint32 *G = &pages[5 * page_words];
+	E[0] = htonl(POWERPC_ADDI(3, 3, 1));
+	E[1] = htonl(POWERPC_ADDI(3, 3, 1));
+	F[0] = htonl(POWERPC_CMPWI(0, 4, 0));
+	F[1] = htonl(POWERPC_BEQ((T - &F[1]) * 4));
+	F[2] = htonl(POWERPC_ADDI(3, 3, 100));
+	F[3] = htonl(POWERPC_BLR);
+	T[0] = htonl(POWERPC_B((C - T) * 4));
+	C[0] = htonl(POWERPC_ADDI(3, 3, 10));
+	C[1] = htonl(POWERPC_B((D - &C[1]) * 4));
+	D[0] = htonl(POWERPC_B((G - D) * 4));
+	G[0] = htonl(POWERPC_ADDI(3, 3, 1000));
+	G[1] = htonl(POWERPC_BLR);
+	assert((uintptr)code + code_size <= UINT_MAX);
+
+	// Turn E into a superblock spanning pages 0, 1 and 3, then make
+	// its branch in page 1 fall through
+	bool ok = true;
+	set_gpr(4, 0);
+	for (int pass = 0; pass < 2 && ok; pass++) {
+		const uint32 expected = pass == 0 ? 1012 : 102;
+		for (int i = 0; i < n_calls && ok; i++) {
+			set_gpr(3, 0);
+			set_lr((uintptr)E);
+			powerpc_cpu_base::execute((uintptr)code);
+			ok = get_gpr(3) == expected;
+		}
+		F[0] = htonl(POWERPC_CMPWI(0, 4, 1));
+		flush_icache_range(F, 4);
+	}
+
+	printf("JIT page invalidation: %s\n", ok ? "ok" : "FAILED");
+	vm_release(code, code_size);
+	return ok;
+}
+
+#if PPC_PERSISTENT_JIT_CACHE
+// Startup time with a cold translation cache vs. a persistent one. The
+// cache is saved here and restored by a new process, started as SELF
+// --jit-persist FILE ADDRESS, with guest code at the same ADDRESS
+bool powerpc_test_cpu::test_jit_persist(const char *self, const char *filename, uintptr code_hint)
+{
+	const int n_funcs = 2048;
+	const int n_func_words = 64;
+	const uint32 identity = 0x54455354;
+	const bool restore = filename != NULL;
+
+	char tmp_filename[] = "/tmp/test-powerpc-XXXXXX";
+	if (!restore) {
+		int fd = mkstemp(tmp_filename);
+		if (fd < 0) {
+			perror("mkstemp");
+			return false;
+		}
+		close(fd);
+		remove(tmp_filename);
+		filename = tmp_filename;
+	}
+
+	const uint32 code_size = (2 + n_funcs * n_func_words) * 4;
+	uint32 *code = (uint32 *)vm_acquire_hint((void *)code_hint, code_size, VM_MAP_DEFAULT | VM_MAP_32BIT);
+	if (code == VM_MAP_FAILED) {
+		fprintf(stderr, "ERROR: could not allocate %d KB of guest code\n", code_size / 1024);
+		return false;
+	}
+	code[0] = htonl(POWERPC_BLRL);
+	code[1] = htonl(POWERPC_EMUL_OP);
+	uint32 *funcs = &code[2];
+	for (int i = 0; i < n_funcs; i++) {
+		uint32 *func = &funcs[i * n_func_words];
+		for (int j = 0; j < n_func_words - 1; j++)
+			func[j] = htonl(POWERPC_ADDI(3, 3, i));
+		func[n_func_words - 1] = htonl(POWERPC_BLR);
+	}
+	assert((uintptr)code + code_size <= UINT_MAX);
+
+	uint32 expected = 0;
+	for (int i = 0; i < n_funcs; i++)
+		expected += i * (n_func_words - 1);
+
+	// Run each function once, translating it or restoring it from the
+	// persistent cache
+	bool ok = true;
+	if (restore && (uintptr)code != code_hint) {
+		fprintf(stderr, "ERROR: guest code moved to %p\n", code);
+		ok = false;
+	}
+	const bool loaded = ok && load_translation_cache(filename, identity);
+	if (ok && loaded != restore) {
+		fprintf(stderr, "ERROR: persistent cache %s\n", loaded ? "loaded too early" : "rejected");
+		ok = false;
+	}
+	double run_time = 0;
+	if (ok) {
+		set_gpr(3, 0);
+		clock_t start_time = clock();
+		for (int i = 0; i < n_funcs; i++) {
+			set_lr((uintptr)&funcs[i * n_func_words]);
+			powerpc_cpu_base::execute((uintptr)code);
+		}
+		clock_t end_time = clock();
+		run_time = double(end_time - start_time) / double(CLOCKS_PER_SEC);
+		ok = get_gpr(3) == expected;
+	}
+
+	if (restore) {
+		if (ok)
+			printf("JIT persistent cache: restored %.3f sec in a new process, ok\n", run_time);
+	}
+	else if (ok && !save_translation_cache(filename)) {
+		fprintf(stderr, "ERROR: could not save persistent cache %s\n", filename);
+		ok = false;
+	}
+	else if (ok) {
+		// Restore the cache at the next startup
+		printf("JIT persistent cache: %d KB of guest code, cold %.3f sec\n", code_size / 1024, run_time);
+		fflush(stdout);
+		char code_addr[32];
+		sprintf(code_addr, "%lx", (unsigned long)(uintptr)code);
+		pid_t pid = fork();
+		if (pid == 0) {
+			execl(self, self, "--jit-persist", filename, code_addr, (char *)NULL);
+			perror("execl");
+			_exit(1);
+		}
+		int status;
+		ok = pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	}
+	if (!restore)
+		remove(filename);
+
+	if (!ok)
+		printf("JIT persistent cache: FAILED\n");
+	vm_release(code, code_size);
+	return ok;
+}
+#endif
+#endif
+
 int main(int argc, char *argv[])
 {
 #ifdef EMU_KHEPERIX
@@ -2188,6 +2560,57 @@ int main(int argc, char *argv[])
 	FILE *fp = NULL;
 	powerpc_test_cpu *ppc = new powerpc_test_cpu;
 
+#if EMU_KHEPERIX && PPC_ENABLE_JIT
+	// Usage: test-powerpc --jit-stress [CACHE_SIZE_KB]
+	if (argc > 1 && strcmp(argv[1], "--jit-stress") == 0) {
+		ppc->enable_jit(argc > 2 ? atoi(argv[2]) : 1024);
+		bool ok = ppc->test_jit_stress();
+		delete ppc;
+		return !ok;
+	}
+
+	// Usage: test-powerpc --jit-evict
+	if (argc > 1 && strcmp(argv[1], "--jit-evict") == 0) {
+		ppc->enable_jit(1024);
+		bool ok = ppc->test_jit_evict();
+		delete ppc;
+		return !ok;
+	}
+
+	// Usage: test-powerpc --jit-crf
+	if (argc > 1 && strcmp(argv[1], "--jit-crf") == 0) {
+		ppc->enable_jit();
+		bool ok = ppc->test_jit_crf();
+		delete ppc;
+		return !ok;
+	}
+
+	// Usage: test-powerpc --jit-pages
+	if (argc > 1 && strcmp(argv[1], "--jit-pages") == 0) {
+		ppc->enable_jit();
+		bool ok = ppc->test_jit_pages();
+		delete ppc;
+		return !ok;
+	}
+
+#if PPC_PERSISTENT_JIT_CACHE
+	// Usage: test-powerpc --jit-persist [FILE ADDRESS]
+	if (argc > 1 && strcmp(argv[1], "--jit-persist") == 0) {
+		const char *filename = argc > 3 ? argv[2] : NULL;
+		if (filename) {
+			// Move the default mapping addresses, as address space
+			// randomization would
+			const uint32 shift_size = 1024 * 1024;
+			vm_release(vm_acquire(shift_size, VM_MAP_DEFAULT | VM_MAP_32BIT), shift_size);
+		}
+		ppc->enable_jit(4096, filename);
+		bool ok = ppc->test_jit_persist(argv[0], filename, filename ? strtoul(argv[3], NULL, 16) : 0);
+		delete ppc;
+		return !ok;
+	}
+#endif
+#endif
+
 	if (argc > 1) {
 		const char *arg = argv[1];
 		if (strcmp(arg, "--jit") == 0) {
@@ -38,6 +38,7 @@ prefs_desc common_prefs_items[] = {
 	{"scsi5", TYPE_STRING, false,       "SCSI target for Mac SCSI ID 5"},
 	{"scsi6", TYPE_STRING, false,       "SCSI target for Mac SCSI ID 6"},
 	{"screen", TYPE_STRING, false,      "video mode"},
+	{"displaycolordepth", TYPE_INT32, false, "display color depth"},
 	{"windowmodes", TYPE_INT32, false,  "bitmap of allowed window video modes"},
 	{"screenmodes", TYPE_INT32, false,  "bitmap of allowed fullscreen video modes"},
 	{"seriala", TYPE_STRING, false,     "device name of Mac serial port A"},
@@ -57,6 +58,10 @@ prefs_desc common_prefs_items[] = {
 	{"ignoreillegal", TYPE_BOOLEAN, false, "ignore illegal instructions"},
 	{"jit", TYPE_BOOLEAN, false,        "enable JIT compiler"},
 	{"jit68k", TYPE_BOOLEAN, false,     "enable 68k DR emulator"},
+	{"jitcachefile", TYPE_STRING, false, "path of persistent JIT translation cache"},
+	{"jitthreshold", TYPE_INT32, false, "executions of a block before it is translated (0 = first one)"},
+	{"jitthread", TYPE_BOOLEAN, false,  "translate hot blocks in a background thread"},
+	{"jitperf", TYPE_STRING, false,     "tell Linux perf about translated code (perfmap or jitdump)"},
 	{"keyboardtype", TYPE_INT32, false, "hardware keyboard type"},
 	{"hardcursor", TYPE_BOOLEAN, false, "hardware mouse cursor"},
 	{"hotkey", TYPE_INT32, false,       "hotkey modifier"},
@@ -90,6 +95,7 @@ void AddPrefsDefaults(void)
 	PrefsAddInt32("bootdrive", 0);
 	PrefsAddInt32("ramsize", 16 * 1024 * 1024);
 	PrefsAddInt32("frameskip", 8);
+	PrefsAddInt32("displaycolordepth", 0);
 	PrefsAddBool("gfxaccel", true);
 	PrefsAddBool("nocdrom", false);
 	PrefsAddBool("nonet", false);
@@ -106,6 +112,8 @@ void AddPrefsDefaults(void)
 	PrefsAddBool("jit", false);
 #endif
 	PrefsAddBool("jit68k", false);
+	PrefsAddInt32("jitthreshold", 0);
+	PrefsAddBool("jitthread", false);
 
 	PrefsAddInt32("keyboardtype", 5);
 